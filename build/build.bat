@@ -2,8 +2,11 @@
 if not defined DevEnvDir (
    call "C:\Program Files (x86)\Microsoft Visual Studio\2019\Community\VC\Auxiliary\Build\vcvarsall.bat" x64
 )
+rem AVX2 kernels are picked at runtime. Set ARCH_FLAGS=-arch:AVX2 to build for AVX2
+rem CPUs only, which also enables the compile-time AVX2 & BMI2 paths.
+if not defined ARCH_FLAGS set ARCH_FLAGS=
 cd F:\src
-cl -DASSERTIONS=1 -nologo -MT -GR- -Oi -WX -W3 -wd4100 -wd4189 -Z7 -EHsc -Fo"..\\build\\" -I "..\\include\\" -I "..\\include\\glad\\" -I "..\\include\\GLFW\\" -I "..\\include\\KHR\\" -I "..\\include\\glm\\" -c^
+cl -DASSERTIONS=1 -nologo -MT -GR- -Oi %ARCH_FLAGS% -WX -W3 -wd4100 -wd4189 -Z7 -EHsc -Fo"..\\build\\" -I "..\\include\\" -I "..\\include\\glad\\" -I "..\\include\\GLFW\\" -I "..\\include\\KHR\\" -I "..\\include\\glm\\" -c^
  game.cpp^
  asset.cpp^
  glad.c^
@@ -11,6 +14,7 @@ cl -DASSERTIONS=1 -nologo -MT -GR- -Oi -WX -W3 -wd4100 -wd4189 -Z7 -EHsc -Fo"..\
  input.cpp^
  draw.cpp^
  ecs.cpp^
+ scheduler.cpp^
  platform.cpp
 cd ..\build
 link -nologo -NODEFAULTLIB:"msvcrtd.lib" -MACHINE:X64 -DEBUG:FULL -LIBPATH:"..\\libs\\"^
@@ -21,6 +25,7 @@ link -nologo -NODEFAULTLIB:"msvcrtd.lib" -MACHINE:X64 -DEBUG:FULL -LIBPATH:"..\\
  input.obj^
  draw.obj^
  ecs.obj^
+ scheduler.obj^
  platform.obj^
  glfw3_mt.lib^
  gdi32.lib^
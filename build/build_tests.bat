@@ -0,0 +1,42 @@
+@echo off
+if not defined DevEnvDir (
+   call "C:\Program Files (x86)\Microsoft Visual Studio\2019\Community\VC\Auxiliary\Build\vcvarsall.bat" x64
+)
+rem Builds & runs the headless tests and benchmarks in tests\. Each test prints its
+rem timings, then "passed" or "FAILED". Exits non-zero if any test failed.
+set TEST_FLAGS=-DASSERTIONS=1 -nologo -MT -GR- -O2 -Oi -WX -W3 -wd4100 -wd4189 -Z7 -EHsc -I "..\\include\\"
+set TEST_SOURCES=..\src\ecs.cpp ..\src\mdcla.cpp
+set TEST_RESULT=0
+cd F:\tests
+call :build_and_run test_archetypes
+call :build_and_run test_handles
+call :build_and_run test_creation
+call :build_and_run test_concurrent
+call :build_and_run test_bricks
+call :build_and_run test_layout -DROOMGRID_MORTON_CELLS=0 test_layout_linear
+call :build_and_run test_layout -DROOMGRID_MORTON_CELLS=1 test_layout_morton
+call :build_and_run test_room_sizes
+call :build_and_run test_clone_types
+call :build_and_run test_room_removal
+call :build_and_run test_room_references
+call :build_and_run test_transforms
+call :build_and_run test_push_cells
+call :build_and_run test_push
+call :build_and_run test_templates -DSTATIC_ENTITY_TEMPLATES=0 test_templates_generic
+call :build_and_run test_templates -DSTATIC_ENTITY_TEMPLATES=1 test_templates_static
+cd ..\build
+del *.obj
+exit /b %TEST_RESULT%
+
+:build_and_run
+rem %1 test name, %2 extra compiler flags, %3 executable name if not %1
+set TEST_EXE=%1
+if not "%~3"=="" set TEST_EXE=%~3
+cl %TEST_FLAGS% %~2 -Fo"..\\build\\" -Fe"..\\build\\%TEST_EXE%.exe" %1.cpp %TEST_SOURCES%
+if errorlevel 1 (
+   set TEST_RESULT=1
+   exit /b
+)
+..\build\%TEST_EXE%.exe
+if errorlevel 1 set TEST_RESULT=1
+exit /b
@@ -0,0 +1,133 @@
+// ====================================================================================
+// Title: bitset.hpp
+// Description: Inline functions for bitsets stored as arrays of 64-bit words
+// ====================================================================================
+
+#ifndef BITSET_H
+#define BITSET_H
+
+// Utility Libs
+#include "utility.hpp"
+
+// Intrinsics
+#include <intrin.h>
+
+// Bit i lives in word i / 64. Iterate a word's set bits with bitsetPopLowest, which
+// skips every clear bit in one bit scan. The word-range functions touch whole words
+// only, so they vectorize and can be split across threads by word range. Counts use
+// popcnt where cpuHasPopcnt, a bit-twiddling count otherwise.
+
+inline uint
+bitsetWordCount(uint bit_count)
+{
+    return (bit_count + 63) >> 6;
+}
+
+inline bool
+bitsetGet(const uint64* bits_p, uint i)
+{
+    return ((bits_p[i >> 6] >> (i & 63)) & 1) != 0;
+}
+
+inline void
+bitsetSet(uint64* bits_p, uint i)
+{
+    bits_p[i >> 6] |= (1ULL << (i & 63));
+}
+
+inline void
+bitsetClear(uint64* bits_p, uint i)
+{
+    bits_p[i >> 6] &= ~(1ULL << (i & 63));
+}
+
+inline void
+bitsetAssign(uint64* bits_p, uint i, bool value)
+{
+    if(value) {bitsetSet(bits_p, i);}
+    else      {bitsetClear(bits_p, i);}
+}
+
+inline uint
+bitsetPopLowest(uint64& word)
+{
+    // Returns the index of the lowest set bit and clears it. word must not be 0.
+    // bsf, as tzcnt runs as bsf on CPUs without BMI1
+    unsigned long bit;
+    _BitScanForward64(&bit, word);
+    word &= word - 1;
+    return (uint)bit;
+}
+
+inline uint
+bitsetCountWord(uint64 word)
+{
+    // Set bits in word without popcnt
+    word = word - ((word >> 1) & 0x5555555555555555ULL);
+    word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (uint)((word * 0x0101010101010101ULL) >> 56);
+}
+
+inline void
+bitsetAssignRange(uint64* bits_p, uint begin, uint end, bool value)
+{
+    // Sets or clears bits [begin, end)
+    while(begin < end && (begin & 63))
+    {
+	bitsetAssign(bits_p, begin, value);
+	begin++;
+    }
+    uint64 fill = value ? ~0ULL : 0ULL;
+    for(; begin + 64 <= end; begin += 64)
+    {
+	bits_p[begin >> 6] = fill;
+    }
+    for(; begin < end; begin++)
+    {
+	bitsetAssign(bits_p, begin, value);
+    }
+}
+
+inline uint
+bitsetCount(const uint64* bits_p, uint word_begin, uint word_end)
+{
+    static const bool has_popcnt = cpuHasPopcnt();
+    uint count = 0;
+    if(has_popcnt)
+    {
+	for(uint w = word_begin; w < word_end; w++) {count += (uint)__popcnt64(bits_p[w]);}
+    }
+    else
+    {
+	for(uint w = word_begin; w < word_end; w++) {count += bitsetCountWord(bits_p[w]);}
+    }
+    return count;
+}
+
+inline uint
+bitsetCountAnd(const uint64* a_p, const uint64* b_p, uint word_begin, uint word_end)
+{
+    static const bool has_popcnt = cpuHasPopcnt();
+    uint count = 0;
+    if(has_popcnt)
+    {
+	for(uint w = word_begin; w < word_end; w++) {count += (uint)__popcnt64(a_p[w] & b_p[w]);}
+    }
+    else
+    {
+	for(uint w = word_begin; w < word_end; w++) {count += bitsetCountWord(a_p[w] & b_p[w]);}
+    }
+    return count;
+}
+
+inline void
+bitsetAnd(uint64* out_p, const uint64* a_p, const uint64* b_p, uint word_begin, uint word_end)
+{
+    for(uint w = word_begin; w < word_end; w++)
+    {
+	out_p[w] = a_p[w] & b_p[w];
+    }
+}
+
+#endif
@@ -9,6 +9,7 @@
 // Utility Libs
 #include "utility.hpp"
 #include "mdcla.hpp"
+#include "bitset.hpp"
 
 // Win libs
 #include <windows.h>
@@ -16,8 +17,13 @@
 // C/C++ Utility Lib
 #include <stdlib.h>
 #include <cstring>
+#include <cfloat>
+#include <climits>
 #include <vector>
 #include <iostream>
+#include <new>
+#include <algorithm>
+#include <atomic>
 
 // Entity Types //
 
@@ -55,6 +61,8 @@ typedef enum Component
     TOTAL_COMPONENT_TYPES
 } Component;
 
+#include "entity_traits.hpp"
+
 // Entity Templates //
 
 typedef struct EntityTemplates
@@ -63,15 +71,35 @@ typedef struct EntityTemplates
     EntityTemplates();
 } EntityTemplates;
 
-// Component Transform //
+// Vec3F Columns //
+
+// A Vec3F per entity, stored as one float column per axis. Columns are 32-byte
+// aligned, so systems can load the same axis of 8 entities with one AVX load.
+
+typedef struct Vec3FColumns
+{
+    float* x;
+    float* y;
+    float* z;
+} Vec3FColumns;
 
-typedef struct Transform
+inline Vec3F
+vec3FColumnsGet(const Vec3FColumns& columns, uint i)
 {
-    Vec3F position;
-    Vec3F scale;
-    Transform();
-    Transform(Vec3F _position, Vec3F _scale);
-} Transform;
+    return Vec3F(columns.x[i], columns.y[i], columns.z[i]);
+}
+
+inline void
+vec3FColumnsSet(Vec3FColumns& columns, uint i, Vec3F value)
+{
+    columns.x[i] = value.x;
+    columns.y[i] = value.y;
+    columns.z[i] = value.z;
+}
+
+// Component Transform //
+
+// Stored in ActiveEntities as transform_positions & transform_scales
 
 // Component Camera //
 
@@ -107,13 +135,8 @@ typedef struct PointLight
 
 // Component GridPosition //
 
-typedef struct GridPosition
-{
-    Vec3F position;
-    int roomgrid_owner_id = -1; 
-    GridPosition();
-    GridPosition(Vec3F _position);
-} GridPosition;
+// Stored in ActiveEntities as grid_positions (hot) & roomgrid_owner_ids (cold). The
+// BITSET_GRID_DIRTY bit is set by writers, cleared once the transform is recomputed.
 
 // Component State //
 
@@ -124,7 +147,6 @@ typedef enum StateMeta
 
 typedef struct State
 {
-    bool inactive; 
     int input_cooldown;
     State();
 } State;
@@ -152,25 +174,63 @@ typedef struct AI
 {
     Vec3F face_dir;
     uint  next_move;
+    uint  rng_state;  // See aiRandom, 0 until first used
     AI();
 } AI;
 
+#define AI_RNG_SEED 0x2545F491u  // Fixed, so a run's AI moves can be replayed
+
 // Component RoomGrid //
 
+// Each RoomGrid has its own extents, set through roomGridLookupSetExtents before the
+// entity holding it is created. The default and small sizes have specialized cell
+// lookups whose index math is constant-folded.
 typedef enum GridMeasurements
 {
-    RG_MAX_WIDTH  = 20,
-    RG_MAX_LENGTH = 20,
-    RG_MAX_HEIGHT = 20
+    RG_DEFAULT_WIDTH  = 20,
+    RG_DEFAULT_LENGTH = 20,
+    RG_DEFAULT_HEIGHT = 20,
+    RG_SMALL_WIDTH    = 5,
+    RG_SMALL_LENGTH   = 5,
+    RG_SMALL_HEIGHT   = 5,
+    RG_MAX_EXTENT     = 256  // On any axis
 } GridMeasurements;
 
+typedef enum RoomGridSizeClass
+{
+    RG_SIZE_ANY = 0,
+    RG_SIZE_DEFAULT,
+    RG_SIZE_SMALL
+} RoomGridSizeClass;
+
 typedef enum EntityCodes
 {
     NO_ENTITY     = -1,
     INVALID_RANGE = -2
 } EntityCodes;
 
+// Cells are stored in 4x4x4 bricks allocated on first use, so an empty RoomGrid costs
+// only its brick table and occupancy words. Extents are rounded up to whole bricks.
+typedef enum RoomGridBrickMeasurements
+{
+    RG_BRICK_SIZE  = 4,
+    RG_BRICK_CELLS = RG_BRICK_SIZE * RG_BRICK_SIZE * RG_BRICK_SIZE // One occupancy word
+} RoomGridBrickMeasurements;
+
+// Cells within a brick are ordered along a Z-curve (Morton order), so each 2x2x2 block
+// of neighbours shares 32 bytes and any neighbour in a brick is at most one 256-byte
+// brick away. Define ROOMGRID_MORTON_CELLS as 0 for the linear x, y, z order.
+#ifndef ROOMGRID_MORTON_CELLS
+#define ROOMGRID_MORTON_CELLS 1
+#endif
+
 const Vec3F BASE_RG_ORIGIN = Vec3F(0.0f, 0.0f, 0.0f);
+
+// Ids of the built-in level's RoomGrids. The lookup grows to fit any id, and
+// roomGridLookupAddID hands out unused ones. Creating a BLOCK_ROOM with the id of an
+// existing RoomGrid adds a reference to it instead of a copy, so a RoomGrid can be shown
+// in several places, including inside itself. The first holder owns it: placement,
+// transitions & the lifetime of its contents follow the owner alone.
 typedef enum RoomGridCodes
 {
     ROOMGRID_A = 0,
@@ -179,66 +239,431 @@ typedef enum RoomGridCodes
     ROOMGRID_D,
     ROOMGRID_E,
     ROOMGRID_F,
-    ROOMGRID_G,
-    TOTAL_ROOMGRIDS
+    ROOMGRID_G
 } RoomGridCodes;
 
+typedef struct RoomGridBrick
+{
+    int   cells[RG_BRICK_CELLS]; // Entity handles, -1 if empty
+    uchar flags[RG_BRICK_CELLS]; // RoomGridCellFlags of each cell
+    uint  ref_count;             // RoomGrids sharing the brick, see activeEntitiesCreateRoomClone
+} RoomGridBrick;
+
+// The contents of one EntityType in a RoomGrid, with their grid positions in SoA order
+// for the type queries. Kept by roomGridAddContents & roomGridRemoveContent, the
+// positions by activeEntitiesSetGridPosition.
+typedef struct RoomGridTypeList
+{
+    std::vector<int>   handles;
+    std::vector<float> xs;
+    std::vector<float> ys;
+    std::vector<float> zs;
+} RoomGridTypeList;
+
 typedef struct RoomGrid
 {
-    int grid[RG_MAX_WIDTH][RG_MAX_HEIGHT][RG_MAX_LENGTH];
+    uint width;                     // Extents in cells
+    uint height;
+    uint length;
+    uint bricks_height;             // Extents in bricks, the width is not needed for indexing
+    uint bricks_length;
+    uint brick_count;
+    uint size_class;                // RoomGridSizeClass
+    RoomGridBrick** bricks;         // NULL while the brick has no entities
+    uint64* occupancy;              // Bit per cell of each brick
+    uint64* push_marks = NULL;      // Cells left by the push line being scanned, made on its first push
     float previous_scale = 1.0f;
     float current_scale  = 1.0f;
     float target_scale   = 1.0f;
     float t = 1.0f;
-    Vec3F center = Vec3F(RG_MAX_WIDTH * current_scale * 0.5f, 0.0f, RG_MAX_LENGTH * current_scale * 0.5f);
-    Vec3F target_transform_pos;
+    Vec3F center;
     Vec3F grid_pos; // Not used in the position calculation (see active_entities.grid_positions)
-    Vec3F transform_pos;
+    Vec3F transform_base;           // Position of cell 0, relative to the viewed RoomGrid
+    float transform_scale = 0.0f;   // current_scale when the contents' transforms were last computed
+    Mat4F transform_matrix;         // Grid position -> position relative to the viewed RoomGrid
+    bool  dirty = true;             // Contents' transforms need recomputing this frame
+    bool  impostor_dirty = true;    // Contents changed since the renderer's impostor tint was built
     uint cooldown = 0;
     int roomgrid_owner_id = -1; 
+    int roomgrid_id = -1;           // This RoomGrid's lookup ID
+    int owner_entity_handle = -1;   // Handle of the entity holding this RoomGrid
+    std::vector<int> contents;      // Handles of the grid-positioned entities in this RoomGrid
+    std::vector<int> references;    // Handles of the other entities showing this RoomGrid
+    RoomGridTypeList type_lists[TOTAL_ENTITY_TYPES];
+    int  template_id = -1;          // RoomGrid whose bricks this one shares until written, -1 if none
+    const RoomGrid* template_p = NULL;  // template_id's RoomGrid, whose type lists cover the shared bricks
+    bool is_template = false;       // Held by no entity, never drawn
     RoomGrid();
+    RoomGrid(uint _width, uint _height, uint _length);
+    ~RoomGrid();
+    RoomGrid(const RoomGrid&) = delete;
+    RoomGrid& operator=(const RoomGrid&) = delete;
 } RoomGrid;
 
 typedef struct RoomGridLookup
 {
-    RoomGrid* roomgrid_pointers[TOTAL_ROOMGRIDS];
+    std::vector<RoomGrid*> roomgrid_pointers;  // RoomGrid id -> RoomGrid, NULL if none
+    std::vector<uint>      extents;            // Width, height & length each RoomGrid is created with
 } RoomGridLookup;
 
 typedef struct RoomGridTransitionStatus
 {
-    RoomGrid* current_roomgrid_p = NULL;
-    Vec3F apply_offset = Vec3F(0.0f, 0.0f, 0.0f);
+    RoomGrid* current_roomgrid_p = NULL;       // The viewed RoomGrid, placed at the origin
     Vec3F anim_offset  = Vec3F(0.0f, 0.0f, 0.0f);
     bool update_anim_offset = false;
     bool is_complete = true;
     float t = 1.0f;
 } RoomGridTransitionStatus;
 
+// Prefabs //
+
+// The values every new entity of a type starts with. Creating entities copies the
+// prototype of their type into the columns, so N instances are one block fill per
+// column instead of N constructor calls. Which components are copied follows the
+// entity templates. A prototype can be overridden before its instances are created,
+// e.g. through prefabGetComponentP(entities.prefabs[DIR_LIGHT], COMPONENT_DIR_LIGHT).
+
+typedef struct Prefab
+{
+    Vec3F      scale;
+    State      state;
+    Camera     camera;       // Chunked components
+    DirLight   dir_light;
+    PointLight point_light;
+    AI         ai;
+    Prefab();
+} Prefab;
+
+inline void*
+prefabGetComponentP(Prefab& prefab, uint component)
+{
+    // Returns the prototype of a component stored per entity, NULL for Transform &
+    // GridPosition, which are set from the origin of each instance
+    switch(component)
+    {
+        case COMPONENT_STATE:       return &prefab.state;
+        case COMPONENT_CAMERA:      return &prefab.camera;
+        case COMPONENT_DIR_LIGHT:   return &prefab.dir_light;
+        case COMPONENT_POINT_LIGHT: return &prefab.point_light;
+        case COMPONENT_AI:          return &prefab.ai;
+        default:                    return NULL;
+    }
+}
+
+// Archetypes //
+
+// Entity types sharing a component set (a row of EntityTemplates::table) share an
+// archetype. The per-type data components (Camera, DirLight, PointLight, AI) are stored
+// in the archetype's chunks instead of in MAX_ENTITIES-long arrays, so their memory
+// scales with the number of entities that actually use them.
+
+#define CACHE_LINE_SIZE      64
+#define ARCHETYPE_CHUNK_SIZE 16384
+
+typedef struct Archetype
+{
+    uint   signature;                              // Bit per Component
+    uint   column_offsets[TOTAL_COMPONENT_TYPES];  // Byte offset of each column in a chunk
+    uint   column_strides[TOTAL_COMPONENT_TYPES];  // 0 if the column is not chunked
+    uint   chunk_capacity;                         // Rows per chunk
+    uint   count;                                  // Rows in use
+    std::vector<uchar*> chunks;                    // ARCHETYPE_CHUNK_SIZE, cache-line aligned
+} Archetype;
+
+inline uint
+archetypeGetChunkedCount(const Archetype& archetype)
+{
+    return (uint)archetype.chunks.size() * archetype.chunk_capacity;
+}
+
+inline void*
+archetypeGetComponentP(const Archetype& archetype, uint row, uint component)
+{
+    _assert(row < archetype.count);
+    _assert(archetype.column_strides[component]);
+
+    uchar* chunk_p = archetype.chunks[row / archetype.chunk_capacity];
+    return (void*)(chunk_p + archetype.column_offsets[component] +
+		   (row % archetype.chunk_capacity) * archetype.column_strides[component]);
+}
+
+inline int*
+archetypeGetEntityIDP(const Archetype& archetype, uint row)
+{
+    // Column 0 of every chunk stores the entity ID owning each row
+    _assert(row < archetype.count);
+
+    uchar* chunk_p = archetype.chunks[row / archetype.chunk_capacity];
+    return (int*)chunk_p + (row % archetype.chunk_capacity);
+}
+
 // Struct of Component Arrays //
 
 #define MAX_COMPONENTS 128
-#define MAX_ENTITIES   10000
+
+// Entity Queries //
+
+// Each query keeps a dense list of the IDs of entities whose component set contains
+// the query's component mask, so a system only visits the entities it updates.
+// Lists are kept in creation order and updated as entities are created and removed.
+
+typedef enum QueryType
+{
+    QUERY_STATE = 0,
+    QUERY_PLAYER,
+    QUERY_AI,
+    QUERY_ROOM_GRID,
+    QUERY_GRID_POSITION,
+    QUERY_CAMERA,
+    QUERY_DIR_LIGHT,
+    QUERY_RENDER,
+    TOTAL_QUERIES
+} QueryType;
+
+#define QUERY_TOMBSTONE 0xFFFFFFFF
+
+typedef struct EntityQuery
+{
+    uint mask;
+    uint* ids;
+    uint* slots;               // Entity ID -> index in ids
+    uint count;
+    uint tombstones;           // Removed entries waiting for compaction
+} EntityQuery;
+
+inline uint
+componentMask(uint component)
+{
+    return (1 << component);
+}
+
+// Entity Bitsets //
+
+// A bit per entity ID for liveness and for the tags systems filter on most, so loops
+// can AND the words of two bitsets and visit only the set bits (see bitset.hpp).
+// Bits move with their entity when it is swapped into a removed entity's ID.
+
+typedef enum EntityBitset
+{
+    BITSET_LIVE = 0,       // Created & not marked inactive
+    BITSET_RENDER,
+    BITSET_GRID_POSITION,
+    BITSET_PUSHABLE,
+    BITSET_COLLISION,
+    BITSET_GRID_DIRTY,     // Grid position changed since the transform was computed
+    TOTAL_ENTITY_BITSETS
+} EntityBitset;
+
+// Entity Handles //
+
+// Entity IDs index the dense component columns and change when an entity is swapped
+// into a removed entity's slot. A handle stays valid for the entity's lifetime: it
+// packs a sparse index, resolved to the current ID through ActiveEntities::sparse_to_dense,
+// and the generation of that index, which is bumped when the entity is removed so stale
+// handles can be detected. Handles are never negative, so they can share storage with
+// NO_ENTITY and INVALID_RANGE.
+
+#define HANDLE_INDEX_BITS      20
+#define HANDLE_GENERATION_BITS 11
+#define HANDLE_INDEX_MASK      ((1 << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_GENERATION_MASK ((1 << HANDLE_GENERATION_BITS) - 1)
+
+inline int
+entityHandleMake(uint index, uint generation)
+{
+    return (int)((generation & HANDLE_GENERATION_MASK) << HANDLE_INDEX_BITS | (index & HANDLE_INDEX_MASK));
+}
+
+inline uint
+entityHandleGetIndex(int handle)
+{
+    return (uint)handle & HANDLE_INDEX_MASK;
+}
+
+inline uint
+entityHandleGetGeneration(int handle)
+{
+    return ((uint)handle >> HANDLE_INDEX_BITS) & HANDLE_GENERATION_MASK;
+}
+
+// RoomGrid cells keep an entity handle with flags copied from its type, so a move can
+// be validated from the grid alone. The flags are cleared when the entity is destroyed,
+// leaving a cell any entity may move into until it is removed. Bricks store the flags
+// in a byte per cell beside the handles, so handles keep every generation bit, and a
+// RoomGridCell read from the grid packs the two: the handle in the low 32 bits, the
+// flags above.
+
+typedef long long RoomGridCell;
+
+typedef enum RoomGridCellFlags
+{
+    CELL_COLLISION = 1 << 0,
+    CELL_PUSHABLE  = 1 << 1,
+    CELL_ROOM      = 1 << 2,
+    CELL_FLAGS     = CELL_COLLISION | CELL_PUSHABLE | CELL_ROOM
+} RoomGridCellFlags;
+
+inline RoomGridCell
+roomGridCellMake(int entity_handle, uint cell_flags)
+{
+    return (RoomGridCell)(uint)entity_handle | ((RoomGridCell)(cell_flags & CELL_FLAGS) << 32);
+}
+
+inline int
+roomGridCellGetHandle(RoomGridCell cell)
+{
+    // NO_ENTITY and INVALID_RANGE are passed through
+    return (cell < 0) ? (int)cell : (int)(cell & 0xFFFFFFFF);
+}
+
+inline uint
+roomGridCellGetFlags(RoomGridCell cell)
+{
+    return (cell < 0) ? 0 : (uint)(cell >> 32);
+}
+
+// Entity Columns //
+
+// Each per-entity column reserves address space for MAX_ENTITIES elements up front and
+// commits pages as the entity count grows, so columns never move and memory follows
+// the number of entities created. Define ENTITY_FIXED_CAPACITY as a capacity to
+// allocate every column at that size up front instead, without virtual memory.
+
+#ifndef ENTITY_FIXED_CAPACITY
+#define ENTITY_FIXED_CAPACITY 0
+#endif
+
+#if ENTITY_FIXED_CAPACITY
+#define MAX_ENTITIES ENTITY_FIXED_CAPACITY
+#else
+#define MAX_ENTITIES (1 << HANDLE_INDEX_BITS)  // Every handle index can be used
+#endif
+#define MAX_ENTITY_COLUMNS 48
+#define ENTITY_COMMIT_STEP 4096                 // Minimum entities committed per growth
+#define ENTITY_DEFRAG_SWAPS 256                 // Swaps per idle frame, see activeEntitiesDefragment
+
+typedef struct EntityColumns
+{
+    uchar* bases[MAX_ENTITY_COLUMNS];
+    uint   element_bits[MAX_ENTITY_COLUMNS];  // Bitsets take 1 bit per entity
+    uint   count;
+    uint   capacity;  // Elements committed in every column
+} EntityColumns;
 
 typedef struct ActiveEntities
 {
     EntityTemplates entity_templates;
-    uint         types[MAX_ENTITIES];
-    Transform    transforms[MAX_ENTITIES];
-    Camera       cameras[MAX_ENTITIES];
-    DirLight     dir_lights[MAX_ENTITIES];
-    PointLight   point_lights[MAX_ENTITIES];
-    GridPosition grid_positions[MAX_ENTITIES];
-    State        states[MAX_ENTITIES];
-    AI           ai[MAX_ENTITIES];
-    int          roomgrid_ids[MAX_ENTITIES];
-    uint         count;
+    Prefab          prefabs[TOTAL_ENTITY_TYPES];
+    EntityColumns   columns;
+    Archetype     archetypes[TOTAL_ENTITY_TYPES];
+    uint          type_archetypes[TOTAL_ENTITY_TYPES]; // EntityType -> archetype index
+    uint          archetype_count;
+    EntityQuery   queries[TOTAL_QUERIES];
+    uint          type_queries[TOTAL_ENTITY_TYPES];    // EntityType -> bit per matching query
+    uint64*       bitsets[TOTAL_ENTITY_BITSETS];
+    uint          type_bitsets[TOTAL_ENTITY_TYPES];    // EntityType -> bit per set EntityBitset
+    uint*         types;
+    uint*         archetype_rows;
+    Vec3FColumns  transform_positions;
+    Vec3FColumns  transform_scales;
+    Vec3FColumns  grid_positions;
+    int*          roomgrid_owner_ids;  // -1 if not in a RoomGrid
+    State*        states;
+    int*          roomgrid_ids;
+    int*          handles;          // Entity ID -> handle
+    uint*         sparse_to_dense;  // Handle index -> entity ID
+    uint*         generations;      // Handle index -> current generation
+    uint*         free_indices;
+    uint          free_count;
+    uint          sparse_count;     // Handle indices ever handed out
+    int*          removed_handles;  // Marked inactive, pending removal
+    uint*         roomgrid_slots;   // Handle index -> index in its RoomGrid's contents
+    uint*         roomgrid_type_slots;  // Handle index -> index in its RoomGrid's type list
+    uint          removed_count;
+    uint          count;
+    std::atomic<uint> pending_count;  // Reserved by activeEntitiesCreateEntitiesConcurrent
+    std::vector<uint> defrag_next;    // Per defrag key: next slot that may be misplaced
+    std::vector<uint> defrag_end;     // Per defrag key: end of the key's range
+    uint          defrag_key;       // Key activeEntitiesDefragment resumes at
+    bool          defrag_dirty;     // Entities were created, removed or changed RoomGrid
     ActiveEntities();
+    ~ActiveEntities();
 } ActiveEntities;
 
+// Entity Command Buffer //
+
+// Records structural changes made during a frame so they can be applied together at a
+// sync point. Playback sorts the commands so each kind of change, and each run of
+// creations of one type in one RoomGrid, is applied as a batch.
+
+typedef enum EntityCommandType
+{
+    COMMAND_DESTROY = 0,
+    COMMAND_MOVE,
+    COMMAND_CREATE
+} EntityCommandType;
+
+typedef struct EntityCommand
+{
+    uint  type;
+    uint  sequence;           // Order recorded, keeps the sort stable
+    int   room_grid_owner_id; // COMMAND_CREATE - RoomGrid the entity is placed in
+    int   room_grid_id;       // COMMAND_CREATE - RoomGrid to allocate, -1 if none
+    uint  entity_type;        // COMMAND_CREATE
+    int   entity_handle;      // COMMAND_DESTROY, COMMAND_MOVE
+    Vec3F position;           // Origin of COMMAND_CREATE, destination of COMMAND_MOVE
+} EntityCommand;
+
+typedef struct EntityCommandBuffer
+{
+    std::vector<EntityCommand> commands;
+} EntityCommandBuffer;
+
+// Room Transforms //
+
+// Per-RoomGrid inputs of the transform kernels, written by gameUpdateRoomTransforms. A
+// RoomGrid's scale & base are the diagonal & translation of its transform_matrix.
+// Indexed by roomgrid id + 1, so entities outside any RoomGrid (id -1) read entry 0.
+
+typedef struct RoomTransformTable
+{
+    std::vector<float> scales;
+    std::vector<float> bases_x;  // Position of cell 0, relative to the viewed RoomGrid
+    std::vector<float> bases_y;
+    std::vector<float> bases_z;
+    std::vector<int>   dirty;    // 1 if the contents' transforms need recomputing, -1 never (templates)
+    std::vector<int>   order;    // Scratch for gameUpdateRoomTransforms: ids by depth
+    std::vector<uint>  level_starts;
+    std::vector<uint>  depths;
+    std::vector<char>  placed;
+    std::vector<Vec3F> bases;
+} RoomTransformTable;
+
 // Function Prototypes //
 
+// EntityTemplates Function Prototypes
+
+int
+entityTemplatesLoadFromTxt(EntityTemplates& entity_templates, c_char* path);
+
 // ActiveEntities Function Prototypes
 
+void
+activeEntitiesInitArchetypes(ActiveEntities& entities);
+
+void
+activeEntitiesInitQueries(ActiveEntities& entities);
+
+inline void*
+activeEntitiesGetComponentP(const ActiveEntities& entities, uint entity_ID, uint component)
+{
+    // Returns the chunked component (Camera, DirLight, PointLight or AI) of an entity
+    _assert(entity_ID >= 0 && entity_ID < entities.count);
+
+    const Archetype& archetype = entities.archetypes[entities.type_archetypes[entities.types[entity_ID]]];
+    return archetypeGetComponentP(archetype, entities.archetype_rows[entity_ID], component);
+}
+
 int
 activeEntitiesCreateEntity(ActiveEntities& entities,
 			       RoomGridLookup& roomgrid_lookup,
@@ -247,30 +672,184 @@ activeEntitiesCreateEntity(ActiveEntities& entities,
 			       Vec3F origin,
 			       uint entity_type);
 
+inline int
+activeEntitiesGetID(const ActiveEntities& entities, int handle)
+{
+    // Returns the entity ID of a handle, -1 if the handle is invalid, its entity was removed
+    // or is still pending (see activeEntitiesGetPendingID)
+    if(handle < 0) {return -1;}
+
+    uint index = entityHandleGetIndex(handle);
+    if(index >= entities.sparse_count ||
+       entities.generations[index] != entityHandleGetGeneration(handle) ||
+       entities.sparse_to_dense[index] >= entities.count)
+    {
+	return -1;
+    }
+    return (int)entities.sparse_to_dense[index];
+}
+
+inline int
+activeEntitiesGetPendingID(const ActiveEntities& entities, int handle)
+{
+    // Returns the entity ID of a handle made by activeEntitiesCreateEntitiesConcurrent &
+    // not yet published, -1 otherwise
+    if(handle < 0) {return -1;}
+
+    uint index   = entityHandleGetIndex(handle);
+    uint pending = entities.pending_count.load();
+    if(index >= entities.sparse_count + pending) {return -1;}
+
+    // Pending entities may have reused a free index, so check the ID & handle instead
+    uint id = entities.sparse_to_dense[index];
+    if(id < entities.count || id >= entities.count + pending || entities.handles[id] != handle)
+    {
+	return -1;
+    }
+    return (int)id;
+}
+
+// Component checks. With STATIC_ENTITY_TEMPLATES the checks read the compile-time
+// signatures in entity_traits.hpp. Kernels instantiated for a known TYPE have their
+// branches resolved at compile time, ENTITY_TYPE_ANY instantiates one for any type.
+
+#define ENTITY_TYPE_ANY TOTAL_ENTITY_TYPES
+
+inline bool
+activeEntitiesTypeHas(const ActiveEntities& entities, uint entity_type, uint component)
+{
+#if STATIC_ENTITY_TEMPLATES
+    return entityTraitsHas(entity_type, component);
+#else
+    return entities.entity_templates.table[entity_type][component] != 0;
+#endif
+}
+
+template<uint TYPE>
+inline bool
+activeEntitiesKernelHas(const ActiveEntities& entities, uint entity_type, uint component)
+{
+    return ((TYPE == ENTITY_TYPE_ANY) ?
+	    activeEntitiesTypeHas(entities, entity_type, component) :
+	    entityTraitsHas(TYPE, component));
+}
+
+inline uint
+activeEntitiesGetCellFlags(const ActiveEntities& entities, uint entity_type)
+{
+    // RoomGrid cell flags for entities of entity_type
+    uint flags = 0;
+    if(entities.type_bitsets[entity_type] & (1 << BITSET_COLLISION)) {flags |= CELL_COLLISION;}
+    if(entities.type_bitsets[entity_type] & (1 << BITSET_PUSHABLE))  {flags |= CELL_PUSHABLE;}
+    if(activeEntitiesTypeHas(entities, entity_type, COMPONENT_ROOM_GRID)) {flags |= CELL_ROOM;}
+    return flags;
+}
+
 inline void
 activeEntitiesMarkInactive(ActiveEntities& entities, uint entity_ID)
 {
    _assert(entity_ID >= 0 && entity_ID < entities.count);
     
-    // Sets state to inactive, system knows the entity is free to overwrite
-    entities.states[entity_ID].inactive = true;
+    // Clears the entity's live bit, system knows the entity is free to overwrite.
+    // Queues the entity for activeEntitiesRemoveInactives.
+    if(bitsetGet(entities.bitsets[BITSET_LIVE], entity_ID))
+    {
+	bitsetClear(entities.bitsets[BITSET_LIVE], entity_ID);
+	entities.removed_handles[entities.removed_count++] = entities.handles[entity_ID];
+    }
+}
+
+inline bool
+activeEntitiesIsActive(const ActiveEntities& entities, uint entity_ID)
+{
+    return bitsetGet(entities.bitsets[BITSET_LIVE], entity_ID);
 }
 
+int
+activeEntitiesReserve(ActiveEntities& entities, uint entity_count);
+
+size_t
+activeEntitiesGetCommittedBytes(const ActiveEntities& entities);
+
+int
+activeEntitiesCreateEntities(ActiveEntities& entities,
+				 RoomGridLookup& roomgrid_lookup,
+				 int room_grid_owner_id,
+				 const Vec3F* origins,
+				 uint entity_count,
+				 uint entity_type,
+				 int* handles_p);
+
+int
+activeEntitiesCreateEntitiesConcurrent(ActiveEntities& entities,
+					   int room_grid_owner_id,
+					   const Vec3F* origins,
+					   uint entity_count,
+					   uint entity_type,
+					   int* handles_p);
+
+void
+activeEntitiesPublishCreated(ActiveEntities& entities, RoomGridLookup& roomgrid_lookup);
+
 void
 activeEntitiesRemoveInactives(ActiveEntities& entities, RoomGridLookup& roomgrid_lookup);
 
+void
+activeEntitiesSetGridPosition(ActiveEntities& entities,
+				  RoomGridLookup& roomgrid_lookup,
+				  uint entity_id,
+				  Vec3F grid_position);
+
+void
+activeEntitiesSetRoomGridOwner(ActiveEntities& entities,
+				   RoomGridLookup& roomgrid_lookup,
+				   uint entity_id,
+				   int room_grid_owner_id);
+
+uint
+activeEntitiesDefragment(ActiveEntities& entities, uint max_swaps);
+
+// EntityCommandBuffer Function Prototypes
+
+void
+entityCommandBufferCreate(EntityCommandBuffer& buffer,
+			      int room_grid_owner_id,
+			      int room_grid_id,
+			      Vec3F origin,
+			      uint entity_type);
+
+void
+entityCommandBufferDestroy(EntityCommandBuffer& buffer, int entity_handle);
+
+void
+entityCommandBufferMove(EntityCommandBuffer& buffer, int entity_handle, Vec3F new_grid_pos);
+
+void
+entityCommandBufferPlayback(EntityCommandBuffer& buffer,
+				ActiveEntities& entities,
+				RoomGridLookup& roomgrid_lookup);
+
 // Transform Function Prototypes
 
 inline Mat4F
-transformGetModel(const Transform& transform)
+transformGetModel(Vec3F position, Vec3F scale)
 {
-    Mat4F model = Mat4F(transform.scale.x, 0.0f, 0.0f, transform.position.x,
-	                0.0f, transform.scale.y, 0.0f, transform.position.y,
-	                0.0f, 0.0f, transform.scale.z, transform.position.z,
+    Mat4F model = Mat4F(scale.x, 0.0f, 0.0f, position.x,
+	                0.0f, scale.y, 0.0f, position.y,
+	                0.0f, 0.0f, scale.z, position.z,
 	                0.0f, 0.0f, 0.0f, 1.0f);
     return model;
 }
 
+uint
+roomTransformTableUpdateEntity(const RoomTransformTable& table, ActiveEntities& entities, uint i);
+
+#if AVX2_KERNELS
+uint
+roomTransformTableUpdateRange(const RoomTransformTable& table, ActiveEntities& entities,
+			      uint begin_ID, uint end_ID);
+#endif
+
 // Camera Function Prototypes
 
 void
@@ -279,55 +858,113 @@ cameraOffsetAngles(Camera& cam, float o_yaw, float o_pitch);
 // RoomGrid Function Prototypes
 
 int
-roomGridGetEntity(RoomGrid& room_grid, Vec3F pos);
+roomGridGetEntity(const RoomGrid& room_grid, Vec3F pos);
 
-inline void
-roomGridSetEntity(RoomGrid& room_grid, Vec3F pos, int entity_ID)
+RoomGridCell
+roomGridGetCell(const RoomGrid& room_grid, Vec3F pos);
+
+void
+roomGridSetEntity(RoomGrid& room_grid, Vec3F pos, int entity_handle, uint cell_flags);
+
+void
+roomGridClearCellFlags(RoomGrid& room_grid, Vec3F pos);
+
+void
+roomGridRemoveEntity(RoomGrid& room_grid, Vec3F pos);
+
+inline bool
+roomGridContains(const RoomGrid& room_grid, Vec3F pos)
 {
-    _assert(pos.x >= 0.0f && pos.x < RG_MAX_WIDTH);
-    _assert(pos.y >= 0.0f && pos.y < RG_MAX_HEIGHT);
-    _assert(pos.z >= 0.0f && pos.z < RG_MAX_LENGTH);
-    
-    room_grid.grid[(int)pos.x][(int)pos.y][(int)pos.z] = entity_ID;
+    return (pos.x >= 0.0f && pos.x < room_grid.width &&
+	    pos.y >= 0.0f && pos.y < room_grid.height &&
+	    pos.z >= 0.0f && pos.z < room_grid.length);
 }
 
-inline void
-roomGridRemoveEntity(RoomGrid& room_grid, Vec3F pos)
+inline float
+roomGridGetSpan(const RoomGrid& room_grid)
 {
-    _assert(pos.x >= 0.0f && pos.x < RG_MAX_WIDTH);
-    _assert(pos.y >= 0.0f && pos.y < RG_MAX_HEIGHT);
-    _assert(pos.z >= 0.0f && pos.z < RG_MAX_LENGTH);
-    
-    room_grid.grid[(int)pos.x][(int)pos.y][(int)pos.z] = -1;
+    // A nested RoomGrid is scaled so its footprint fits the cell holding it
+    return (float)((room_grid.width > room_grid.length) ? room_grid.width : room_grid.length);
+}
+
+inline uint
+roomGridGetBrickIndex(const RoomGrid& room_grid, uint x, uint y, uint z)
+{
+    return ((x / RG_BRICK_SIZE) * room_grid.bricks_height + (y / RG_BRICK_SIZE)) *
+	    room_grid.bricks_length + (z / RG_BRICK_SIZE);
+}
+
+inline uint
+roomGridMortonEncode(uint x, uint y, uint z)
+{
+    // Interleaves the low 2 bits of x, y and z as x1 y1 z1 x0 y0 z0
+#ifdef __AVX2__
+    return _pdep_u32(x, 0x24) | _pdep_u32(y, 0x12) | _pdep_u32(z, 0x09);
+#else
+    return ((x & 1) << 2) | ((x & 2) << 4) |
+	   ((y & 1) << 1) | ((y & 2) << 3) |
+	   (z & 1)        | ((z & 2) << 2);
+#endif
 }
 
 inline void
-roomGridRemoveOwner(RoomGrid& rg, ActiveEntities& entities)
+roomGridMortonDecode(uint code, uint& x, uint& y, uint& z)
 {
-    // Set proper transform and scale
-    // Set owner ID to -1
+#ifdef __AVX2__
+    x = _pext_u32(code, 0x24);
+    y = _pext_u32(code, 0x12);
+    z = _pext_u32(code, 0x09);
+#else
+    x = ((code >> 2) & 1) | ((code >> 4) & 2);
+    y = ((code >> 1) & 1) | ((code >> 3) & 2);
+    z = (code & 1)        | ((code >> 2) & 2);
+#endif
+}
 
-    rg.previous_scale = 1.0f;
-    rg.current_scale  = 1.0f;
-    rg.target_scale   = 1.0f;
-    rg.t = 1.0f;
-    rg.center = Vec3F(RG_MAX_WIDTH * rg.current_scale * 0.5f, 0.0f, RG_MAX_LENGTH * rg.current_scale * 0.5f);
+inline uint
+roomGridGetBrickCell(uint x, uint y, uint z)
+{
+#if ROOMGRID_MORTON_CELLS
+    return roomGridMortonEncode(x % RG_BRICK_SIZE, y % RG_BRICK_SIZE, z % RG_BRICK_SIZE);
+#else
+    return ((x % RG_BRICK_SIZE) * RG_BRICK_SIZE + (y % RG_BRICK_SIZE)) * RG_BRICK_SIZE +
+	    (z % RG_BRICK_SIZE);
+#endif
+}
 
-    // Get owner's entity ID
-    int owner_entity_id = -1;
-    for(uint i = 0; i < MAX_ENTITIES; i++)
-    {
-	if (entities.roomgrid_ids[i] == rg.roomgrid_owner_id)
-	{
-	    owner_entity_id = i;
-	}
-    }
-    
-    activeEntitiesMarkInactive(entities, owner_entity_id); // TODO: We can't remove roomgrids currently,
-                                                           // need to review removeInactives code
-    rg.roomgrid_owner_id = -1; 
+inline Vec3F
+roomGridGetCellPosition(const RoomGrid& room_grid, uint brick, uint cell)
+{
+    // Inverse of roomGridGetBrickIndex / roomGridGetBrickCell
+#if ROOMGRID_MORTON_CELLS
+    uint cell_x, cell_y, cell_z;
+    roomGridMortonDecode(cell, cell_x, cell_y, cell_z);
+#else
+    uint cell_x = cell / (RG_BRICK_SIZE * RG_BRICK_SIZE);
+    uint cell_y = (cell / RG_BRICK_SIZE) % RG_BRICK_SIZE;
+    uint cell_z = cell % RG_BRICK_SIZE;
+#endif
+    uint x = (brick / (room_grid.bricks_height * room_grid.bricks_length)) * RG_BRICK_SIZE + cell_x;
+    uint y = ((brick / room_grid.bricks_length) % room_grid.bricks_height) * RG_BRICK_SIZE + cell_y;
+    uint z = (brick % room_grid.bricks_length) * RG_BRICK_SIZE + cell_z;
+    return Vec3F((float)x, (float)y, (float)z);
 }
 
+inline bool
+roomGridBrickIsShared(const RoomGrid& room_grid, uint brick)
+{
+    // True while a clone's brick still holds its template's entities
+    return (room_grid.template_id > -1 &&
+	    room_grid.bricks[brick] &&
+	    room_grid.bricks[brick]->ref_count > 1);
+}
+
+uint
+roomGridGetMemory(const RoomGrid& room_grid);
+
+void
+roomGridRemoveOwner(RoomGrid& rg, ActiveEntities& entities, RoomGridLookup& roomgrid_lookup);
+
 Vec3F
 roomGridFindNearestType(RoomGrid& room_grid, ActiveEntities& entities,
 			       Vec3F cur_pos, uint target_type);
@@ -338,8 +975,87 @@ roomGridGetFirstIDByType(const RoomGrid* rg_p, const ActiveEntities* entities_p,
 void
 roomGridLookupInit(RoomGridLookup& rgl);
 
+void
+roomGridLookupSetExtents(RoomGridLookup& rgl, uint roomgrid_id, uint width, uint height, uint length);
+
+int
+roomGridLookupAddID(RoomGridLookup& rgl);
+
+// RoomGrid Templates //
+
+// A template RoomGrid is filled like any other but held by no entity, so it is never
+// drawn. activeEntitiesCreateRoomClone makes a RoomGrid sharing the template's bricks,
+// costing one pointer per brick. The template's entities stand in for the clone's until
+// the clone writes to a brick: roomGridPrepareWrite then copies the brick & creates an
+// entity of the same type for each template entity in it, so the clone's memory follows
+// its differences from the template. The copies are published at once, so
+// roomGridPrepareWrite is called outside systems. A template must not change once cloned
+// & must not hold RoomGrids itself.
+
+int
+roomGridLookupAddTemplate(RoomGridLookup& rgl, uint roomgrid_id);
+
+int
+activeEntitiesCreateRoomClone(ActiveEntities& entities,
+				  RoomGridLookup& roomgrid_lookup,
+				  int room_grid_owner_id,
+				  int room_grid_id,
+				  int template_id,
+				  Vec3F origin,
+				  uint entity_type);
+
+int
+roomGridPrepareWrite(RoomGrid& room_grid, ActiveEntities& entities, RoomGridLookup& roomgrid_lookup, Vec3F pos);
+
+// Grid Moves //
+
+// An entity moving onto a pushable entity pushes it, and the line of pushable entities
+// in front of it, a cell along the move. Lines cross into pushed BLOCK_ROOMs that are
+// blocked & out of nested RoomGrids. roomGridGetPushLine scans a line into one GridMove
+// per entity without writing anything, roomGridMoveEntities scans & commits it.
+
+#define GRID_PUSH_MAX_LINE    1024  // Entities moved by one push
+#define GRID_PUSH_MAX_ENTRIES 8     // BLOCK_ROOMs entered by one push, bounds self-references
+
+typedef struct GridMove
+{
+    RoomGrid* from_p;
+    Vec3F     from;
+    RoomGrid* to_p;
+    Vec3F     to;
+} GridMove;
+
+int
+roomGridGetPushLine(RoomGrid& grid,
+		    const ActiveEntities& entities,
+		    const RoomGridLookup& roomgrid_lookup,
+		    Vec3F cur_grid_pos,
+		    Vec3F new_grid_pos,
+		    std::vector<GridMove>& moves);
+
+int
+roomGridMoveEntities(RoomGrid& grid,
+		     ActiveEntities& entities,
+		     RoomGridLookup& roomgrid_lookup,
+		     Vec3F cur_grid_pos,
+		     Vec3F new_grid_pos,
+		     std::vector<GridMove>& moves);
+
 // AI Function Prototypes
 Vec3F
 aStarFindPath(RoomGrid& grid, Vec3F cur_grid_pos, Vec3F target_grid_pos);
 
+inline uint
+aiRandom(AI& ai, int entity_handle)
+{
+    // xorshift32 kept in the component, so AI jobs on any thread share no RNG state.
+    // AI components are copied from their type's prefab, so each is seeded from its
+    // entity's handle on first use.
+    if(ai.rng_state == 0) {ai.rng_state = (AI_RNG_SEED ^ ((uint)entity_handle * 0x9E3779B9u)) | 1;}
+    ai.rng_state ^= ai.rng_state << 13;
+    ai.rng_state ^= ai.rng_state >> 17;
+    ai.rng_state ^= ai.rng_state << 5;
+    return ai.rng_state;
+}
+
 #endif
@@ -0,0 +1,44 @@
+// ====================================================================================
+// Title: entity_traits.hpp
+// Description: Compile-time copy of data/templates/entity_templates.txt, used by
+//              builds with STATIC_ENTITY_TEMPLATES
+// ====================================================================================
+
+#ifndef ENTITY_TRAITS_H
+#define ENTITY_TRAITS_H
+
+// Set to 1 (e.g. -DSTATIC_ENTITY_TEMPLATES=1 in build.bat) to resolve component checks
+// from the signatures below at compile time. The systems iterate queries & need no
+// checks, so this affects creation & the per-type removal kernel in ecs.cpp. The
+// template file is still loaded, and platformLoadEntityTemplatesFromTxt reports any
+// difference from these signatures. tests/test_templates.cpp fails if the two differ.
+// Leave at 0 for modded template files.
+#ifndef STATIC_ENTITY_TEMPLATES
+#define STATIC_ENTITY_TEMPLATES 0
+#endif
+
+#define TRAIT(component) (1u << COMPONENT_##component)
+
+// EntityType -> component mask. Must match data/templates/entity_templates.txt
+constexpr uint ENTITY_TEMPLATE_SIGNATURES[TOTAL_ENTITY_TYPES] =
+{
+    /* NONE          */ TRAIT(STATE),
+    /* CHEST         */ TRAIT(TRANSFORM) | TRAIT(RENDER) | TRAIT(SFX) | TRAIT(GRID_POSITION) | TRAIT(STATE) | TRAIT(COLLISION),
+    /* GRID          */ TRAIT(STATE),
+    /* CAMERA        */ TRAIT(TRANSFORM) | TRAIT(CAMERA) | TRAIT(STATE),
+    /* DIR_LIGHT     */ TRAIT(DIR_LIGHT) | TRAIT(STATE),
+    /* PLAYER        */ TRAIT(TRANSFORM) | TRAIT(RENDER) | TRAIT(GRID_POSITION) | TRAIT(STATE) | TRAIT(PLAYER) | TRAIT(COLLISION),
+    /* BLOCK         */ TRAIT(TRANSFORM) | TRAIT(RENDER) | TRAIT(GRID_POSITION) | TRAIT(STATE) | TRAIT(COLLISION),
+    /* SPECIAL_BLOCK */ TRAIT(TRANSFORM) | TRAIT(RENDER) | TRAIT(GRID_POSITION) | TRAIT(STATE) | TRAIT(PUSHABLE),
+    /* BLOCK_ROOM    */ TRAIT(TRANSFORM) | TRAIT(GRID_POSITION) | TRAIT(STATE) | TRAIT(PUSHABLE) | TRAIT(ROOM_GRID)
+};
+
+#undef TRAIT
+
+constexpr bool
+entityTraitsHas(uint entity_type, uint component)
+{
+    return ((ENTITY_TEMPLATE_SIGNATURES[entity_type % TOTAL_ENTITY_TYPES] >> component) & 1) != 0;
+}
+
+#endif
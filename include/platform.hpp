@@ -41,6 +41,65 @@ typedef struct GameWindow
     bool   close;
 } GameWindow;
 
+// Struct RoomImpostors //
+
+// A RoomGrid projecting to fewer than RG_IMPOSTOR_PIXELS on screen is drawn as a single
+// box tinted with the average diffuse color of its contents, & the RoomGrids nested in
+// it are not drawn at all, so the draw count stays flat however deep the nesting goes.
+// A tint is rebuilt only after its RoomGrid's contents change (see impostor_dirty).
+//
+// A RoomGrid shown by reference holders (see RoomGrid::references) has no transforms of
+// its own there, so its instances are expanded here breadth-first, largest first. An
+// instance under RG_IMPOSTOR_PIXELS becomes an impostor & past RG_MAX_ROOM_INSTANCES
+// expansions a frame every remaining instance does, which bounds self-referencing rooms.
+
+#define CAM_ORTHO_HEIGHT      30.0f  // World units covered by the height of the view
+#define RG_IMPOSTOR_PIXELS    24.0f
+#define RG_MAX_ROOM_INSTANCES 64
+
+// Set to 1 to print the draw call & impostor counters every frame
+#ifndef RENDER_PRINT_COUNTERS
+#define RENDER_PRINT_COUNTERS 0
+#endif
+
+typedef enum RoomLod
+{
+    ROOM_LOD_FULL = 0,
+    ROOM_LOD_IMPOSTOR,
+    ROOM_LOD_HIDDEN,   // Inside an impostor
+    ROOM_LOD_UNKNOWN
+} RoomLod;
+
+typedef struct RoomInstance
+{
+    int   roomgrid_id;
+    Vec3F base;         // Position of cell 0
+    float scale;
+} RoomInstance;
+
+typedef struct RoomInstanceDraw
+{
+    Mat4F model;
+    int   entity_id;    // -1 draws the impostor box of roomgrid_id
+    int   roomgrid_id;
+} RoomInstanceDraw;
+
+typedef struct RoomImpostors
+{
+    std::vector<uchar>  lods;             // RoomGrid id + 1 -> RoomLod, entry 0 is outside any RoomGrid
+    std::vector<GLuint> texture_ids;      // RoomGrid id -> 1x1 tint texture, 0 until first needed
+    std::vector<uint>   tint_counts;      // RoomGrid id -> rendered entities in the tint, 0 draws no box
+    Vec3F type_colors[TOTAL_ENTITY_TYPES];
+    bool  type_colors_set[TOTAL_ENTITY_TYPES];
+    std::vector<RoomInstance>     instance_queue;
+    std::vector<RoomInstanceDraw> instance_draws;  // Draws of shared RoomGrid instances & clones' template cells
+    uint  impostor_count;                 // Counters of the last frame
+    uint  instance_count;
+    uint  shadow_draw_calls;
+    uint  draw_calls;
+    RoomImpostors();
+} RoomImpostors;
+
 // Platform Function Prototypes //
 
 int
@@ -75,10 +134,18 @@ platformRenderShadowMapToScreen(AssetManager& asset_manager,
 				     GameWindow& game_window,
 				     FrameTexture& depth_framebuffer);
 
+void
+platformUpdateRoomImpostors(RoomImpostors& impostors,
+				 const ActiveEntities& active_entities,
+				 const RoomGridLookup& roomgrid_lookup,
+				 AssetManager& asset_manager,
+				 const FrameTexture& framebuffer);
+
 void
 platformRenderShadowMapToBuffer(ActiveEntities& active_entities,
 				     const FrameTexture& depth_framebuffer,
 				     const RoomGridLookup& roomgrid_lookup,
+				     RoomImpostors& impostors,
 				     AssetManager& asset_manager,
 				     const GameWindow& game_window,
 				     uint dir_light_id);
@@ -88,6 +155,7 @@ platformRenderEntitiesToBuffer(const ActiveEntities& active_entities,
 				    const FrameTexture& framebuffer,
 				    const FrameTexture& depth_framebuffer,
 				    const RoomGridLookup& roomgrid_lookup,
+				    RoomImpostors& impostors,
 				    const GameWindow& game_window,
 				    AssetManager& asset_manager,
 				    uint dir_light_id,
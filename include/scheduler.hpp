@@ -0,0 +1,123 @@
+// ====================================================================================
+// Title: scheduler.hpp
+// Description: The header file for the system scheduler, which runs entity systems
+//              on a pool of worker threads
+// ====================================================================================
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// Utility Libs
+#include "utility.hpp"
+#include "ecs.hpp"
+
+// C/C++ Utility Lib
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Set to 1 to run every system on the calling thread, in registration order.
+// Can also be toggled at runtime through SystemScheduler::force_serial.
+#ifndef SCHEDULER_FORCE_SERIAL
+#define SCHEDULER_FORCE_SERIAL 0
+#endif
+
+// Set to 1 to print the number of entities each system visited & touched every frame
+#ifndef SCHEDULER_PRINT_COUNTERS
+#define SCHEDULER_PRINT_COUNTERS 0
+#endif
+
+#define MAX_SYSTEMS 32  // Dependencies are stored as a bit per system
+#define MAX_WORKERS 15
+
+// Struct System //
+
+// A system runs its update once for every active entity in its query. The component
+// masks it reads & writes decide which systems it can run alongside: two systems
+// conflict if one writes a component the other reads or writes, and a conflicting
+// system always runs after every conflicting system registered before it, so the
+// results match the serial order.
+// A local system only touches components of the entities in its own query, so it
+// does not conflict with another local system whose query shares no entity type.
+// A system with a chunk size > 0 updates each entity independently, and its query
+// is split into jobs of chunk_size entities.
+// A system with a bitset visits the live entities with that bit set in ID order,
+// instead of its query list. Its jobs are ranges of 64-entity bitset words.
+// A bitset system can also take a range update, which is handed the whole ID range of
+// a job to scan itself, e.g. 8 entities per AVX instruction.
+// The update returns 1 if it changed the entity, 0 if there was nothing to do. The
+// range update returns the number of entities it changed.
+
+typedef void (*SystemBegin)();
+typedef uint (*SystemUpdate)(uint entity_ID);
+typedef uint (*SystemUpdateRange)(uint begin_ID, uint end_ID);
+
+typedef struct System
+{
+    c_char*      name;
+    SystemBegin  begin;         // Run once on the calling thread before the updates. May be NULL.
+    SystemUpdate update;
+    SystemUpdateRange update_range;  // Replaces update if not NULL
+    uint         query;
+    uint         reads;         // Component mask
+    uint         writes;        // Component mask
+    bool         local;
+    uint         chunk_size;    // 0 to run the whole query as one job
+    int          bitset;        // EntityBitset to iterate, -1 to iterate the query list
+    uint         dependencies;  // Bit per system that must complete first
+    uint         level;         // Wave of the dependency graph the system runs in
+    uint         visited;       // Entities updated last run
+    uint         touched;       // Entities the updates changed last run
+} System;
+
+// Struct SystemScheduler //
+
+typedef struct SystemJob
+{
+    uint system;
+    uint begin;  // Range of the system's query list, or of bitset words
+    uint end;
+} SystemJob;
+
+typedef struct SystemScheduler
+{
+    System                  systems[MAX_SYSTEMS];
+    uint                    system_count;
+    uint                    level_count;
+    bool                    force_serial;
+
+    // Worker pool
+    std::thread             workers[MAX_WORKERS];
+    uint                    worker_count;
+    std::mutex              mutex;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    std::vector<SystemJob>  jobs;
+    uint                    next_job;
+    uint                    jobs_remaining;
+    bool                    quit;
+    const ActiveEntities*   entities_p;
+
+    SystemScheduler();
+    ~SystemScheduler();
+} SystemScheduler;
+
+int  schedulerRegisterSystem(SystemScheduler& scheduler,
+			     c_char* name,
+			     SystemBegin begin,
+			     SystemUpdate update,
+			     uint query,
+			     uint reads,
+			     uint writes,
+			     bool local,
+			     uint chunk_size);
+void schedulerSetSystemBitset(SystemScheduler& scheduler, int system, int bitset);
+void schedulerSetSystemRange(SystemScheduler& scheduler, int system, SystemUpdateRange update_range);
+void schedulerBuild(SystemScheduler& scheduler, const ActiveEntities& entities);
+void schedulerStartWorkers(SystemScheduler& scheduler, uint worker_count);
+void schedulerStopWorkers(SystemScheduler& scheduler);
+void schedulerRun(SystemScheduler& scheduler, const ActiveEntities& entities);
+void schedulerPrintCounters(const SystemScheduler& scheduler);
+
+#endif
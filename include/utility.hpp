@@ -10,6 +10,7 @@
 // TO-DO: Remove from release ver:
 #include <stdio.h>  
 #include <windows.h>
+#include <intrin.h>
 
 #if ASSERTIONS
 #include <assert.h>
@@ -32,8 +33,9 @@ typedef const unsigned char c_uchar;
 typedef const unsigned int  c_uint;
 
 // Unsigned
-typedef unsigned char uchar;
-typedef unsigned int  uint;
+typedef unsigned char      uchar;
+typedef unsigned int       uint;
+typedef unsigned long long uint64;
 
 // Signed
 typedef short int shint;
@@ -59,5 +61,38 @@ profilerGetTime(Profiler& p)
 
 // Utility Functions //
 
+// AVX2 kernels are built into every build & chosen at runtime with cpuHasAVX2, as
+// MSVC compiles AVX2 intrinsics without -arch:AVX2. Other compilers need -mavx2.
+#if defined(_MSC_VER) || defined(__AVX2__)
+#define AVX2_KERNELS 1
+#else
+#define AVX2_KERNELS 0
+#endif
+
+inline bool
+cpuHasAVX2()
+{
+    // True if the CPU supports AVX2 & the OS saves the YMM registers
+    int info[4];
+    __cpuid(info, 0);
+    if(info[0] < 7) {return false;}
+
+    __cpuid(info, 1);
+    bool has_osxsave = (info[2] & (1 << 27)) != 0;
+    bool has_avx     = (info[2] & (1 << 28)) != 0;
+    if(!has_osxsave || !has_avx || (_xgetbv(0) & 6) != 6) {return false;}
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+}
+
+inline bool
+cpuHasPopcnt()
+{
+    // True if the CPU has the popcnt instruction
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 23)) != 0;
+}
 
 #endif
@@ -5,20 +5,6 @@
 
 #include "ecs.hpp"
 
-// Struct Component Transform //
-
-Transform::Transform()
-{
-    position = Vec3F(0.0f, 0.0f, 0.0f);
-    scale    = Vec3F(1.0f, 1.0f, 1.0f);
-}
-
-Transform::Transform(Vec3F _position, Vec3F _scale)
-{
-    position = _position;
-    scale    = _scale;
-}
-
 // Struct Component Camera //
 
 Camera::Camera()
@@ -48,23 +34,10 @@ PointLight::PointLight()
     ambient_strength = 0.5f;
 }
 
-// Struct Component GridPosition //
-
-GridPosition::GridPosition()
-{
-    position = Vec3F(0.0f, 0.0f, 0.0f);
-}
-
-GridPosition::GridPosition(Vec3F _position)
-{
-    position = _position; 
-}
-
 // Struct Component State //
 
 State::State()
 {
-    inactive = true;
     input_cooldown = 0;
 }
 
@@ -73,8 +46,8 @@ State::State()
 Node::Node()
 {
     grid_pos = Vec3F(0.0f, 0.0f, 0.0f);
-    g_cost = RG_MAX_WIDTH * RG_MAX_LENGTH * 3;
-    h_cost = RG_MAX_WIDTH * RG_MAX_LENGTH * 3;
+    g_cost = RG_MAX_EXTENT * RG_MAX_EXTENT * 3;
+    h_cost = RG_MAX_EXTENT * RG_MAX_EXTENT * 3;
     f_cost = g_cost + h_cost;
     parent_p = NULL;
 }
@@ -96,6 +69,14 @@ AI::AI()
 {
     face_dir  = Vec3F(0.0f, 0.0f, 1.0f);
     next_move = MOVE_WALK;
+    rng_state = 0;
+}
+
+// Struct Prefab //
+
+Prefab::Prefab()
+{
+    scale = Vec3F(1.0f, 1.0f, 1.0f);
 }
 
 // Struct EntityTemplates //
@@ -106,240 +87,2334 @@ EntityTemplates::EntityTemplates()
     memset(table, 0, TOTAL_ENTITY_TYPES * TOTAL_COMPONENT_TYPES * sizeof(uint));
 }
 
+int
+entityTemplatesLoadFromTxt(EntityTemplates& entity_templates, c_char* path)
+{
+    // Returns 1 on success, 0 on failure
+
+    FILE* file_p = NULL;
+    fopen_s(&file_p, path, "r");
+    if(!file_p) {return 0;}
+
+    char  next[256];
+    int   entity_type;
+    int   component_type;
+    
+    do
+    {
+	// Get first string
+	fscanf_s(file_p, "%s", next, 256);
+	if(next[0] != '#')
+	{
+	    // Read entity type
+	    fscanf_s(file_p, "%i", &entity_type);
+	    // Eat hyphen
+	    fscanf_s(file_p, "%s", next, 256);
+	    do
+	    {
+		// Get component type
+		fscanf_s(file_p, "%i", &component_type);
+		if(component_type != -1) {entity_templates.table[entity_type][component_type] = 1;}
+	    } while(component_type != -1);
+	}
+	else
+	{
+	    // Eat line
+	    fgets(next, sizeof(next), file_p);
+	}
+    } while(!feof(file_p)); 
+    fclose(file_p);
+
+    return 1;
+}
+
 // Struct LevelGrid //
 
-RoomGrid::RoomGrid()
+RoomGrid::RoomGrid() : RoomGrid(RG_DEFAULT_WIDTH, RG_DEFAULT_HEIGHT, RG_DEFAULT_LENGTH)
 {
-    memset(grid, -1, RG_MAX_WIDTH * RG_MAX_HEIGHT * RG_MAX_LENGTH * sizeof(int));
 }
 
-// ActiveEntities Functions //
+RoomGrid::RoomGrid(uint _width, uint _height, uint _length)
+{
+    _assert(_width  > 0 && _width  <= RG_MAX_EXTENT);
+    _assert(_height > 0 && _height <= RG_MAX_EXTENT);
+    _assert(_length > 0 && _length <= RG_MAX_EXTENT);
+    
+    width  = _width;
+    height = _height;
+    length = _length;
+    bricks_height = (height + RG_BRICK_SIZE - 1) / RG_BRICK_SIZE;
+    bricks_length = (length + RG_BRICK_SIZE - 1) / RG_BRICK_SIZE;
+    brick_count   = ((width + RG_BRICK_SIZE - 1) / RG_BRICK_SIZE) * bricks_height * bricks_length;
+    bricks    = new RoomGridBrick*[brick_count]();
+    occupancy = new uint64[brick_count]();
 
-ActiveEntities::ActiveEntities()
+    size_class = RG_SIZE_ANY;
+    if(width == RG_DEFAULT_WIDTH && height == RG_DEFAULT_HEIGHT && length == RG_DEFAULT_LENGTH)
+    {
+	size_class = RG_SIZE_DEFAULT;
+    }
+    else if(width == RG_SMALL_WIDTH && height == RG_SMALL_HEIGHT && length == RG_SMALL_LENGTH)
+    {
+	size_class = RG_SIZE_SMALL;
+    }
+
+    center = Vec3F(width * current_scale * 0.5f, 0.0f, length * current_scale * 0.5f);
+}
+
+RoomGrid::~RoomGrid()
 {
-    // Initialize all types to 0 (meaning no type, vacancy)
-    memset(types, NONE, MAX_ENTITIES * sizeof(uint));
+    // Bricks shared with a template or its other clones are freed by the last holder
+    for(uint i = 0; i < brick_count; i++)
+    {
+	if(bricks[i] && --bricks[i]->ref_count == 0) {delete bricks[i];}
+    }
+    delete[] bricks;
+    delete[] occupancy;
+    delete[] push_marks;
+}
 
-    // Init all roomgrid IDs to -1
-    for(uint i = 0; i < MAX_ENTITIES; i++)
+static void
+roomGridLookupReserve(RoomGridLookup& rgl, uint roomgrid_count)
+{
+    // Grows the lookup to hold ids below roomgrid_count
+    uint prior_count = (uint)rgl.roomgrid_pointers.size();
+    if(roomgrid_count <= prior_count) {return;}
+    rgl.roomgrid_pointers.resize(roomgrid_count, NULL);
+    rgl.extents.resize(roomgrid_count * 3);
+    for(uint i = prior_count; i < roomgrid_count; i++)
     {
-	roomgrid_ids[i] = -1;
+	rgl.extents[i * 3 + 0] = RG_DEFAULT_WIDTH;
+	rgl.extents[i * 3 + 1] = RG_DEFAULT_HEIGHT;
+	rgl.extents[i * 3 + 2] = RG_DEFAULT_LENGTH;
     }
-    
-    count = 0;
 }
 
-int
-activeEntitiesCreateEntity(ActiveEntities& entities,
-			       RoomGridLookup& roomgrid_lookup,
-			       int room_grid_owner_id,
-			       int room_grid_id,
-			       Vec3F origin,
-			       uint entity_type)
+static void
+roomGridAddContents(RoomGrid& room_grid, ActiveEntities& entities, const int* entity_handles, uint count)
+{
+    // The entities may still be pending, so they are found through sparse_to_dense
+    uint first_slot = (uint)room_grid.contents.size();
+    room_grid.contents.insert(room_grid.contents.end(), entity_handles, entity_handles + count);
+    for(uint k = 0; k < count; k++)
+    {
+	uint index = entityHandleGetIndex(entity_handles[k]);
+	uint id    = entities.sparse_to_dense[index];
+	entities.roomgrid_slots[index] = first_slot + k;
+
+	RoomGridTypeList& list = room_grid.type_lists[entities.types[id]];
+	entities.roomgrid_type_slots[index] = (uint)list.handles.size();
+	list.handles.push_back(entity_handles[k]);
+	list.xs.push_back(entities.grid_positions.x[id]);
+	list.ys.push_back(entities.grid_positions.y[id]);
+	list.zs.push_back(entities.grid_positions.z[id]);
+    }
+    room_grid.impostor_dirty = true;
+}
+
+static void
+roomGridRemoveContent(RoomGrid& room_grid, ActiveEntities& entities, int entity_handle)
+{
+    // Swaps the last handle into the removed handle's slot
+    uint slot = entities.roomgrid_slots[entityHandleGetIndex(entity_handle)];
+    _assert(slot < room_grid.contents.size() && room_grid.contents[slot] == entity_handle);
+    int last_handle = room_grid.contents.back();
+    room_grid.contents[slot] = last_handle;
+    entities.roomgrid_slots[entityHandleGetIndex(last_handle)] = slot;
+    room_grid.contents.pop_back();
+
+    // Same for its type list
+    uint index = entityHandleGetIndex(entity_handle);
+    RoomGridTypeList& list = room_grid.type_lists[entities.types[entities.sparse_to_dense[index]]];
+    uint type_slot = entities.roomgrid_type_slots[index];
+    _assert(type_slot < list.handles.size() && list.handles[type_slot] == entity_handle);
+    int last_type_handle = list.handles.back();
+    list.handles[type_slot] = last_type_handle;
+    list.xs[type_slot] = list.xs.back();
+    list.ys[type_slot] = list.ys.back();
+    list.zs[type_slot] = list.zs.back();
+    entities.roomgrid_type_slots[entityHandleGetIndex(last_type_handle)] = type_slot;
+    list.handles.pop_back();
+    list.xs.pop_back();
+    list.ys.pop_back();
+    list.zs.pop_back();
+    room_grid.impostor_dirty = true;
+}
+
+// Archetype Functions //
+
+static uint
+archetypeGetChunkedComponentSize(uint component)
+{
+    // Returns the column stride of components stored in archetype chunks, 0 for
+    // components stored in the ActiveEntities columns.
+
+    switch(component)
+    {
+        case COMPONENT_CAMERA:      return sizeof(Camera);
+        case COMPONENT_DIR_LIGHT:   return sizeof(DirLight);
+        case COMPONENT_POINT_LIGHT: return sizeof(PointLight);
+        case COMPONENT_AI:          return sizeof(AI);
+        default:                    return 0;
+    }
+}
+
+static uint
+archetypeGetChunkSize(const Archetype& archetype, uint capacity)
 {
-    // Returns entity ID on success, -1 on failure
+    // Returns the bytes needed for a chunk of the given capacity, with every column
+    // starting on a cache line
     
-    _assert(entity_type >= 0 && entity_type < TOTAL_ENTITY_TYPES);
+    uint size = capacity * sizeof(int);
+    for(uint i = 0; i < TOTAL_COMPONENT_TYPES; i++)
+    {
+	if(archetype.column_strides[i])
+	{
+	    size  = (size + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+	    size += capacity * archetype.column_strides[i];
+	}
+    }
+    return size;
+}
+
+static void
+archetypeInit(Archetype& archetype, uint signature)
+{
+    archetype.signature = signature;
+    archetype.count     = 0;
 
-    if (entities.count < MAX_ENTITIES)
+    // Size the columns of the chunked components in this component set
+    uint row_size = sizeof(int);
+    for(uint i = 0; i < TOTAL_COMPONENT_TYPES; i++)
     {
-	// Activate entity
-	entities.states[entities.count].inactive = false; 
-	// Set new type
-	entities.types[entities.count] = entity_type;
-	// sets transform even if never used
-	entities.transforms[entities.count] = Transform(origin, Vec3F(1.0f, 1.0f, 1.0f));
-	// if entity has a roomgrid component, store its lookup id and allocate the roomgrid
-	if(entities.entity_templates.table[entity_type][COMPONENT_ROOM_GRID])
+	archetype.column_offsets[i] = 0;
+	archetype.column_strides[i] = (signature & componentMask(i)) ? archetypeGetChunkedComponentSize(i) : 0;
+	row_size += archetype.column_strides[i];
+    }
+
+    // Fit as many rows as possible, leaving room for the cache line padding
+    uint capacity = ARCHETYPE_CHUNK_SIZE / row_size;
+    while(archetypeGetChunkSize(archetype, capacity) > ARCHETYPE_CHUNK_SIZE) {capacity--;}
+    archetype.chunk_capacity = capacity;
+
+    // Lay out the columns
+    uint offset = capacity * sizeof(int);
+    for(uint i = 0; i < TOTAL_COMPONENT_TYPES; i++)
+    {
+	if(archetype.column_strides[i])
 	{
-	    entities.roomgrid_ids[entities.count] = room_grid_id;
-	    if(room_grid_id > -1)
-	    {
-		roomgrid_lookup.roomgrid_pointers[room_grid_id] = new RoomGrid();
-		roomgrid_lookup.roomgrid_pointers[room_grid_id]->roomgrid_owner_id = room_grid_owner_id;
-	    }
+	    offset = (offset + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+	    archetype.column_offsets[i] = offset;
+	    offset += capacity * archetype.column_strides[i];
+	}
+    }
+}
+
+static void
+componentFill(void* dest_p, const void* prototype_p, uint stride, uint count)
+{
+    // Fills count elements with copies of the prototype, doubling the copied block
+    // each pass so large fills run at memcpy speed
+    if(!count) {return;}
+    uchar* bytes_p = (uchar*)dest_p;
+    memcpy(bytes_p, prototype_p, stride);
+    size_t filled = stride;
+    size_t total  = (size_t)stride * count;
+    while(filled < total)
+    {
+	size_t copy = (total - filled < filled) ? total - filled : filled;
+	memcpy(bytes_p + filled, bytes_p, copy);
+	filled += copy;
+    }
+}
+
+static uint
+archetypeAddRows(Archetype& archetype, int first_entity_ID, uint count, Prefab& prefab)
+{
+    // Adds count rows owned by consecutive entity IDs, their chunked components copied
+    // from the prefab. Allocates chunks as needed. Returns the first new row.
+
+    uint first_row = archetype.count;
+    while(archetype.count + count > archetypeGetChunkedCount(archetype))
+    {
+	uchar* chunk_p = (uchar*)_aligned_malloc(ARCHETYPE_CHUNK_SIZE, CACHE_LINE_SIZE);
+	_assert(chunk_p);
+	archetype.chunks.push_back(chunk_p);
+    }
+    archetype.count += count;
+
+    // Fill the rows a chunk at a time, each column is contiguous within a chunk
+    uint row = first_row;
+    while(row < archetype.count)
+    {
+	uint chunk_end = (row / archetype.chunk_capacity + 1) * archetype.chunk_capacity;
+	uint run = ((chunk_end < archetype.count) ? chunk_end : archetype.count) - row;
+	int* entity_IDs_p = archetypeGetEntityIDP(archetype, row);
+	for(uint k = 0; k < run; k++)
+	{
+	    entity_IDs_p[k] = first_entity_ID + (int)(row - first_row + k);
 	}
-	// if entity has a grid_position component, add to grid and set grid position
-	if(entities.entity_templates.table[entity_type][COMPONENT_GRID_POSITION])
+	for(uint i = 0; i < TOTAL_COMPONENT_TYPES; i++)
 	{
-	    entities.grid_positions[entities.count].roomgrid_owner_id = room_grid_owner_id;
-	    entities.grid_positions[entities.count].position = origin;
-	    if(room_grid_owner_id > -1)
+	    if(archetype.column_strides[i])
 	    {
-		roomGridSetEntity(*roomgrid_lookup.roomgrid_pointers[room_grid_owner_id],
-				  origin,
-				  entities.count);
+		componentFill(archetypeGetComponentP(archetype, row, i),
+			      prefabGetComponentP(prefab, i),
+			      archetype.column_strides[i],
+			      run);
 	    }
 	}
-	// Increase entity count
-	entities.count++;
-	// Return new entity ID
-	return entities.count - 1;
+	row += run;
     }
-    OutputDebugStringA("ERROR - Failed to create entity - Max entities reached.\n");
-    return -1;
+    
+    return first_row;
 }
 
-void
-activeEntitiesRemoveInactives(ActiveEntities& entities, RoomGridLookup& roomgrid_lookup)
+static int
+archetypeRemoveRow(Archetype& archetype, uint row)
 {
-    // Should be run after all other entity updates. Searches for inactive entities,
-    // if found, overwrites the inactive with the active entity on the end of the arrays,
-    // then decreases active_count by 1.
-    // Repeats until the type array is completely searched.
+    // Overwrites the row with the last row of the archetype. Returns the entity ID
+    // now stored at the row, or -1 if the removed row was the last one.
+
+    _assert(row < archetype.count);
 
-    for(int i = entities.count - 1; i >= 0; i--)
+    int moved_entity_ID = -1;
+    uint last = archetype.count - 1;
+    if(row != last)
     {
-	if(entities.states[i].inactive)
-	{	    
-	    // If inactive entity is on the grid, set ID of removed entity
-	    // back to -1 in the level grid:
-	    if(entities.entity_templates.table[entities.types[i]][COMPONENT_GRID_POSITION])
-	    {
-		int roomgrid_id = entities.grid_positions[i].roomgrid_owner_id;
-		if(roomgrid_id > -1)
-		{
-		    RoomGrid* grid_p = roomgrid_lookup.roomgrid_pointers[roomgrid_id];
-		    Vec3F inactive_grid_position = entities.grid_positions[i].position;
-		    roomGridRemoveEntity(*grid_p, inactive_grid_position);
-		}
-	    }
-	    // If replacement entity is on the grid, update ID of last active
-	    // entity in the grid, since it has changed
-	    if(entities.entity_templates.table[entities.types[entities.count - 1]][COMPONENT_GRID_POSITION])
+	for(uint i = 0; i < TOTAL_COMPONENT_TYPES; i++)
+	{
+	    if(archetype.column_strides[i])
 	    {
-		int roomgrid_id = entities.grid_positions[entities.count - 1].roomgrid_owner_id;
-		if(roomgrid_id > -1)
-		{
-		    RoomGrid* grid_p = roomgrid_lookup.roomgrid_pointers[roomgrid_id];
-		    Vec3F active_grid_position = entities.grid_positions[entities.count - 1].position;
-		    roomGridSetEntity(*grid_p, active_grid_position, i);
-		}
+		memcpy(archetypeGetComponentP(archetype, row, i),
+		       archetypeGetComponentP(archetype, last, i),
+		       archetype.column_strides[i]);
 	    }
-	    // If the inactive entity had a room grid component, update the lookup table
-	    // so it no longer points to the invalid room grid data
-	    if(entities.entity_templates.table[entities.types[i]][COMPONENT_ROOM_GRID])
-	    {
-		int roomgrid_id = entities.roomgrid_ids[i];
-		if(roomgrid_id > -1)
-		{
-		    delete roomgrid_lookup.roomgrid_pointers[roomgrid_id];
-		    roomgrid_lookup.roomgrid_pointers[roomgrid_id] = NULL;
-		}
+	}
+	moved_entity_ID = *archetypeGetEntityIDP(archetype, last);
+	*archetypeGetEntityIDP(archetype, row) = moved_entity_ID;
+    }
+    archetype.count--;
 
-		// TODO: Removing a blockroom entity requires removing all of the entities
-		//       it contains as well. 
-	    }
-	    
-	    // Safe to copy grid position component now 
-	    entities.grid_positions[i] = entities.grid_positions[entities.count - 1];
-	    // Copy remaining component data from last active entity and fill inactive slot 
-	    entities.transforms[i]     = entities.transforms[entities.count - 1];
-	    entities.cameras[i]        = entities.cameras[entities.count - 1];
-	    entities.dir_lights[i]     = entities.dir_lights[entities.count - 1];
-	    entities.point_lights[i]   = entities.point_lights[entities.count - 1];
-	    entities.states[i]         = entities.states[entities.count - 1];
-	    entities.ai[i]             = entities.ai[entities.count - 1];
-	    entities.roomgrid_ids[i]   = entities.roomgrid_ids[entities.count - 1];
-            // Copy replacement entity's type last
-	    entities.types[i] = entities.types[entities.count - 1];
-	    // Set last active entity type to NONE for memory readability
-	    entities.types[entities.count - 1] = NONE;
-	    // Decrease entity count by one, effectively removing the inactive entity
-	    // while preserving the entity on the end of the arrays. 
-	    entities.count--;
+    // Free the last chunk once it is empty
+    if(archetype.count == archetypeGetChunkedCount(archetype) - archetype.chunk_capacity)
+    {
+	_aligned_free(archetype.chunks.back());
+	archetype.chunks.pop_back();
+    }
+
+    return moved_entity_ID;
+}
+
+// EntityQuery Functions //
+
+static void
+entityQueryAddRange(EntityQuery& query, uint first_entity_ID, uint count)
+{
+    for(uint k = 0; k < count; k++)
+    {
+	query.slots[first_entity_ID + k] = query.count + k;
+	query.ids[query.count + k]       = first_entity_ID + k;
+    }
+    query.count += count;
+}
+
+static void
+entityQueryRemove(EntityQuery& query, uint entity_ID)
+{
+    // Leaves a tombstone so the remaining IDs keep their creation order,
+    // entityQueryCompact drops it once all removals are done
+    query.ids[query.slots[entity_ID]] = QUERY_TOMBSTONE;
+    query.tombstones++;
+}
+
+static void
+entityQueryRename(EntityQuery& query, uint old_entity_ID, uint new_entity_ID)
+{
+    uint slot = query.slots[old_entity_ID];
+    query.ids[slot]            = new_entity_ID;
+    query.slots[new_entity_ID] = slot;
+}
+
+static void
+entityQueryCompact(EntityQuery& query)
+{
+    if(!query.tombstones) {return;}
+
+    uint count = 0;
+    for(uint i = 0; i < query.count; i++)
+    {
+	uint entity_ID = query.ids[i];
+	if(entity_ID != QUERY_TOMBSTONE)
+	{
+	    query.ids[count]       = entity_ID;
+	    query.slots[entity_ID] = count;
+	    count++;
 	}
     }
+    query.count      = count;
+    query.tombstones = 0;
 }
 
-// RoomGrid Functions //
+// EntityColumns Functions //
 
-int
-roomGridGetEntity(RoomGrid& room_grid, Vec3F pos)
+static SIZE_T
+entityColumnsGetSize(uint element_bits, uint capacity)
 {
-    // Returns entity on success. Returns -1 if no entity. Returns -2 if out of bounds.
-    
-    // Check that target position is valid (within the grid)
-    if(pos.x < 0.0f || pos.x >= RG_MAX_WIDTH ||
-       pos.y < 0.0f || pos.y >= RG_MAX_HEIGHT ||
-       pos.z < 0.0f || pos.z >= RG_MAX_LENGTH)
+    // Bytes taken by capacity elements, rounded up to whole 32-byte AVX registers
+    return ((SIZE_T)capacity * element_bits + 255) / 256 * 32;
+}
+
+static uchar*
+entityColumnsAddBits(EntityColumns& columns, uint element_bits)
+{
+    // Reserves a column of MAX_ENTITIES elements. Returns the column, NULL on failure.
+    _assert(columns.count < MAX_ENTITY_COLUMNS);
+
+    SIZE_T size = entityColumnsGetSize(element_bits, MAX_ENTITIES);
+#if ENTITY_FIXED_CAPACITY
+    uchar* column_p = (uchar*)_aligned_malloc(size, 32);
+    if(column_p) {memset(column_p, 0, size);}
+#else
+    uchar* column_p = (uchar*)VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#endif
+    if(!column_p)
     {
-	return INVALID_RANGE;
+	OutputDebugStringA("ERROR: Failed to reserve entity column.\n");
+	return NULL;
     }
+    columns.bases[columns.count]        = column_p;
+    columns.element_bits[columns.count] = element_bits;
+    columns.count++;
+    return column_p;
+}
 
-    return room_grid.grid[(int)pos.x][(int)pos.y][(int)pos.z];
+static uchar*
+entityColumnsAdd(EntityColumns& columns, uint stride)
+{
+    return entityColumnsAddBits(columns, stride * 8);
 }
 
-Vec3F
-roomGridFindNearestType(RoomGrid& room_grid, ActiveEntities& entities,
-			       Vec3F cur_pos, uint target_type)
+static int
+entityColumnsGrow(EntityColumns& columns, uint capacity)
 {
-    // Parses all entities on the grid, and returns the grid position of
-    // the nearest sought type. If not found, returns Vec3F(-1.0f).
+    // Commits every column up to at least capacity elements
+    // Returns 1 on success, 0 on failure
+    if(capacity <= columns.capacity) {return 1;}
+    if(capacity > MAX_ENTITIES) {return 0;}
 
-    Vec3F target_pos(RG_MAX_WIDTH * 2, RG_MAX_HEIGHT * 2, RG_MAX_LENGTH * 2);
-    Vec3F cur_best_distance = cur_pos - target_pos;
-    
-    for(uint x = 0; x < RG_MAX_WIDTH; x++)
+    // Grow geometrically so commits stay rare
+    uint new_capacity = columns.capacity * 2;
+    if(new_capacity < ENTITY_COMMIT_STEP) {new_capacity = ENTITY_COMMIT_STEP;}
+    if(new_capacity < capacity)           {new_capacity = capacity;}
+    if(new_capacity > MAX_ENTITIES)       {new_capacity = MAX_ENTITIES;}
+
+    for(uint i = 0; i < columns.count; i++)
     {
-	for(uint y = 0; y < RG_MAX_HEIGHT; y++)
+	// Committed pages are zeroed
+	SIZE_T size = entityColumnsGetSize(columns.element_bits[i], new_capacity);
+	if(!VirtualAlloc(columns.bases[i], size, MEM_COMMIT, PAGE_READWRITE))
 	{
-	    for(uint z = 0; z < RG_MAX_LENGTH; z++)
-	    {
-		int id = room_grid.grid[x][y][z];
-		if(id > -1)
-		{
-		    uint type = entities.types[id]; 
-		    if(type == target_type)
-		    {
-			Vec3F pot_new_target = Vec3F((float)x, (float)y, (float)z);
-			Vec3F new_distance = cur_pos - pot_new_target;
-			if(!(pot_new_target == cur_pos) &&
-			   magnitude(new_distance) < magnitude(cur_best_distance))
-			{
-			    target_pos        = pot_new_target;
-			    cur_best_distance = cur_pos - target_pos;
-			}
-		    }
-		}
-	    }
+	    OutputDebugStringA("ERROR: Failed to commit entity column.\n");
+	    return 0;
 	}
     }
+    columns.capacity = new_capacity;
+    return 1;
+}
 
-    return target_pos;
+static void
+entityColumnsRelease(EntityColumns& columns)
+{
+    for(uint i = 0; i < columns.count; i++)
+    {
+#if ENTITY_FIXED_CAPACITY
+	_aligned_free(columns.bases[i]);
+#else
+	VirtualFree(columns.bases[i], 0, MEM_RELEASE);
+#endif
+    }
+    columns.count    = 0;
+    columns.capacity = 0;
 }
 
-int
-roomGridGetFirstIDByType(const RoomGrid* rg_p, const ActiveEntities* entities_p, uint target_type)
+// ActiveEntities Functions //
+
+ActiveEntities::ActiveEntities()
 {
-    _assert(rg_p);
-    _assert(entities_p);
+    // Reserve the per-entity columns. Memory is committed as entities are created,
+    // and starts zeroed: every type NONE, every generation 0.
+    columns.count = 0;
+#if ENTITY_FIXED_CAPACITY
+    columns.capacity = MAX_ENTITIES;
+#else
+    columns.capacity = 0;
+#endif
+    types           = (uint*)entityColumnsAdd(columns, sizeof(uint));
+    archetype_rows  = (uint*)entityColumnsAdd(columns, sizeof(uint));
+    transform_positions.x = (float*)entityColumnsAdd(columns, sizeof(float));
+    transform_positions.y = (float*)entityColumnsAdd(columns, sizeof(float));
+    transform_positions.z = (float*)entityColumnsAdd(columns, sizeof(float));
+    transform_scales.x    = (float*)entityColumnsAdd(columns, sizeof(float));
+    transform_scales.y    = (float*)entityColumnsAdd(columns, sizeof(float));
+    transform_scales.z    = (float*)entityColumnsAdd(columns, sizeof(float));
+    grid_positions.x      = (float*)entityColumnsAdd(columns, sizeof(float));
+    grid_positions.y      = (float*)entityColumnsAdd(columns, sizeof(float));
+    grid_positions.z      = (float*)entityColumnsAdd(columns, sizeof(float));
+    roomgrid_owner_ids    = (int*)entityColumnsAdd(columns, sizeof(int));
+    states          = (State*)entityColumnsAdd(columns, sizeof(State));
+    roomgrid_ids    = (int*)entityColumnsAdd(columns, sizeof(int));
+    handles         = (int*)entityColumnsAdd(columns, sizeof(int));
+    sparse_to_dense = (uint*)entityColumnsAdd(columns, sizeof(uint));
+    generations     = (uint*)entityColumnsAdd(columns, sizeof(uint));
+    free_indices    = (uint*)entityColumnsAdd(columns, sizeof(uint));
+    removed_handles = (int*)entityColumnsAdd(columns, sizeof(int));
+    roomgrid_slots  = (uint*)entityColumnsAdd(columns, sizeof(uint));
+    roomgrid_type_slots = (uint*)entityColumnsAdd(columns, sizeof(uint));
+    for(uint i = 0; i < TOTAL_QUERIES; i++)
+    {
+	queries[i].ids   = (uint*)entityColumnsAdd(columns, sizeof(uint));
+	queries[i].slots = (uint*)entityColumnsAdd(columns, sizeof(uint));
+    }
+    for(uint i = 0; i < TOTAL_ENTITY_BITSETS; i++)
+    {
+	bitsets[i] = (uint64*)entityColumnsAddBits(columns, 1);
+    }
+
+    // Archetypes are built once the templates are loaded
+    archetype_count = 0;
+    memset(type_archetypes, 0, TOTAL_ENTITY_TYPES * sizeof(uint));
+
+    // Queries are built once the archetypes are
+    memset(type_queries, 0, TOTAL_ENTITY_TYPES * sizeof(uint));
+    memset(type_bitsets, 0, TOTAL_ENTITY_TYPES * sizeof(uint));
+    for(uint i = 0; i < TOTAL_QUERIES; i++)
+    {
+	queries[i].mask       = 0;
+	queries[i].count      = 0;
+	queries[i].tombstones = 0;
+    }
+
+    // No handle indices are in use yet
+    free_count    = 0;
+    sparse_count  = 0;
+    removed_count = 0;
+    pending_count = 0;
     
-    for(uint x = 0; x < RG_MAX_WIDTH; x++)
+    count = 0;
+
+    // Nothing to sort, the first activeEntitiesDefragment builds the ranges
+    defrag_key   = 0;
+    defrag_dirty = true;
+}
+
+ActiveEntities::~ActiveEntities()
+{
+    for(uint i = 0; i < archetype_count; i++)
+    {
+	for(uint j = 0; j < archetypes[i].chunks.size(); j++)
+	{
+	    _aligned_free(archetypes[i].chunks[j]);
+	}
+    }
+    entityColumnsRelease(columns);
+}
+
+void
+activeEntitiesInitArchetypes(ActiveEntities& entities)
+{
+    // Must be run after the entity templates are loaded, before any entity is created.
+    // Builds one archetype per unique component set in the template table.
+
+    _assert(entities.count == 0);
+
+    entities.archetype_count = 0;
+    for(uint type = 0; type < TOTAL_ENTITY_TYPES; type++)
     {
-	for(uint y = 0; y < RG_MAX_HEIGHT; y++)
+	uint signature = 0;
+	for(uint i = 0; i < TOTAL_COMPONENT_TYPES; i++)
+	{
+	    if(entities.entity_templates.table[type][i]) {signature |= componentMask(i);}
+	}
+
+	// Reuse the archetype of any prior type with the same component set
+	uint archetype_ID = entities.archetype_count;
+	for(uint i = 0; i < entities.archetype_count; i++)
 	{
-	    for(uint z = 0; z < RG_MAX_LENGTH; z++)
+	    if(entities.archetypes[i].signature == signature)
 	    {
-		int id = rg_p->grid[x][y][z];
-		if(id > -1)
-		{
-		    uint type = entities_p->types[id];
-		    if(type == target_type) {return id;}
-		}
+		archetype_ID = i;
+		break;
 	    }
 	}
+	if(archetype_ID == entities.archetype_count)
+	{
+	    archetypeInit(entities.archetypes[archetype_ID], signature);
+	    entities.archetype_count++;
+	}
+	entities.type_archetypes[type] = archetype_ID;
     }
-    return -1;
 }
 
 void
-roomGridLookupInit(RoomGridLookup& rgl)
+activeEntitiesInitQueries(ActiveEntities& entities)
+{
+    // Must be run after activeEntitiesInitArchetypes, before any entity is created.
+    // Sets the component mask of each query and which queries each type matches.
+
+    _assert(entities.count == 0);
+
+    entities.queries[QUERY_STATE].mask         = componentMask(COMPONENT_STATE);
+    entities.queries[QUERY_PLAYER].mask        = componentMask(COMPONENT_PLAYER);
+    entities.queries[QUERY_AI].mask            = componentMask(COMPONENT_AI);
+    entities.queries[QUERY_ROOM_GRID].mask     = componentMask(COMPONENT_ROOM_GRID);
+    entities.queries[QUERY_GRID_POSITION].mask = componentMask(COMPONENT_GRID_POSITION);
+    entities.queries[QUERY_CAMERA].mask        = componentMask(COMPONENT_CAMERA);
+    entities.queries[QUERY_DIR_LIGHT].mask     = componentMask(COMPONENT_DIR_LIGHT);
+    entities.queries[QUERY_RENDER].mask        = (componentMask(COMPONENT_RENDER) |
+						  componentMask(COMPONENT_TRANSFORM));
+
+    for(uint type = 0; type < TOTAL_ENTITY_TYPES; type++)
+    {
+	uint signature = entities.archetypes[entities.type_archetypes[type]].signature;
+	entities.type_queries[type] = 0;
+	for(uint i = 0; i < TOTAL_QUERIES; i++)
+	{
+	    uint mask = entities.queries[i].mask;
+	    if((signature & mask) == mask) {entities.type_queries[type] |= (1 << i);}
+	}
+
+	// Every created entity starts live
+	uint bits = (1 << BITSET_LIVE);
+	if(entities.type_queries[type] & (1 << QUERY_RENDER))  {bits |= (1 << BITSET_RENDER);}
+	if(signature & componentMask(COMPONENT_GRID_POSITION)) {bits |= (1 << BITSET_GRID_POSITION);}
+	if(signature & componentMask(COMPONENT_PUSHABLE))      {bits |= (1 << BITSET_PUSHABLE);}
+	if(signature & componentMask(COMPONENT_COLLISION))     {bits |= (1 << BITSET_COLLISION);}
+	if(signature & componentMask(COMPONENT_GRID_POSITION)) {bits |= (1 << BITSET_GRID_DIRTY);}
+	entities.type_bitsets[type] = bits;
+    }
+
+    for(uint i = 0; i < TOTAL_QUERIES; i++)
+    {
+	entities.queries[i].count      = 0;
+	entities.queries[i].tombstones = 0;
+    }
+}
+
+static uint
+activeEntitiesGetIndexCount(const ActiveEntities& entities, uint created_count)
+{
+    // Handle indices in use once created_count more entities (counting the pending ones)
+    // are made. Removed entities' indices are reused first, then fresh ones follow.
+    uint fresh_count = (created_count > entities.free_count) ? created_count - entities.free_count : 0;
+    return entities.sparse_count + fresh_count;
+}
+
+static bool
+activeEntitiesIsReserved(const ActiveEntities& entities, uint created_count)
+{
+    // True if the committed columns hold created_count more entities & their handle indices
+    return (entities.count + created_count <= entities.columns.capacity &&
+	    activeEntitiesGetIndexCount(entities, created_count) <= entities.columns.capacity);
+}
+
+static uint
+activeEntitiesGetPendingIndex(const ActiveEntities& entities, uint pending_offset)
+{
+    // Handle index of the pending entity at pending_offset, taken from the top of the
+    // free list first like activeEntitiesInstancePrefab does
+    return ((pending_offset < entities.free_count) ?
+	    entities.free_indices[entities.free_count - 1 - pending_offset] :
+	    entities.sparse_count + (pending_offset - entities.free_count));
+}
+
+size_t
+activeEntitiesGetCommittedBytes(const ActiveEntities& entities)
+{
+    // Bytes of entity columns & archetype chunks committed, the memory that grows with
+    // the entity count
+    size_t bytes = 0;
+    for(uint i = 0; i < entities.columns.count; i++)
+    {
+	bytes += entityColumnsGetSize(entities.columns.element_bits[i], entities.columns.capacity);
+    }
+    for(uint i = 0; i < entities.archetype_count; i++)
+    {
+	bytes += entities.archetypes[i].chunks.size() * ARCHETYPE_CHUNK_SIZE;
+    }
+    return bytes;
+}
+
+int
+activeEntitiesReserve(ActiveEntities& entities, uint entity_count)
+{
+    // Commits the entity columns for at least entity_count entities, and for the handle
+    // indices the new ones take. Pointers to the columns stay valid.
+    // Returns 1 on success, 0 if either is over MAX_ENTITIES.
+    uint created_count = (entity_count > entities.count) ? entity_count - entities.count : 0;
+    uint index_count   = activeEntitiesGetIndexCount(entities, created_count);
+    return entityColumnsGrow(entities.columns, (index_count > entity_count) ? index_count : entity_count);
+}
+
+static void
+activeEntitiesFillPrefab(ActiveEntities& entities,
+			 uint first,
+			 int room_grid_owner_id,
+			 const Vec3F* origins,
+			 uint entity_count,
+			 uint entity_type)
+{
+    // Fills the per-entity columns of IDs [first, first + entity_count) from the type's
+    // prefab. Writes only those IDs' elements, so threads can fill disjoint ranges.
+
+    Prefab& prefab = entities.prefabs[entity_type];
+    bool has_grid_position = activeEntitiesTypeHas(entities, entity_type, COMPONENT_GRID_POSITION);
+    uint end = first + entity_count;
+
+    // Types, states & RoomGrid ids
+    std::fill_n(&entities.types[first], entity_count, entity_type);
+    componentFill(&entities.states[first], &prefab.state, sizeof(State), entity_count);
+    std::fill_n(&entities.roomgrid_ids[first], entity_count, -1);
+    std::fill_n(&entities.roomgrid_owner_ids[first], entity_count, has_grid_position ? room_grid_owner_id : -1);
+
+    // Transforms, set even if never used
+    for(uint i = first; i < end; i++)
+    {
+	vec3FColumnsSet(entities.transform_positions, i, origins[i - first]);
+    }
+    std::fill_n(&entities.transform_scales.x[first], entity_count, prefab.scale.x);
+    std::fill_n(&entities.transform_scales.y[first], entity_count, prefab.scale.y);
+    std::fill_n(&entities.transform_scales.z[first], entity_count, prefab.scale.z);
+
+    // Grid positions
+    if(has_grid_position)
+    {
+	for(uint i = first; i < end; i++)
+	{
+	    vec3FColumnsSet(entities.grid_positions, i, origins[i - first]);
+	}
+    }
+}
+
+static void
+activeEntitiesPublishRange(ActiveEntities& entities,
+			   RoomGridLookup& roomgrid_lookup,
+			   uint first,
+			   uint entity_count)
+{
+    // Adds filled entities of one type to the shared structures: bitsets, archetype
+    // rows, query lists & RoomGrids. Single threaded.
+
+    uint entity_type = entities.types[first];
+    uint end = first + entity_count;
+
+    // Liveness & tags, a word at a time
+    for(uint j = 0; j < TOTAL_ENTITY_BITSETS; j++)
+    {
+	bitsetAssignRange(entities.bitsets[j], first, end, (entities.type_bitsets[entity_type] >> j) & 1);
+    }
+
+    // Archetype rows & chunked components
+    Archetype& archetype = entities.archetypes[entities.type_archetypes[entity_type]];
+    uint first_row = archetypeAddRows(archetype, first, entity_count, entities.prefabs[entity_type]);
+    for(uint i = first; i < end; i++)
+    {
+	entities.archetype_rows[i] = first_row + (i - first);
+    }
+
+    // Queries
+    for(uint j = 0; j < TOTAL_QUERIES; j++)
+    {
+	if(entities.type_queries[entity_type] & (1 << j))
+	{
+	    entityQueryAddRange(entities.queries[j], first, entity_count);
+	}
+    }
+
+    // RoomGrid cells & contents
+    if(activeEntitiesTypeHas(entities, entity_type, COMPONENT_GRID_POSITION))
+    {
+	uint i = first;
+	while(i < end)
+	{
+	    // Runs of entities in the same RoomGrid
+	    int room_grid_owner_id = entities.roomgrid_owner_ids[i];
+	    uint run_end = i + 1;
+	    while(run_end < end && entities.roomgrid_owner_ids[run_end] == room_grid_owner_id) {run_end++;}
+	    if(room_grid_owner_id > -1)
+	    {
+		RoomGrid& room_grid = *roomgrid_lookup.roomgrid_pointers[room_grid_owner_id];
+		uint cell_flags = activeEntitiesGetCellFlags(entities, entity_type);
+		for(uint k = i; k < run_end; k++)
+		{
+		    roomGridSetEntity(room_grid, vec3FColumnsGet(entities.grid_positions, k),
+				      entities.handles[k], cell_flags);
+		}
+		roomGridAddContents(room_grid, entities, &entities.handles[i], run_end - i);
+	    }
+	    i = run_end;
+	}
+    }
+}
+
+static uint
+activeEntitiesInstancePrefab(ActiveEntities& entities,
+			     RoomGridLookup& roomgrid_lookup,
+			     int room_grid_owner_id,
+			     const Vec3F* origins,
+			     uint entity_count,
+			     uint entity_type)
+{
+    // Creates entity_count entities of one type in one RoomGrid, one at each origin,
+    // from the type's prefab. The columns must already be reserved.
+    // Returns the ID of the first entity.
+
+    _assert(entities.pending_count == 0);
+    uint first = entities.count;
+    uint end   = entities.count + entity_count;
+
+    // Handles, reusing the indices of removed entities first
+    for(uint i = first; i < end; i++)
+    {
+	uint index = (entities.free_count ?
+		      entities.free_indices[--entities.free_count] :
+		      entities.sparse_count++);
+	entities.sparse_to_dense[index] = i;
+	entities.handles[i] = entityHandleMake(index, entities.generations[index]);
+    }
+
+    activeEntitiesFillPrefab(entities, first, room_grid_owner_id, origins, entity_count, entity_type);
+    activeEntitiesPublishRange(entities, roomgrid_lookup, first, entity_count);
+    entities.count = end;
+    entities.defrag_dirty = true;
+    return first;
+}
+
+static int
+activeEntitiesUnshareCells(ActiveEntities& entities,
+			   RoomGridLookup& roomgrid_lookup,
+			   int room_grid_owner_id,
+			   const Vec3F* positions,
+			   uint count)
+{
+    // roomGridPrepareWrite for the cells the creation paths are about to fill
+    // Returns 1 on success, 0 on failure.
+    if(room_grid_owner_id < 0 || !roomgrid_lookup.roomgrid_pointers[room_grid_owner_id]) {return 1;}
+    RoomGrid& room_grid = *roomgrid_lookup.roomgrid_pointers[room_grid_owner_id];
+    if(room_grid.template_id < 0) {return 1;}
+
+    for(uint k = 0; k < count; k++)
+    {
+	if(!roomGridPrepareWrite(room_grid, entities, roomgrid_lookup, positions[k])) {return 0;}
+    }
+    return 1;
+}
+
+int
+activeEntitiesCreateEntity(ActiveEntities& entities,
+			       RoomGridLookup& roomgrid_lookup,
+			       int room_grid_owner_id,
+			       int room_grid_id,
+			       Vec3F origin,
+			       uint entity_type)
+{
+    // Returns entity handle on success, -1 on failure
+    
+    _assert(entity_type >= 0 && entity_type < TOTAL_ENTITY_TYPES);
+
+    if(!activeEntitiesUnshareCells(entities, roomgrid_lookup, room_grid_owner_id, &origin, 1)) {return -1;}
+
+    if (activeEntitiesReserve(entities, entities.count + 1))
+    {
+	uint i = activeEntitiesInstancePrefab(entities, roomgrid_lookup, room_grid_owner_id, &origin, 1, entity_type);
+	// if entity has a roomgrid component, store its lookup id and allocate the roomgrid
+	if(activeEntitiesTypeHas(entities, entity_type, COMPONENT_ROOM_GRID))
+	{
+	    entities.roomgrid_ids[i] = room_grid_id;
+	    if(room_grid_id > -1)
+	    {
+		roomGridLookupReserve(roomgrid_lookup, room_grid_id + 1);
+		if(roomgrid_lookup.roomgrid_pointers[room_grid_id])
+		{
+		    // Shared RoomGrid, the entity only references it
+		    roomgrid_lookup.roomgrid_pointers[room_grid_id]->references.push_back(entities.handles[i]);
+		    return entities.handles[i];
+		}
+		RoomGrid* rg_p = new RoomGrid(roomgrid_lookup.extents[room_grid_id * 3 + 0],
+					      roomgrid_lookup.extents[room_grid_id * 3 + 1],
+					      roomgrid_lookup.extents[room_grid_id * 3 + 2]);
+		rg_p->roomgrid_owner_id   = room_grid_owner_id;
+		rg_p->roomgrid_id         = room_grid_id;
+		rg_p->owner_entity_handle = entities.handles[i];
+		roomgrid_lookup.roomgrid_pointers[room_grid_id] = rg_p;
+	    }
+	}
+	// Return new entity handle
+	return entities.handles[i];
+    }
+    OutputDebugStringA("ERROR - Failed to create entity - Max entities reached.\n");
+    return -1;
+}
+
+int
+activeEntitiesCreateRoomClone(ActiveEntities& entities,
+				  RoomGridLookup& roomgrid_lookup,
+				  int room_grid_owner_id,
+				  int room_grid_id,
+				  int template_id,
+				  Vec3F origin,
+				  uint entity_type)
+{
+    // Creates an entity holding a new RoomGrid that shares the template's bricks.
+    // Returns entity handle on success, -1 on failure
+
+    _assert(template_id > -1 && template_id < (int)roomgrid_lookup.roomgrid_pointers.size());
+    _assert(room_grid_id > -1 && activeEntitiesTypeHas(entities, entity_type, COMPONENT_ROOM_GRID));
+    RoomGrid* template_p = roomgrid_lookup.roomgrid_pointers[template_id];
+    _assert(template_p && template_p->is_template);
+
+    roomGridLookupSetExtents(roomgrid_lookup, room_grid_id, template_p->width, template_p->height, template_p->length);
+    int handle = activeEntitiesCreateEntity(entities, roomgrid_lookup, room_grid_owner_id, room_grid_id,
+					    origin, entity_type);
+    if(handle < 0) {return -1;}
+
+    // An existing RoomGrid is only referenced, see activeEntitiesCreateEntity
+    RoomGrid& room_grid = *roomgrid_lookup.roomgrid_pointers[room_grid_id];
+    if(room_grid.owner_entity_handle != handle) {return handle;}
+    for(uint i = 0; i < room_grid.brick_count; i++)
+    {
+	room_grid.bricks[i]    = template_p->bricks[i];
+	room_grid.occupancy[i] = template_p->occupancy[i];
+	if(room_grid.bricks[i]) {room_grid.bricks[i]->ref_count++;}
+    }
+    room_grid.template_id = template_id;
+    room_grid.template_p  = template_p;
+    room_grid.impostor_dirty = true;
+    return handle;
+}
+
+int
+activeEntitiesCreateEntities(ActiveEntities& entities,
+				 RoomGridLookup& roomgrid_lookup,
+				 int room_grid_owner_id,
+				 const Vec3F* origins,
+				 uint entity_count,
+				 uint entity_type,
+				 int* handles_p)
+{
+    // Creates entity_count entities of one type in one RoomGrid, one at each origin.
+    // Writes the new handles to handles_p if it is not NULL.
+    // Returns 1 on success, 0 on failure (no entities are created on failure).
+
+    _assert(entity_type >= 0 && entity_type < TOTAL_ENTITY_TYPES);
+    // Entities owning a RoomGrid each need their own allocation, see activeEntitiesCreateEntity
+    _assert(!activeEntitiesTypeHas(entities, entity_type, COMPONENT_ROOM_GRID));
+
+    if(!activeEntitiesUnshareCells(entities, roomgrid_lookup, room_grid_owner_id, origins, entity_count))
+    {
+	return 0;
+    }
+    if(!activeEntitiesReserve(entities, entities.count + entity_count))
+    {
+	OutputDebugStringA("ERROR - Failed to create entities - Max entities reached.\n");
+	return 0;
+    }
+
+    uint first = activeEntitiesInstancePrefab(entities, roomgrid_lookup, room_grid_owner_id,
+					      origins, entity_count, entity_type);
+    if(handles_p) {memcpy(handles_p, &entities.handles[first], entity_count * sizeof(int));}
+    return 1;
+}
+
+int
+activeEntitiesCreateEntitiesConcurrent(ActiveEntities& entities,
+					   int room_grid_owner_id,
+					   const Vec3F* origins,
+					   uint entity_count,
+					   uint entity_type,
+					   int* handles_p)
+{
+    // Thread safe version of activeEntitiesCreateEntities. Reserves a block of IDs &
+    // handle indices with one atomic operation, then fills the block without locks.
+    // The entities are invisible (outside entities.count) & off their RoomGrid until
+    // activeEntitiesPublishCreated runs. Handle indices come from the free list first,
+    // which stays untouched until then, so no other thread may create or remove entities.
+    // The columns must be reserved beforehand, see activeEntitiesReserve.
+    // Writes the new handles to handles_p if it is not NULL.
+    // Returns 1 on success, 0 if the reserved columns are full.
+
+    _assert(entity_type >= 0 && entity_type < TOTAL_ENTITY_TYPES);
+    _assert(!activeEntitiesTypeHas(entities, entity_type, COMPONENT_ROOM_GRID));
+
+    uint offset = entities.pending_count.load();
+    do
+    {
+	if(!activeEntitiesIsReserved(entities, offset + entity_count))
+	{
+	    OutputDebugStringA("ERROR - Failed to create entities - Reserved entities full.\n");
+	    return 0;
+	}
+    } while(!entities.pending_count.compare_exchange_weak(offset, offset + entity_count));
+
+    uint first = entities.count + offset;
+    for(uint k = 0; k < entity_count; k++)
+    {
+	uint index = activeEntitiesGetPendingIndex(entities, offset + k);
+	entities.sparse_to_dense[index] = first + k;
+	entities.handles[first + k] = entityHandleMake(index, entities.generations[index]);
+    }
+    activeEntitiesFillPrefab(entities, first, room_grid_owner_id, origins, entity_count, entity_type);
+    if(handles_p) {memcpy(handles_p, &entities.handles[first], entity_count * sizeof(int));}
+    return 1;
+}
+
+void
+activeEntitiesPublishCreated(ActiveEntities& entities, RoomGridLookup& roomgrid_lookup)
+{
+    // Sync point for activeEntitiesCreateEntitiesConcurrent - must be run once every
+    // creating thread is done, e.g. after schedulerRun. Adds the pending entities to
+    // the bitsets, archetypes, queries & RoomGrids in ID order, then makes them active.
+    // Two pending entities placed on the same cell resolve to the higher ID.
+
+    uint pending = entities.pending_count.load();
+    uint end = entities.count + pending;
+    uint i = entities.count;
+    while(i < end)
+    {
+	uint run_end = i + 1;
+	while(run_end < end && entities.types[run_end] == entities.types[i]) {run_end++;}
+	activeEntitiesPublishRange(entities, roomgrid_lookup, i, run_end - i);
+	i = run_end;
+    }
+    // The pending entities took the top of the free list, then fresh indices
+    uint reused_count = (pending < entities.free_count) ? pending : entities.free_count;
+    entities.free_count   -= reused_count;
+    entities.sparse_count += pending - reused_count;
+    entities.count = end;
+    entities.pending_count = 0;
+    entities.defrag_dirty = true;
+}
+
+template<uint TYPE>
+static void
+activeEntitiesReleaseRoomGridData(ActiveEntities& entities, RoomGridLookup& roomgrid_lookup, int i)
+{
+    // If inactive entity is on the grid, set its cell back to -1 in the level grid,
+    // unless another entity has moved into the cell since it was marked inactive,
+    // and take it off the grid's contents
+    if(activeEntitiesKernelHas<TYPE>(entities, entities.types[i], COMPONENT_GRID_POSITION))
+    {
+	int roomgrid_id = entities.roomgrid_owner_ids[i];
+	if(roomgrid_id > -1 && roomgrid_lookup.roomgrid_pointers[roomgrid_id])
+	{
+	    RoomGrid* grid_p = roomgrid_lookup.roomgrid_pointers[roomgrid_id];
+	    Vec3F inactive_grid_position = vec3FColumnsGet(entities.grid_positions, i);
+	    if(roomGridGetEntity(*grid_p, inactive_grid_position) == entities.handles[i])
+	    {
+		roomGridRemoveEntity(*grid_p, inactive_grid_position);
+	    }
+	    roomGridRemoveContent(*grid_p, entities, entities.handles[i]);
+	}
+    }
+    // If the inactive entity had a room grid component, queue the entities it contains
+    // for removal, then update the lookup table so it no longer points to the invalid
+    // room grid data. Nested rooms are removed the same way when their turn in the queue
+    // comes, so the cost is one step per contained entity at any depth.
+    if(activeEntitiesKernelHas<TYPE>(entities, entities.types[i], COMPONENT_ROOM_GRID))
+    {
+	int roomgrid_id = entities.roomgrid_ids[i];
+	if(roomgrid_id > -1 && roomgrid_lookup.roomgrid_pointers[roomgrid_id])
+	{
+	    RoomGrid* grid_p = roomgrid_lookup.roomgrid_pointers[roomgrid_id];
+	    if(grid_p->owner_entity_handle != entities.handles[i])
+	    {
+		// A reference leaves the shared RoomGrid to its owner
+		std::vector<int>& references = grid_p->references;
+		references.erase(std::remove(references.begin(), references.end(), entities.handles[i]),
+				 references.end());
+		return;
+	    }
+	    for(uint c = 0; c < grid_p->contents.size(); c++)
+	    {
+		int content_id = activeEntitiesGetID(entities, grid_p->contents[c]);
+		// The contained entities no longer have a grid to be removed from
+		entities.roomgrid_owner_ids[content_id] = -1;
+		activeEntitiesMarkInactive(entities, content_id);
+	    }
+	    // References elsewhere no longer show anything, even if the id is reused
+	    for(uint r = 0; r < grid_p->references.size(); r++)
+	    {
+		int reference_id = activeEntitiesGetID(entities, grid_p->references[r]);
+		if(reference_id > -1) {entities.roomgrid_ids[reference_id] = -1;}
+	    }
+	    delete grid_p;
+	    roomgrid_lookup.roomgrid_pointers[roomgrid_id] = NULL;
+	}
+    }
+}
+
+#if STATIC_ENTITY_TEMPLATES
+typedef void (*EntityReleaseKernel)(ActiveEntities&, RoomGridLookup&, int);
+static const EntityReleaseKernel entity_release_kernels[TOTAL_ENTITY_TYPES] =
+{
+    activeEntitiesReleaseRoomGridData<NONE>,
+    activeEntitiesReleaseRoomGridData<CHEST>,
+    activeEntitiesReleaseRoomGridData<GRID>,
+    activeEntitiesReleaseRoomGridData<CAMERA>,
+    activeEntitiesReleaseRoomGridData<DIR_LIGHT>,
+    activeEntitiesReleaseRoomGridData<PLAYER>,
+    activeEntitiesReleaseRoomGridData<BLOCK>,
+    activeEntitiesReleaseRoomGridData<SPECIAL_BLOCK>,
+    activeEntitiesReleaseRoomGridData<BLOCK_ROOM>
+};
+#endif
+
+void
+activeEntitiesSetGridPosition(ActiveEntities& entities,
+				  RoomGridLookup& roomgrid_lookup,
+				  uint entity_id,
+				  Vec3F grid_position)
+{
+    // Sets an entity's grid position & its entry in its RoomGrid's type list. The cells
+    // & BITSET_GRID_DIRTY are left to the caller.
+    vec3FColumnsSet(entities.grid_positions, entity_id, grid_position);
+    int roomgrid_owner_id = entities.roomgrid_owner_ids[entity_id];
+    if(entity_id >= entities.count || roomgrid_owner_id < 0 ||
+       !roomgrid_lookup.roomgrid_pointers[roomgrid_owner_id])
+    {
+	return;
+    }
+
+    uint index = entityHandleGetIndex(entities.handles[entity_id]);
+    RoomGridTypeList& list = roomgrid_lookup.roomgrid_pointers[roomgrid_owner_id]->type_lists[entities.types[entity_id]];
+    uint type_slot = entities.roomgrid_type_slots[index];
+    _assert(type_slot < list.handles.size() && list.handles[type_slot] == entities.handles[entity_id]);
+    list.xs[type_slot] = grid_position.x;
+    list.ys[type_slot] = grid_position.y;
+    list.zs[type_slot] = grid_position.z;
+}
+
+void
+activeEntitiesSetRoomGridOwner(ActiveEntities& entities,
+				   RoomGridLookup& roomgrid_lookup,
+				   uint entity_id,
+				   int room_grid_owner_id)
+{
+    // Moves an entity to the contents of another RoomGrid, e.g. when pushed across
+    // RoomGrids. Its cells are left to the caller. A pending entity joins the contents
+    // when published. Entities holding RoomGrids keep their owner.
+    _assert(!activeEntitiesTypeHas(entities, entities.types[entity_id], COMPONENT_ROOM_GRID));
+    int old_owner_id = entities.roomgrid_owner_ids[entity_id];
+    if(old_owner_id == room_grid_owner_id) {return;}
+
+    if(entity_id < entities.count)
+    {
+	if(old_owner_id > -1 && roomgrid_lookup.roomgrid_pointers[old_owner_id])
+	{
+	    roomGridRemoveContent(*roomgrid_lookup.roomgrid_pointers[old_owner_id], entities,
+				  entities.handles[entity_id]);
+	}
+	if(room_grid_owner_id > -1)
+	{
+	    roomGridAddContents(*roomgrid_lookup.roomgrid_pointers[room_grid_owner_id], entities,
+				&entities.handles[entity_id], 1);
+	}
+    }
+    entities.roomgrid_owner_ids[entity_id] = room_grid_owner_id;
+    entities.defrag_dirty = true;
+}
+
+void
+activeEntitiesRemoveInactives(ActiveEntities& entities, RoomGridLookup& roomgrid_lookup)
+{
+    // Should be run after all other entity updates. Removes each entity queued by
+    // activeEntitiesMarkInactive: overwrites the inactive with the active entity on the
+    // end of the arrays, then decreases count by 1. The moved entity keeps its handle,
+    // so the RoomGrids and anything else storing handles need no patching.
+
+    _assert(entities.pending_count == 0);
+    for(uint r = 0; r < entities.removed_count; r++)
+    {
+	int i = activeEntitiesGetID(entities, entities.removed_handles[r]);
+	if(i < 0) {continue;}
+	int last = entities.count - 1;
+
+	// Release the RoomGrid data of the inactive entity
+#if STATIC_ENTITY_TEMPLATES
+	entity_release_kernels[entities.types[i]](entities, roomgrid_lookup, i);
+#else
+	activeEntitiesReleaseRoomGridData<ENTITY_TYPE_ANY>(entities, roomgrid_lookup, i);
+#endif
+
+	// Remove the inactive entity from its queries, then give the replacement
+	// entity's query entries its new ID
+	for(uint j = 0; j < TOTAL_QUERIES; j++)
+	{
+	    if(entities.type_queries[entities.types[i]] & (1 << j))
+	    {
+		entityQueryRemove(entities.queries[j], i);
+	    }
+	}
+	if(i != last)
+	{
+	    for(uint j = 0; j < TOTAL_QUERIES; j++)
+	    {
+		if(entities.type_queries[entities.types[last]] & (1 << j))
+		{
+		    entityQueryRename(entities.queries[j], last, i);
+		}
+	    }
+	}
+
+	// Release the inactive entity's archetype row. If another entity's row was
+	// moved into it, point that entity at its new row.
+	Archetype& archetype = entities.archetypes[entities.type_archetypes[entities.types[i]]];
+	int moved_entity_ID = archetypeRemoveRow(archetype, entities.archetype_rows[i]);
+	if(moved_entity_ID > -1)
+	{
+	    entities.archetype_rows[moved_entity_ID] = entities.archetype_rows[i];
+	}
+
+	// Retire the inactive entity's handle. Bumping the generation makes every copy
+	// of the handle stale, then the index is free to reuse. An index whose generation
+	// wraps is never reused, so an old handle cannot match it again.
+	uint index = entityHandleGetIndex(entities.handles[i]);
+	entities.generations[index] = (entities.generations[index] + 1) & HANDLE_GENERATION_MASK;
+	if(entities.generations[index] != 0) {entities.free_indices[entities.free_count++] = index;}
+	// The replacement entity's handle now resolves to ID i
+	entities.sparse_to_dense[entityHandleGetIndex(entities.handles[last])] = i;
+	    
+	// Copy component data from last active entity and fill inactive slot 
+	vec3FColumnsSet(entities.grid_positions, i, vec3FColumnsGet(entities.grid_positions, last));
+	vec3FColumnsSet(entities.transform_positions, i, vec3FColumnsGet(entities.transform_positions, last));
+	vec3FColumnsSet(entities.transform_scales, i, vec3FColumnsGet(entities.transform_scales, last));
+	entities.roomgrid_owner_ids[i] = entities.roomgrid_owner_ids[last];
+	entities.states[i]         = entities.states[last];
+	entities.roomgrid_ids[i]   = entities.roomgrid_ids[last];
+	entities.archetype_rows[i] = entities.archetype_rows[last];
+	entities.handles[i]        = entities.handles[last];
+	// Move the replacement entity's bits, then clear the last ID's
+	for(uint j = 0; j < TOTAL_ENTITY_BITSETS; j++)
+	{
+	    bitsetAssign(entities.bitsets[j], i, bitsetGet(entities.bitsets[j], last));
+	    bitsetClear(entities.bitsets[j], last);
+	}
+	// The replacement entity's archetype row now belongs to ID i
+	if(i != last)
+	{
+	    Archetype& replacement_archetype = entities.archetypes[entities.type_archetypes[entities.types[last]]];
+	    *archetypeGetEntityIDP(replacement_archetype, entities.archetype_rows[i]) = i;
+	}
+	// Copy replacement entity's type last
+	entities.types[i] = entities.types[last];
+	// Set last active entity type to NONE for memory readability
+	entities.types[last] = NONE;
+	// Decrease entity count by one, effectively removing the inactive entity
+	// while preserving the entity on the end of the arrays. 
+	entities.count--;
+    }
+    if(entities.removed_count > 0) {entities.defrag_dirty = true;}
+    entities.removed_count = 0;
+
+    // Drop the removed entities' tombstones from the query lists
+    for(uint j = 0; j < TOTAL_QUERIES; j++)
+    {
+	entityQueryCompact(entities.queries[j]);
+    }
+}
+
+static void
+activeEntitiesSwap(ActiveEntities& entities, uint a, uint b)
+{
+    // Exchanges the IDs of two entities. Handles are unchanged, so the RoomGrids and
+    // anything else storing handles need no patching.
+    _assert(a < entities.count && b < entities.count && a != b);
+
+    // Query entries, keeping each list's order
+    for(uint j = 0; j < TOTAL_QUERIES; j++)
+    {
+	EntityQuery& query = entities.queries[j];
+	bool has_a = (entities.type_queries[entities.types[a]] & (1 << j)) != 0;
+	bool has_b = (entities.type_queries[entities.types[b]] & (1 << j)) != 0;
+	if(has_a && has_b)
+	{
+	    uint slot_a = query.slots[a];
+	    query.ids[slot_a]          = b;
+	    query.ids[query.slots[b]]  = a;
+	    query.slots[a]             = query.slots[b];
+	    query.slots[b]             = slot_a;
+	}
+	else if(has_a) {entityQueryRename(query, a, b);}
+	else if(has_b) {entityQueryRename(query, b, a);}
+    }
+
+    // Archetype row owners & handle lookups
+    *archetypeGetEntityIDP(entities.archetypes[entities.type_archetypes[entities.types[a]]],
+			   entities.archetype_rows[a]) = b;
+    *archetypeGetEntityIDP(entities.archetypes[entities.type_archetypes[entities.types[b]]],
+			   entities.archetype_rows[b]) = a;
+    entities.sparse_to_dense[entityHandleGetIndex(entities.handles[a])] = b;
+    entities.sparse_to_dense[entityHandleGetIndex(entities.handles[b])] = a;
+
+    // Columns
+    std::swap(entities.types[a], entities.types[b]);
+    std::swap(entities.archetype_rows[a], entities.archetype_rows[b]);
+    std::swap(entities.handles[a], entities.handles[b]);
+    std::swap(entities.states[a], entities.states[b]);
+    std::swap(entities.roomgrid_ids[a], entities.roomgrid_ids[b]);
+    std::swap(entities.roomgrid_owner_ids[a], entities.roomgrid_owner_ids[b]);
+    Vec3FColumns* vec3_columns[3] = {&entities.transform_positions,
+				     &entities.transform_scales,
+				     &entities.grid_positions};
+    for(uint j = 0; j < 3; j++)
+    {
+	std::swap(vec3_columns[j]->x[a], vec3_columns[j]->x[b]);
+	std::swap(vec3_columns[j]->y[a], vec3_columns[j]->y[b]);
+	std::swap(vec3_columns[j]->z[a], vec3_columns[j]->z[b]);
+    }
+    for(uint j = 0; j < TOTAL_ENTITY_BITSETS; j++)
+    {
+	bool bit_a = bitsetGet(entities.bitsets[j], a);
+	bitsetAssign(entities.bitsets[j], a, bitsetGet(entities.bitsets[j], b));
+	bitsetAssign(entities.bitsets[j], b, bit_a);
+    }
+}
+
+static uint
+activeEntitiesGetDefragKey(const ActiveEntities& entities, uint i)
+{
+    // Orders entities by RoomGrid, then by type. Entities outside a RoomGrid come first.
+    return (uint)(entities.roomgrid_owner_ids[i] + 1) * TOTAL_ENTITY_TYPES + entities.types[i];
+}
+
+uint
+activeEntitiesDefragment(ActiveEntities& entities, uint max_swaps)
+{
+    // Moves up to max_swaps entities to their place in (RoomGrid, type) order, so the
+    // members of a RoomGrid end up contiguous. Run between frames, after
+    // activeEntitiesRemoveInactives, while no system is running. The key ranges & the
+    // cursor are kept between calls and only rebuilt once entities are created, removed
+    // or change RoomGrid, so a sorted layout returns straight away.
+    // Returns the number of swaps made, 0 once the entities are sorted.
+
+    _assert(entities.pending_count == 0);
+    std::vector<uint>& bucket_next = entities.defrag_next;
+    std::vector<uint>& bucket_end  = entities.defrag_end;
+    if(entities.defrag_dirty)
+    {
+	int max_owner_id = -1;
+	for(uint i = 0; i < entities.count; i++)
+	{
+	    max_owner_id = std::max(max_owner_id, entities.roomgrid_owner_ids[i]);
+	}
+	// assign keeps the capacity, so only a new highest RoomGrid ID allocates
+	const uint key_count = (uint)(max_owner_id + 2) * TOTAL_ENTITY_TYPES;
+	bucket_next.resize(key_count);
+	bucket_end.assign(key_count, 0);
+	for(uint i = 0; i < entities.count; i++)
+	{
+	    bucket_end[activeEntitiesGetDefragKey(entities, i)]++;
+	}
+	uint offset = 0;
+	for(uint k = 0; k < key_count; k++)
+	{
+	    bucket_next[k] = offset;
+	    offset += bucket_end[k];
+	    bucket_end[k] = offset;
+	}
+	entities.defrag_key   = 0;
+	entities.defrag_dirty = false;
+    }
+
+    // In-place bucket permutation: each swap sends the entity at i to the first
+    // misplaced slot of its key's range
+    const uint key_count = (uint)bucket_end.size();
+    uint& k = entities.defrag_key;
+    uint swaps = 0;
+    while(k < key_count && swaps < max_swaps)
+    {
+	if(bucket_next[k] == bucket_end[k])
+	{
+	    k++;
+	    continue;
+	}
+	uint i = bucket_next[k];
+	uint key = activeEntitiesGetDefragKey(entities, i);
+	if(key == k)
+	{
+	    bucket_next[k]++;
+	    continue;
+	}
+	while(activeEntitiesGetDefragKey(entities, bucket_next[key]) == key) {bucket_next[key]++;}
+	activeEntitiesSwap(entities, i, bucket_next[key]++);
+	swaps++;
+    }
+    return swaps;
+}
+
+// EntityCommandBuffer Functions //
+
+void
+entityCommandBufferCreate(EntityCommandBuffer& buffer,
+			      int room_grid_owner_id,
+			      int room_grid_id,
+			      Vec3F origin,
+			      uint entity_type)
+{
+    EntityCommand command;
+    command.type               = COMMAND_CREATE;
+    command.sequence           = (uint)buffer.commands.size();
+    command.room_grid_owner_id = room_grid_owner_id;
+    command.room_grid_id       = room_grid_id;
+    command.entity_type        = entity_type;
+    command.entity_handle      = -1;
+    command.position           = origin;
+    buffer.commands.push_back(command);
+}
+
+void
+entityCommandBufferDestroy(EntityCommandBuffer& buffer, int entity_handle)
+{
+    EntityCommand command;
+    command.type               = COMMAND_DESTROY;
+    command.sequence           = (uint)buffer.commands.size();
+    command.room_grid_owner_id = -1;
+    command.room_grid_id       = -1;
+    command.entity_type        = NONE;
+    command.entity_handle      = entity_handle;
+    buffer.commands.push_back(command);
+}
+
+void
+entityCommandBufferMove(EntityCommandBuffer& buffer, int entity_handle, Vec3F new_grid_pos)
+{
+    EntityCommand command;
+    command.type               = COMMAND_MOVE;
+    command.sequence           = (uint)buffer.commands.size();
+    command.room_grid_owner_id = -1;
+    command.room_grid_id       = -1;
+    command.entity_type        = NONE;
+    command.entity_handle      = entity_handle;
+    command.position           = new_grid_pos;
+    buffer.commands.push_back(command);
+}
+
+static bool
+entityCommandLess(const EntityCommand& a, const EntityCommand& b)
+{
+    // Destroys, then moves, then creates. Entities allocating a RoomGrid are created
+    // first so the RoomGrids exist for the rest. The rest are grouped by RoomGrid and
+    // type so each group can be created in bulk. Otherwise keeps the recorded order.
+    if(a.type != b.type) {return a.type < b.type;}
+    if(a.type == COMMAND_CREATE)
+    {
+	bool a_allocates = (a.room_grid_id > -1);
+	bool b_allocates = (b.room_grid_id > -1);
+	if(a_allocates != b_allocates) {return a_allocates;}
+	if(a_allocates) {return a.sequence < b.sequence;}
+	if(a.room_grid_owner_id != b.room_grid_owner_id) {return a.room_grid_owner_id < b.room_grid_owner_id;}
+	if(a.entity_type != b.entity_type) {return a.entity_type < b.entity_type;}
+    }
+    return a.sequence < b.sequence;
+}
+
+static void
+activeEntitiesClearCellFlags(ActiveEntities& entities, RoomGridLookup& roomgrid_lookup, uint entity_ID)
+{
+    // Called with activeEntitiesMarkInactive: the entity keeps its cell until
+    // activeEntitiesRemoveInactives, but no longer blocks or is pushed
+    if(!activeEntitiesTypeHas(entities, entities.types[entity_ID], COMPONENT_GRID_POSITION)) {return;}
+    int roomgrid_id = entities.roomgrid_owner_ids[entity_ID];
+    if(roomgrid_id < 0 || !roomgrid_lookup.roomgrid_pointers[roomgrid_id]) {return;}
+
+    RoomGrid& room_grid = *roomgrid_lookup.roomgrid_pointers[roomgrid_id];
+    Vec3F pos = vec3FColumnsGet(entities.grid_positions, entity_ID);
+    if(roomGridGetEntity(room_grid, pos) == entities.handles[entity_ID])
+    {
+	roomGridClearCellFlags(room_grid, pos);
+    }
+}
+
+void
+entityCommandBufferPlayback(EntityCommandBuffer& buffer,
+				ActiveEntities& entities,
+				RoomGridLookup& roomgrid_lookup)
+{
+    // Sync point - applies and clears all recorded commands. Should be run after the
+    // systems that record commands and before activeEntitiesRemoveInactives.
+    // Commands naming a removed entity are skipped. Moves onto an occupied cell are
+    // reported & skipped.
+
+    // Commands are usually recorded a RoomGrid & type at a time, already in order
+    if(!std::is_sorted(buffer.commands.begin(), buffer.commands.end(), entityCommandLess))
+    {
+	std::sort(buffer.commands.begin(), buffer.commands.end(), entityCommandLess);
+    }
+
+    std::vector<Vec3F> origins;
+    uint i = 0;
+    while(i < buffer.commands.size())
+    {
+	const EntityCommand& command = buffer.commands[i];
+	if(command.type == COMMAND_DESTROY)
+	{
+	    int entity_id = activeEntitiesGetID(entities, command.entity_handle);
+	    if(entity_id > -1)
+	    {
+		activeEntitiesMarkInactive(entities, entity_id);
+		activeEntitiesClearCellFlags(entities, roomgrid_lookup, entity_id);
+	    }
+	    i++;
+	}
+	else if(command.type == COMMAND_MOVE)
+	{
+	    int entity_id = activeEntitiesGetID(entities, command.entity_handle);
+	    if(entity_id > -1 && activeEntitiesIsActive(entities, entity_id) &&
+	       activeEntitiesTypeHas(entities, entities.types[entity_id], COMPONENT_GRID_POSITION))
+	    {
+		int roomgrid_owner_id = entities.roomgrid_owner_ids[entity_id];
+		if(roomgrid_owner_id > -1)
+		{
+		    RoomGrid& room_grid = *roomgrid_lookup.roomgrid_pointers[roomgrid_owner_id];
+		    if(roomGridGetEntity(room_grid, command.position) != NO_ENTITY)
+		    {
+			OutputDebugStringA("ERROR - Failed to move entity - Cell is occupied.\n");
+		    }
+		    else if(activeEntitiesUnshareCells(entities, roomgrid_lookup, roomgrid_owner_id, &command.position, 1))
+		    {
+			Vec3F cur_position = vec3FColumnsGet(entities.grid_positions, entity_id);
+			uint  cell_flags   = roomGridCellGetFlags(roomGridGetCell(room_grid, cur_position));
+			roomGridRemoveEntity(room_grid, cur_position);
+			roomGridSetEntity(room_grid, command.position, command.entity_handle, cell_flags);
+			activeEntitiesSetGridPosition(entities, roomgrid_lookup, entity_id, command.position);
+			bitsetSet(entities.bitsets[BITSET_GRID_DIRTY], entity_id);
+		    }
+		}
+		else
+		{
+		    vec3FColumnsSet(entities.grid_positions, entity_id, command.position);
+		    bitsetSet(entities.bitsets[BITSET_GRID_DIRTY], entity_id);
+		}
+	    }
+	    i++;
+	}
+	else if(command.room_grid_id > -1 ||
+		activeEntitiesTypeHas(entities, command.entity_type, COMPONENT_ROOM_GRID))
+	{
+	    // Entities owning a RoomGrid are created one at a time
+	    activeEntitiesCreateEntity(entities,
+				       roomgrid_lookup,
+				       command.room_grid_owner_id,
+				       command.room_grid_id,
+				       command.position,
+				       command.entity_type);
+	    i++;
+	}
+	else
+	{
+	    // Gather the run of creations sharing a RoomGrid and type, then create in bulk
+	    origins.clear();
+	    uint run_end = i;
+	    while(run_end < buffer.commands.size() &&
+		  buffer.commands[run_end].type == COMMAND_CREATE &&
+		  buffer.commands[run_end].room_grid_id == -1 &&
+		  buffer.commands[run_end].room_grid_owner_id == command.room_grid_owner_id &&
+		  buffer.commands[run_end].entity_type == command.entity_type)
+	    {
+		origins.push_back(buffer.commands[run_end].position);
+		run_end++;
+	    }
+	    activeEntitiesCreateEntities(entities,
+					 roomgrid_lookup,
+					 command.room_grid_owner_id,
+					 &origins[0],
+					 (uint)origins.size(),
+					 command.entity_type,
+					 NULL);
+	    i = run_end;
+	}
+    }
+    buffer.commands.clear();
+}
+
+// RoomTransformTable Functions //
+
+uint
+roomTransformTableUpdateEntity(const RoomTransformTable& table, ActiveEntities& entities, uint i)
+{
+    // Recomputes the transform of entity i from its grid position & its RoomGrid's
+    // entry. Only entities that moved, or whose RoomGrid moved or scaled, are recomputed.
+    // Returns 1 if the transform was written, 0 otherwise
+    int rg_id = entities.roomgrid_owner_ids[i];
+    if(rg_id < 0) {return 0;}
+
+    uint r = rg_id + 1;
+    if(table.dirty[r] < 0) {return 0;}
+    if(!bitsetGet(entities.bitsets[BITSET_GRID_DIRTY], i) && !table.dirty[r]) {return 0;}
+
+    // Update scale
+    float scale = table.scales[r];
+    entities.transform_scales.x[i] = scale;
+    entities.transform_scales.y[i] = scale;
+    entities.transform_scales.z[i] = scale;
+    // Update position, offset by the depth offset
+    entities.transform_positions.x[i] = entities.grid_positions.x[i] * scale + table.bases_x[r];
+    entities.transform_positions.y[i] = entities.grid_positions.y[i] * scale + table.bases_y[r];
+    entities.transform_positions.z[i] = entities.grid_positions.z[i] * scale + table.bases_z[r];
+    bitsetClear(entities.bitsets[BITSET_GRID_DIRTY], i);
+    return 1;
+}
+
+#if AVX2_KERNELS
+uint
+roomTransformTableUpdateRange(const RoomTransformTable& table, ActiveEntities& entities,
+			      uint begin_ID, uint end_ID)
+{
+    // roomTransformTableUpdateEntity, 8 entities at a time. begin_ID starts a bitset
+    // word, so every group of 8 is a byte of the bitsets and an aligned load of the
+    // columns. The CPU must have AVX2, see cpuHasAVX2.
+    // Returns the number of transforms written
+    const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256i no_room   = _mm256_set1_epi32(-1);
+    uint touched = 0;
+    for(uint i = begin_ID; i < end_ID; i += 8)
+    {
+	uint w = i >> 6;
+	uint shift = i & 63;
+	uint lanes = (uint)((entities.bitsets[BITSET_LIVE][w] &
+			     entities.bitsets[BITSET_GRID_POSITION][w]) >> shift) & 0xFF;
+	if(!lanes) {continue;}
+	uint dirty_lanes = (uint)(entities.bitsets[BITSET_GRID_DIRTY][w] >> shift) & 0xFF;
+
+	// Lanes to update: tagged, in a RoomGrid that is not a template, and dirty or in a
+	// dirty RoomGrid
+	__m256i rg_ids  = _mm256_load_si256((const __m256i*)&entities.roomgrid_owner_ids[i]);
+	__m256i rooms   = _mm256_sub_epi32(rg_ids, no_room);
+	__m256i room_states = _mm256_i32gather_epi32(table.dirty.data(), rooms, 4);
+	__m256i in_room = _mm256_and_si256(_mm256_cmpgt_epi32(rg_ids, no_room),
+					   _mm256_cmpgt_epi32(room_states, no_room));
+	__m256i room_dirty = _mm256_cmpgt_epi32(room_states, _mm256_setzero_si256());
+	__m256i tagged = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(lanes), lane_bits), lane_bits);
+	__m256i dirty  = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(dirty_lanes), lane_bits), lane_bits);
+	__m256i update = _mm256_and_si256(_mm256_and_si256(tagged, in_room), _mm256_or_si256(dirty, room_dirty));
+	uint update_lanes = (uint)_mm256_movemask_ps(_mm256_castsi256_ps(update));
+	if(!update_lanes) {continue;}
+
+	__m256 scale  = _mm256_i32gather_ps(table.scales.data(), rooms, 4);
+	__m256 base_x = _mm256_i32gather_ps(table.bases_x.data(), rooms, 4);
+	__m256 base_y = _mm256_i32gather_ps(table.bases_y.data(), rooms, 4);
+	__m256 base_z = _mm256_i32gather_ps(table.bases_z.data(), rooms, 4);
+	__m256 x = _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(&entities.grid_positions.x[i]), scale), base_x);
+	__m256 y = _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(&entities.grid_positions.y[i]), scale), base_y);
+	__m256 z = _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(&entities.grid_positions.z[i]), scale), base_z);
+	_mm256_maskstore_ps(&entities.transform_positions.x[i], update, x);
+	_mm256_maskstore_ps(&entities.transform_positions.y[i], update, y);
+	_mm256_maskstore_ps(&entities.transform_positions.z[i], update, z);
+	_mm256_maskstore_ps(&entities.transform_scales.x[i], update, scale);
+	_mm256_maskstore_ps(&entities.transform_scales.y[i], update, scale);
+	_mm256_maskstore_ps(&entities.transform_scales.z[i], update, scale);
+
+	entities.bitsets[BITSET_GRID_DIRTY][w] &= ~((uint64)update_lanes << shift);
+	touched += (uint)__popcnt(update_lanes);
+    }
+    // The rest of the build may be SSE code
+    _mm256_zeroupper();
+    return touched;
+}
+#endif
+
+// RoomGrid Functions //
+
+template<uint WIDTH, uint HEIGHT, uint LENGTH>
+static inline bool
+roomGridLocateSized(const RoomGrid& room_grid, Vec3F pos, uint& brick, uint& cell)
+{
+    // Extents of 0 are read from room_grid, others are compile-time constants
+    const uint width         = WIDTH  ? WIDTH  : room_grid.width;
+    const uint height        = HEIGHT ? HEIGHT : room_grid.height;
+    const uint length        = LENGTH ? LENGTH : room_grid.length;
+    const uint bricks_height = HEIGHT ? (HEIGHT + RG_BRICK_SIZE - 1) / RG_BRICK_SIZE : room_grid.bricks_height;
+    const uint bricks_length = LENGTH ? (LENGTH + RG_BRICK_SIZE - 1) / RG_BRICK_SIZE : room_grid.bricks_length;
+    
+    if(pos.x < 0.0f || pos.x >= (float)width ||
+       pos.y < 0.0f || pos.y >= (float)height ||
+       pos.z < 0.0f || pos.z >= (float)length)
+    {
+	return false;
+    }
+
+    // Unsigned past the bounds check, so the divisions are shifts
+    uint x = (uint)pos.x;
+    uint y = (uint)pos.y;
+    uint z = (uint)pos.z;
+    brick = ((x / RG_BRICK_SIZE) * bricks_height + (y / RG_BRICK_SIZE)) * bricks_length + (z / RG_BRICK_SIZE);
+    cell  = roomGridGetBrickCell(x, y, z);
+    return true;
+}
+
+static inline bool
+roomGridLocate(const RoomGrid& room_grid, Vec3F pos, uint& brick, uint& cell)
+{
+    // Finds the brick & cell holding pos. Returns false if pos is outside room_grid.
+    switch(room_grid.size_class)
+    {
+        case RG_SIZE_DEFAULT:
+	    return roomGridLocateSized<RG_DEFAULT_WIDTH, RG_DEFAULT_HEIGHT, RG_DEFAULT_LENGTH>(room_grid, pos,
+											      brick, cell);
+        case RG_SIZE_SMALL:
+	    return roomGridLocateSized<RG_SMALL_WIDTH, RG_SMALL_HEIGHT, RG_SMALL_LENGTH>(room_grid, pos,
+											brick, cell);
+        default:
+	    return roomGridLocateSized<0, 0, 0>(room_grid, pos, brick, cell);
+    }
+}
+
+static RoomGridBrick
+roomGridBrickMakeEmpty()
+{
+    RoomGridBrick brick;
+    memset(brick.cells, -1, sizeof(brick.cells));
+    memset(brick.flags, 0, sizeof(brick.flags));
+    brick.ref_count = 0;
+    return brick;
+}
+
+// Read in place of bricks that are not allocated, so lookups need no branch on them
+static const RoomGridBrick rg_empty_brick = roomGridBrickMakeEmpty();
+
+RoomGridCell
+roomGridGetCell(const RoomGrid& room_grid, Vec3F pos)
+{
+    // Returns the packed cell (handle & RoomGridCellFlags) on success. Returns -1 if no
+    // entity. Returns -2 if out of bounds.
+    
+    uint brick, cell;
+    if(!roomGridLocate(room_grid, pos, brick, cell))
+    {
+	return INVALID_RANGE;
+    }
+    // Empty cells hold NO_ENTITY & no flags, which sign extend to a NO_ENTITY cell, so
+    // the occupancy bit is not tested. A branch on it mispredicts in sparse rooms.
+    const RoomGridBrick* brick_p = room_grid.bricks[brick];
+    if(!brick_p) {brick_p = &rg_empty_brick;}
+    return (RoomGridCell)brick_p->cells[cell] | ((RoomGridCell)brick_p->flags[cell] << 32);
+}
+
+int
+roomGridGetEntity(const RoomGrid& room_grid, Vec3F pos)
+{
+    // Returns entity handle on success. Returns -1 if no entity. Returns -2 if out of bounds.
+    return roomGridCellGetHandle(roomGridGetCell(room_grid, pos));
+}
+
+static bool
+roomGridBrickIsWritable(const RoomGrid& room_grid, uint brick)
+{
+    // A brick shared by a template & its clones must not be written, the change would
+    // show in all of them. Clones unshare bricks first, see roomGridPrepareWrite.
+    if(room_grid.bricks[brick]->ref_count == 1) {return true;}
+    OutputDebugStringA("ERROR - Failed to write RoomGrid cell - Brick is shared.\n");
+    _assert(false);
+    return false;
+}
+
+void
+roomGridSetEntity(RoomGrid& room_grid, Vec3F pos, int entity_handle, uint cell_flags)
+{
+    _assert(roomGridContains(room_grid, pos));
+
+    if(entity_handle < 0)
+    {
+	roomGridRemoveEntity(room_grid, pos);
+	return;
+    }
+
+    uint brick, cell;
+    if(!roomGridLocate(room_grid, pos, brick, cell)) {return;}
+    RoomGridBrick*& brick_p = room_grid.bricks[brick];
+    if(!brick_p)
+    {
+	brick_p = new RoomGridBrick;
+	memset(brick_p->cells, -1, sizeof(brick_p->cells));
+	memset(brick_p->flags, 0, sizeof(brick_p->flags));
+	brick_p->ref_count = 1;
+    }
+    if(!roomGridBrickIsWritable(room_grid, brick)) {return;}
+    brick_p->cells[cell] = entity_handle;
+    brick_p->flags[cell] = (uchar)(cell_flags & CELL_FLAGS);
+    room_grid.occupancy[brick] |= (1ULL << cell);
+}
+
+void
+roomGridRemoveEntity(RoomGrid& room_grid, Vec3F pos)
+{
+    _assert(roomGridContains(room_grid, pos));
+
+    uint brick, cell;
+    if(!roomGridLocate(room_grid, pos, brick, cell)) {return;}
+    if(!((room_grid.occupancy[brick] >> cell) & 1)) {return;}
+    if(!roomGridBrickIsWritable(room_grid, brick)) {return;}
+
+    room_grid.bricks[brick]->cells[cell] = NO_ENTITY;
+    room_grid.bricks[brick]->flags[cell] = 0;
+    room_grid.occupancy[brick] &= ~(1ULL << cell);
+
+    // Free the brick once its last cell empties
+    if(!room_grid.occupancy[brick])
+    {
+	delete room_grid.bricks[brick];
+	room_grid.bricks[brick] = NULL;
+    }
+}
+
+void
+roomGridClearCellFlags(RoomGrid& room_grid, Vec3F pos)
+{
+    uint brick, cell;
+    if(!roomGridLocate(room_grid, pos, brick, cell)) {return;}
+    if(!((room_grid.occupancy[brick] >> cell) & 1)) {return;}
+    if(!roomGridBrickIsWritable(room_grid, brick)) {return;}
+    room_grid.bricks[brick]->flags[cell] = 0;
+}
+
+static int
+roomGridUnshareBrick(RoomGrid& room_grid, ActiveEntities& entities, uint brick)
+{
+    // Gives a clone its own copy of a brick it shares with its template, with a new
+    // entity of the same type for each template entity in it. The copies start from their
+    // type's prefab & are made with activeEntitiesCreateEntitiesConcurrent: their cells
+    // are set at once and they join the queries & contents at activeEntitiesPublishCreated.
+    // Returns 1 on success, 0 if the reserved entities are full (nothing is changed).
+
+    if(!roomGridBrickIsShared(room_grid, brick)) {return 1;}
+
+    RoomGridBrick* shared_p = room_grid.bricks[brick];
+    uint64 occupied = room_grid.occupancy[brick];
+    uint copy_count = bitsetCount(&occupied, 0, 1);
+    if(!activeEntitiesIsReserved(entities, entities.pending_count.load() + copy_count))
+    {
+	OutputDebugStringA("ERROR - Failed to unshare RoomGrid brick - Reserved entities full.\n");
+	return 0;
+    }
+
+    RoomGridBrick* brick_p = new RoomGridBrick;
+    memset(brick_p->cells, -1, sizeof(brick_p->cells));
+    memset(brick_p->flags, 0, sizeof(brick_p->flags));
+    brick_p->ref_count = 1;
+    while(occupied)
+    {
+	uint cell = bitsetPopLowest(occupied);
+	int template_id = activeEntitiesGetID(entities, shared_p->cells[cell]);
+	_assert(template_id > -1); // Templates must not change once cloned
+	_assert(!activeEntitiesTypeHas(entities, entities.types[template_id], COMPONENT_ROOM_GRID));
+	Vec3F pos = roomGridGetCellPosition(room_grid, brick, cell);
+	int handle = -1;
+	activeEntitiesCreateEntitiesConcurrent(entities, room_grid.roomgrid_id, &pos, 1,
+					       entities.types[template_id], &handle);
+	brick_p->cells[cell] = handle;
+	brick_p->flags[cell] = shared_p->flags[cell];
+    }
+    shared_p->ref_count--;
+    room_grid.bricks[brick] = brick_p;
+    return 1;
+}
+
+int
+roomGridPrepareWrite(RoomGrid& room_grid, ActiveEntities& entities, RoomGridLookup& roomgrid_lookup, Vec3F pos)
+{
+    // Must be called before writing a cell of a clone whose contents are read first,
+    // e.g. before moving the entity in it, and outside systems: the copies are published
+    // at once, so their handles resolve like any other.
+    // Returns 1 on success, 0 on failure.
+    if(room_grid.template_id < 0 || !roomGridContains(room_grid, pos)) {return 1;}
+    uint brick = roomGridGetBrickIndex(room_grid, (uint)pos.x, (uint)pos.y, (uint)pos.z);
+    if(!roomGridBrickIsShared(room_grid, brick)) {return 1;}
+
+    // Reserved only for the brick being copied
+    if(!activeEntitiesReserve(entities, entities.count + entities.pending_count.load() + RG_BRICK_CELLS) ||
+       !roomGridUnshareBrick(room_grid, entities, brick))
+    {
+	return 0;
+    }
+    activeEntitiesPublishCreated(entities, roomgrid_lookup);
+    return 1;
+}
+
+// Grid Move Functions //
+
+static void
+roomGridSetPushMark(RoomGrid& room_grid, Vec3F pos, bool is_marked)
+{
+    // Marks pos as left by an entity of the push line being scanned, or clears the mark
+    uint brick, cell;
+    if(!roomGridLocate(room_grid, pos, brick, cell)) {return;}
+    if(!room_grid.push_marks) {room_grid.push_marks = new uint64[room_grid.brick_count]();}
+    if(is_marked) {room_grid.push_marks[brick] |= (1ULL << cell);}
+    else          {room_grid.push_marks[brick] &= ~(1ULL << cell);}
+}
+
+static bool
+roomGridHasPushMark(const RoomGrid& room_grid, Vec3F pos)
+{
+    uint brick, cell;
+    if(!room_grid.push_marks || !roomGridLocate(room_grid, pos, brick, cell)) {return false;}
+    return ((room_grid.push_marks[brick] >> cell) & 1) != 0;
+}
+
+static bool
+roomGridIsCellShared(const RoomGrid& room_grid, Vec3F pos)
+{
+    // True if pos is in a brick a clone still shares with its template
+    return (room_grid.template_id > -1 &&
+	    roomGridBrickIsShared(room_grid, roomGridGetBrickIndex(room_grid, (uint)pos.x, (uint)pos.y, (uint)pos.z)));
+}
+
+static int
+roomGridGetPushExit(const ActiveEntities& entities,
+		    const RoomGridLookup& roomgrid_lookup,
+		    GridMove& move,
+		    RoomGridCell mover_cell,
+		    Vec3F move_dir)
+{
+    // A move off its RoomGrid leaves through the owner's cell holding the RoomGrid,
+    // through as many owners as it takes. Entities holding RoomGrids stay in theirs.
+    // Returns 1 if move.to is on a RoomGrid, 0 otherwise
+    while(!roomGridContains(*move.to_p, move.to))
+    {
+	int owner_id = move.to_p->roomgrid_owner_id;
+	int holder_id = activeEntitiesGetID(entities, move.to_p->owner_entity_handle);
+	if(owner_id < 0 || holder_id < 0 || (roomGridCellGetFlags(mover_cell) & CELL_ROOM)) {return 0;}
+	move.to_p = roomgrid_lookup.roomgrid_pointers[owner_id];
+	move.to   = vec3FColumnsGet(entities.grid_positions, holder_id) + move_dir;
+    }
+    return 1;
+}
+
+static Vec3F
+roomGridGetPushEntry(const RoomGrid& rg, Vec3F move_dir, float y)
+{
+    // Cell an entity moving along move_dir enters rg at: the middle of the side facing
+    // it, at the height it came in at
+    Vec3F entry = Vec3F((float)(rg.width / 2),
+			clamp(y, 0.0f, (float)(rg.height - 1)),
+			(float)(rg.length / 2));
+    if(move_dir.x != 0.0f) {entry.x = (move_dir.x > 0.0f) ? 0.0f : (float)(rg.width - 1);}
+    if(move_dir.y != 0.0f) {entry.y = (move_dir.y > 0.0f) ? 0.0f : (float)(rg.height - 1);}
+    if(move_dir.z != 0.0f) {entry.z = (move_dir.z > 0.0f) ? 0.0f : (float)(rg.length - 1);}
+    return entry;
+}
+
+static int
+roomGridEnterPushedRoom(const ActiveEntities& entities,
+			const RoomGridLookup& roomgrid_lookup,
+			std::vector<GridMove>& moves,
+			GridMove& move,
+			Vec3F move_dir)
+{
+    // For a blocked line: the entity in front of the nearest pushed BLOCK_ROOM enters
+    // it instead of pushing it. moves is cut back to before that entity's move, which is
+    // returned in move. Returns 1 if a BLOCK_ROOM can be entered, 0 otherwise
+    for(int k = (int)moves.size() - 1; k >= 0; k--)
+    {
+	const GridMove& pushed = moves[k];
+	RoomGridCell room_cell = roomGridGetCell(*pushed.to_p, pushed.to);
+	if(!(roomGridCellGetFlags(room_cell) & CELL_ROOM)) {continue;}
+	if(roomGridCellGetFlags(roomGridGetCell(*pushed.from_p, pushed.from)) & CELL_ROOM) {continue;}
+	int room_id = activeEntitiesGetID(entities, roomGridCellGetHandle(room_cell));
+	int rg_id = (room_id > -1) ? entities.roomgrid_ids[room_id] : -1;
+	RoomGrid* rg_p = (rg_id > -1) ? roomgrid_lookup.roomgrid_pointers[rg_id] : NULL;
+	if(!rg_p) {continue;}
+
+	move = pushed;
+	move.to_p = rg_p;
+	move.to   = roomGridGetPushEntry(*rg_p, move_dir, move.from.y);
+	for(uint c = k; c < moves.size(); c++) {roomGridSetPushMark(*moves[c].from_p, moves[c].from, false);}
+	moves.resize(k);
+	return 1;
+    }
+    return 0;
+}
+
+static int
+roomGridScanPushLine(RoomGrid& grid,
+		     const ActiveEntities& entities,
+		     const RoomGridLookup& roomgrid_lookup,
+		     Vec3F cur_grid_pos,
+		     Vec3F new_grid_pos,
+		     std::vector<GridMove>& moves)
+{
+    // The cells each entity of the line leaves are marked, so a line reaching one again
+    // is found in one lookup. roomGridGetPushLine clears the marks.
+
+    // Check that target position is not current position
+    if(new_grid_pos == cur_grid_pos)
+    {
+	return 0;
+    }
+    
+    // The move is validated from the packed cells alone. If the current cell is empty,
+    // this call is invalid and should fail.
+    if(roomGridGetCell(grid, cur_grid_pos) < 0) {return 0;}
+
+    Vec3F move_dir = new_grid_pos - cur_grid_pos;
+    GridMove move;
+    move.from_p = &grid;
+    move.from   = cur_grid_pos;
+    move.to_p   = &grid;
+    move.to     = new_grid_pos;
+    uint entries = 0;
+    bool is_free = false;
+    while(!is_free)
+    {
+	if(moves.size() >= GRID_PUSH_MAX_LINE) {return 0;}
+	
+	// Check neighbor and set entity destination accordingly. Destroyed entities have
+	// their flags cleared and are overwritten.
+	RoomGridCell mover_cell = roomGridGetCell(*move.from_p, move.from);
+	bool is_blocked = !roomGridGetPushExit(entities, roomgrid_lookup, move, mover_cell, move_dir);
+	uint neighbor_flags = 0;
+	if(!is_blocked)
+	{
+	    // A line reaching any of its own cells again, through BLOCK_ROOMs & out of
+	    // nested RoomGrids, loops & fails
+	    if((move.to_p == &grid && move.to == cur_grid_pos) || roomGridHasPushMark(*move.to_p, move.to)) {return 0;}
+	    neighbor_flags = roomGridCellGetFlags(roomGridGetCell(*move.to_p, move.to));
+	    is_blocked = (neighbor_flags & CELL_COLLISION) != 0;
+	}
+	if(is_blocked)
+	{
+	    if(++entries > GRID_PUSH_MAX_ENTRIES ||
+	       !roomGridEnterPushedRoom(entities, roomgrid_lookup, moves, move, move_dir))
+	    {
+		return 0;
+	    }
+	    continue;
+	}
+	moves.push_back(move);
+	roomGridSetPushMark(*move.from_p, move.from, true);
+	
+	// If target destination contains a pushable entity, it moves next
+	is_free = !(neighbor_flags & CELL_PUSHABLE);
+	move.from_p = move.to_p;
+	move.from   = move.to;
+	move.to     = move.to + move_dir;
+    }
+    return 1;
+}
+
+int
+roomGridGetPushLine(RoomGrid& grid,
+		    const ActiveEntities& entities,
+		    const RoomGridLookup& roomgrid_lookup,
+		    Vec3F cur_grid_pos,
+		    Vec3F new_grid_pos,
+		    std::vector<GridMove>& moves)
+{
+    // Scans the line of entities the entity at cur_grid_pos pushes moving to new_grid_pos
+    // into moves, in order from the mover. Nothing is written but the push marks.
+    // Returns 1 if the line can move, 0 otherwise
+    moves.clear();
+    int is_movable = roomGridScanPushLine(grid, entities, roomgrid_lookup, cur_grid_pos, new_grid_pos, moves);
+    for(uint k = 0; k < moves.size(); k++) {roomGridSetPushMark(*moves[k].from_p, moves[k].from, false);}
+    return is_movable;
+}
+
+int
+roomGridMoveEntities(RoomGrid& grid,
+		     ActiveEntities& entities,
+		     RoomGridLookup& roomgrid_lookup,
+		     Vec3F cur_grid_pos,
+		     Vec3F new_grid_pos,
+		     std::vector<GridMove>& moves)
+{
+    // Moves the entity at cur_grid_pos to new_grid_pos, pushing the line of pushable
+    // entities in front of it. The line is committed from its far end so each
+    // destination is free when its entity arrives. Clone bricks on the line must have
+    // been unshared with roomGridPrepareWrite, a line reaching a shared one is refused.
+    // Returns 1 on success, 0 on failure (nothing is moved)
+    if(!roomGridGetPushLine(grid, entities, roomgrid_lookup, cur_grid_pos, new_grid_pos, moves)) {return 0;}
+    for(uint k = 0; k < moves.size(); k++)
+    {
+	if(roomGridIsCellShared(*moves[k].from_p, moves[k].from) ||
+	   roomGridIsCellShared(*moves[k].to_p, moves[k].to))
+	{
+	    return 0;
+	}
+    }
+
+    for(int k = (int)moves.size() - 1; k >= 0; k--)
+    {
+	const GridMove& line_move = moves[k];
+	RoomGridCell cell = roomGridGetCell(*line_move.from_p, line_move.from);
+	int entity_handle = roomGridCellGetHandle(cell);
+	roomGridRemoveEntity(*line_move.from_p, line_move.from);
+	roomGridSetEntity(*line_move.to_p, line_move.to, entity_handle, roomGridCellGetFlags(cell));
+	
+	int entity_id = activeEntitiesGetID(entities, entity_handle);
+	_assert(entity_id > -1);
+	if(line_move.to_p != line_move.from_p)
+	{
+	    activeEntitiesSetRoomGridOwner(entities, roomgrid_lookup, entity_id, line_move.to_p->roomgrid_id);
+	}
+	activeEntitiesSetGridPosition(entities, roomgrid_lookup, entity_id, line_move.to);
+	bitsetSet(entities.bitsets[BITSET_GRID_DIRTY], entity_id);
+    }
+    return 1;
+}
+
+uint
+roomGridGetMemory(const RoomGrid& room_grid)
+{
+    // Returns the bytes used by the cell storage, for comparing layouts. Bricks a clone
+    // shares are counted for its template only.
+    uint bytes = room_grid.brick_count * (sizeof(RoomGridBrick*) + sizeof(uint64));
+    for(uint i = 0; i < room_grid.brick_count; i++)
+    {
+	if(room_grid.bricks[i] && !roomGridBrickIsShared(room_grid, i)) {bytes += sizeof(RoomGridBrick);}
+    }
+    return bytes;
+}
+
+static inline uint
+roomGridGetScanKey(const RoomGrid& room_grid, Vec3F pos)
+{
+    // Position in the dense x, y, z scan order the searches below break ties by
+    return ((uint)pos.x * room_grid.height + (uint)pos.y) * room_grid.length + (uint)pos.z;
+}
+
+static inline void
+roomGridConsiderNearest(const RoomGrid& room_grid, const RoomGridTypeList& list, uint k,
+			float distance, float& best_distance, uint& best_key, Vec3F& best_pos)
+{
+    // Keeps list entry k if it is nearer than the best so far, or as near & earlier in
+    // x, y, z order. Distances are squared, & 0 is the searching cell itself. An entity
+    // another was created over is still listed, but no longer on its cell, as is a
+    // template entity in a brick the clone has unshared.
+    if(distance == 0.0f || distance > best_distance) {return;}
+    Vec3F pos = Vec3F(list.xs[k], list.ys[k], list.zs[k]);
+    uint  key = roomGridGetScanKey(room_grid, pos);
+    if((distance < best_distance || key < best_key) &&
+       roomGridGetEntity(room_grid, pos) == list.handles[k])
+    {
+	best_distance = distance;
+	best_key      = key;
+	best_pos      = pos;
+    }
+}
+
+#if AVX2_KERNELS
+static uint
+roomGridFindNearestInList8(const RoomGrid& room_grid, const RoomGridTypeList& list, Vec3F cur_pos,
+			   float& best_distance, uint& best_key, Vec3F& best_pos)
+{
+    // roomGridFindNearestInList over whole groups of 8 entries. The CPU must have AVX2,
+    // see cpuHasAVX2.
+    // Returns the number of entries visited
+    uint count = (uint)list.handles.size();
+    uint k = 0;
+    __m256 cur_x = _mm256_set1_ps(cur_pos.x);
+    __m256 cur_y = _mm256_set1_ps(cur_pos.y);
+    __m256 cur_z = _mm256_set1_ps(cur_pos.z);
+    __m256 zero  = _mm256_setzero_ps();
+    for(; k + 8 <= count; k += 8)
+    {
+	__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&list.xs[k]), cur_x);
+	__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&list.ys[k]), cur_y);
+	__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(&list.zs[k]), cur_z);
+	__m256 distances = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+					 _mm256_mul_ps(dz, dz));
+	// Lanes no farther than the best & not the searching cell
+	__m256 is_near = _mm256_and_ps(_mm256_cmp_ps(distances, _mm256_set1_ps(best_distance), _CMP_LE_OQ),
+				       _mm256_cmp_ps(distances, zero, _CMP_GT_OQ));
+	uint64 lanes = (uint64)_mm256_movemask_ps(is_near);
+	if(!lanes) {continue;}
+	
+	float lane_distances[8];
+	_mm256_storeu_ps(lane_distances, distances);
+	while(lanes)
+	{
+	    uint lane = bitsetPopLowest(lanes);
+	    roomGridConsiderNearest(room_grid, list, k + lane, lane_distances[lane],
+				    best_distance, best_key, best_pos);
+	}
+    }
+    // The rest of the build may be SSE code
+    _mm256_zeroupper();
+    return k;
+}
+
+static const bool rg_has_avx2 = cpuHasAVX2();
+#endif
+
+static void
+roomGridFindNearestInList(const RoomGrid& room_grid, const RoomGridTypeList& list, Vec3F cur_pos,
+			  float& best_distance, uint& best_key, Vec3F& best_pos)
+{
+    // The entries of list on room_grid's cells, 8 at a time if the CPU has AVX2
+    uint count = (uint)list.handles.size();
+    uint k = 0;
+#if AVX2_KERNELS
+    if(rg_has_avx2) {k = roomGridFindNearestInList8(room_grid, list, cur_pos, best_distance, best_key, best_pos);}
+#endif
+    for(; k < count; k++)
+    {
+	float dx = list.xs[k] - cur_pos.x;
+	float dy = list.ys[k] - cur_pos.y;
+	float dz = list.zs[k] - cur_pos.z;
+	roomGridConsiderNearest(room_grid, list, k, dx * dx + dy * dy + dz * dz,
+				best_distance, best_key, best_pos);
+    }
+}
+
+Vec3F
+roomGridFindNearestType(RoomGrid& room_grid, ActiveEntities& entities,
+			       Vec3F cur_pos, uint target_type)
+{
+    // Returns the grid position of the nearest entity of target_type, or twice the
+    // extents if there is none. Ties go to the earliest cell in x, y, z order.
+    // Only the RoomGrid's contents of that type are visited, then for a clone the
+    // template's, which stand in for it in the bricks it still shares.
+
+    float best_distance = FLT_MAX;
+    uint  best_key      = UINT_MAX;
+    Vec3F best_pos = Vec3F((float)room_grid.width * 2, (float)room_grid.height * 2, (float)room_grid.length * 2);
+    roomGridFindNearestInList(room_grid, room_grid.type_lists[target_type], cur_pos,
+			      best_distance, best_key, best_pos);
+    if(room_grid.template_p)
+    {
+	roomGridFindNearestInList(room_grid, room_grid.template_p->type_lists[target_type], cur_pos,
+				  best_distance, best_key, best_pos);
+    }
+    return best_pos;
+}
+
+static void
+roomGridFindFirstInList(const RoomGrid& room_grid, const ActiveEntities& entities,
+			const RoomGridTypeList& list, int& first_id, uint& first_key)
+{
+    // The entry of list on room_grid's cells earliest in x, y, z order
+    for(uint k = 0; k < list.handles.size(); k++)
+    {
+	int id = activeEntitiesGetID(entities, list.handles[k]);
+	if(id < 0) {continue;}
+	Vec3F pos = Vec3F(list.xs[k], list.ys[k], list.zs[k]);
+	uint  key = roomGridGetScanKey(room_grid, pos);
+	if((first_id == -1 || key < first_key) && roomGridGetEntity(room_grid, pos) == list.handles[k])
+	{
+	    first_id  = id;
+	    first_key = key;
+	}
+    }
+}
+
+int
+roomGridGetFirstIDByType(const RoomGrid* rg_p, const ActiveEntities* entities_p, uint target_type)
+{
+    // Returns the ID of the first entity of target_type in x, y, z order, or -1.
+    // Visits every entity of that type in the RoomGrid, then for a clone the template's,
+    // so the cost grows with their count. Moves change which is first, so it is not kept.
+    _assert(rg_p);
+    _assert(entities_p);
+
+    int  first_id  = -1;
+    uint first_key = 0;
+    roomGridFindFirstInList(*rg_p, *entities_p, rg_p->type_lists[target_type], first_id, first_key);
+    if(rg_p->template_p)
+    {
+	roomGridFindFirstInList(*rg_p, *entities_p, rg_p->template_p->type_lists[target_type],
+				first_id, first_key);
+    }
+    return first_id;
+}
+
+void
+roomGridRemoveOwner(RoomGrid& rg, ActiveEntities& entities, RoomGridLookup& roomgrid_lookup)
+{
+    // Makes rg the root RoomGrid: detaches the entity holding rg from the owning RoomGrid,
+    // then removes the owning RoomGrid's entity along with everything it contains, the
+    // player included. Zooming in does not call this, the viewed RoomGrid stays nested.
+
+    int owner_rg_id = rg.roomgrid_owner_id;
+    if(owner_rg_id < 0 || !roomgrid_lookup.roomgrid_pointers[owner_rg_id]) {return;}
+    RoomGrid& owner_rg = *roomgrid_lookup.roomgrid_pointers[owner_rg_id];
+
+    // Set proper transform and scale
+    rg.previous_scale = 1.0f;
+    rg.current_scale  = 1.0f;
+    rg.target_scale   = 1.0f;
+    rg.t = 1.0f;
+    rg.center = Vec3F(rg.width * rg.current_scale * 0.5f, 0.0f, rg.length * rg.current_scale * 0.5f);
+    rg.dirty = true;
+
+    // Detach the entity holding rg
+    int holder_id = activeEntitiesGetID(entities, rg.owner_entity_handle);
+    if(holder_id > -1)
+    {
+	Vec3F holder_pos = vec3FColumnsGet(entities.grid_positions, holder_id);
+	if(roomGridGetEntity(owner_rg, holder_pos) == rg.owner_entity_handle)
+	{
+	    roomGridRemoveEntity(owner_rg, holder_pos);
+	}
+	roomGridRemoveContent(owner_rg, entities, rg.owner_entity_handle);
+	entities.roomgrid_owner_ids[holder_id] = -1;
+	entities.defrag_dirty = true;
+	bitsetSet(entities.bitsets[BITSET_GRID_DIRTY], holder_id);
+    }
+
+    // Remove the owner, its contents are removed with it
+    int owner_id = activeEntitiesGetID(entities, owner_rg.owner_entity_handle);
+    if(owner_id > -1)
+    {
+	activeEntitiesMarkInactive(entities, owner_id);
+	activeEntitiesClearCellFlags(entities, roomgrid_lookup, owner_id);
+    }
+    rg.roomgrid_owner_id = -1;
+}
+
+void
+roomGridLookupInit(RoomGridLookup& rgl)
+{
+    rgl.roomgrid_pointers.clear();
+    rgl.extents.clear();
+}
+
+void
+roomGridLookupSetExtents(RoomGridLookup& rgl, uint roomgrid_id, uint width, uint height, uint length)
+{
+    // Sets the extents the RoomGrid is created with. Has no effect on an existing RoomGrid.
+    roomGridLookupReserve(rgl, roomgrid_id + 1);
+    rgl.extents[roomgrid_id * 3 + 0] = width;
+    rgl.extents[roomgrid_id * 3 + 1] = height;
+    rgl.extents[roomgrid_id * 3 + 2] = length;
+}
+
+int
+roomGridLookupAddID(RoomGridLookup& rgl)
+{
+    // Returns an id no RoomGrid has used yet
+    int roomgrid_id = (int)rgl.roomgrid_pointers.size();
+    roomGridLookupReserve(rgl, roomgrid_id + 1);
+    return roomgrid_id;
+}
+
+int
+roomGridLookupAddTemplate(RoomGridLookup& rgl, uint roomgrid_id)
 {
-    for(uint i = 0; i < TOTAL_ROOMGRIDS; i++)
+    // Allocates a template RoomGrid with the id's extents, to be filled like any other
+    // Returns 1 on success, 0 if the id is in use
+    roomGridLookupReserve(rgl, roomgrid_id + 1);
+    if(rgl.roomgrid_pointers[roomgrid_id])
     {
-	rgl.roomgrid_pointers[i] = NULL;
+	OutputDebugStringA("ERROR - Failed to add RoomGrid template - Id in use.\n");
+	return 0;
     }
+    RoomGrid* rg_p = new RoomGrid(rgl.extents[roomgrid_id * 3 + 0],
+				  rgl.extents[roomgrid_id * 3 + 1],
+				  rgl.extents[roomgrid_id * 3 + 2]);
+    rg_p->roomgrid_id = roomgrid_id;
+    rg_p->is_template = true;
+    rgl.roomgrid_pointers[roomgrid_id] = rg_p;
+    return 1;
 }
 
 // AI Functions
@@ -351,12 +2426,10 @@ aStarFindPath(RoomGrid& room_grid, Vec3F cur_grid_pos, Vec3F target_grid_pos)
     // TODO: room_grid and vector positions I'm using are not aligned - entities on 0 height,
     // but I am searching at height 1
     
-    _assert(target_grid_pos.x >= 0 && target_grid_pos.x < RG_MAX_WIDTH);
-    _assert(target_grid_pos.y >= 0 && target_grid_pos.y < RG_MAX_HEIGHT);
-    _assert(target_grid_pos.z >= 0 && target_grid_pos.z < RG_MAX_LENGTH);
+    _assert(roomGridContains(room_grid, target_grid_pos));
 
-    std::vector<Node> open(RG_MAX_WIDTH * RG_MAX_HEIGHT);
-    std::vector<Node> closed(RG_MAX_WIDTH * RG_MAX_HEIGHT);
+    std::vector<Node> open(room_grid.width * room_grid.height);
+    std::vector<Node> closed(room_grid.width * room_grid.height);
     Node cur_cheapest_node(cur_grid_pos, cur_grid_pos, target_grid_pos, NULL);
     
     while(!(cur_cheapest_node.grid_pos == target_grid_pos))
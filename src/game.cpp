@@ -8,6 +8,7 @@
 
 // C Libs //
 #include "cmath"
+#include <climits>
 
 // Game libs //
 #include "input.hpp"
@@ -16,6 +17,7 @@
 #include "draw.hpp"
 #include "utility.hpp"
 #include "mdcla.hpp"
+#include "scheduler.hpp"
 
 // Globals //
 InputManager    input_manager;
@@ -24,61 +26,53 @@ AssetManager    asset_manager;
 ActiveEntities* active_entities_p = new ActiveEntities();
 RoomGridLookup  roomgrid_lookup;
 RoomGridTransitionStatus rg_transition_status;
+EntityCommandBuffer entity_command_buffer;
+SystemScheduler system_scheduler;
+
+RoomTransformTable room_transforms;  // Written by gameUpdateRoomTransforms
+RoomImpostors      room_impostors;
+
+// The line of entities pushed by gameMoveEntitiesOnGrid, one move per entity
+std::vector<GridMove> grid_moves;
+
+// Written by the camera & dir light systems, read back by gameUpdate
+int   frame_cam_handle       = -1;
+int   frame_dir_light_handle = -1;
+float frame_time             = 0.0f;
 
 // Function Definitions //
 
 static int
 gameMoveEntitiesOnGrid(RoomGrid& grid, Vec3F cur_grid_pos, Vec3F new_grid_pos)
 {
-    // Recursive function
-    // Returns 1 on success, 0 on failure
+    // Moves the entity at cur_grid_pos to new_grid_pos, pushing the line in front of it.
+    // Clones are unshared along the lines movers may push before the systems run, see
+    // gameUnshareMoveLines. A line reaching a brick still shared, e.g. moved into reach
+    // by an earlier push this frame, waits for the next frame.
+    // Returns 1 on success, 0 on failure (nothing is moved)
+    return roomGridMoveEntities(grid, *active_entities_p, roomgrid_lookup, cur_grid_pos, new_grid_pos, grid_moves);
+}
 
-    // Check that target position is not current position
-    if(new_grid_pos == cur_grid_pos)
-    {
-	return 0;
-    }
-    
-    // Check that target position is valid (within the grid)
-    if(new_grid_pos.x < 0.0f || new_grid_pos.x >= RG_MAX_WIDTH ||
-       new_grid_pos.y < 0.0f || new_grid_pos.y >= RG_MAX_HEIGHT ||
-       new_grid_pos.z < 0.0f || new_grid_pos.z >= RG_MAX_LENGTH)
+static void
+gameUnshareMoveLine(uint i, Vec3F move_dir)
+{
+    // Gives the clones on the line entity i would push along move_dir their own bricks
+    int roomgrid_id = active_entities_p->roomgrid_owner_ids[i];
+    if(roomgrid_id < 0) {return;}
+    RoomGrid& grid = *roomgrid_lookup.roomgrid_pointers[roomgrid_id];
+    Vec3F cur_grid_pos = vec3FColumnsGet(active_entities_p->grid_positions, i);
+    if(!roomGridGetPushLine(grid, *active_entities_p, roomgrid_lookup, cur_grid_pos, cur_grid_pos + move_dir, grid_moves))
     {
-	return 0;
+	return;
     }
-    
-    // Get entity ID for moving later. If -1, this call is invalid and should fail. 
-    int entity_id = grid.grid[(int)cur_grid_pos.x][(int)cur_grid_pos.y][(int)cur_grid_pos.z];
-    if(entity_id <= -1) {return 0;}
-    
-    // Check neighbor and set entity destination accordingly
-    int neighbor_id = grid.grid[(int)new_grid_pos.x][(int)new_grid_pos.y][(int)new_grid_pos.z];
-    if(neighbor_id > -1 && !active_entities_p->states[neighbor_id].inactive) // will early out if ID is invalid
+    for(uint k = 0; k < grid_moves.size(); k++)
     {
-	// If target destination contains entity with collision, move fails
-	uint neighbor_type = active_entities_p->types[neighbor_id];
-	if(active_entities_p->entity_templates.table[neighbor_type][COMPONENT_COLLISION])
+	if(!roomGridPrepareWrite(*grid_moves[k].from_p, *active_entities_p, roomgrid_lookup, grid_moves[k].from) ||
+	   !roomGridPrepareWrite(*grid_moves[k].to_p, *active_entities_p, roomgrid_lookup, grid_moves[k].to))
 	{
-	    return 0;
-	}
-
-	// If target destination contains a pushable entity, try to push it.
-	// If push fails, move fails. 
-	if(active_entities_p->entity_templates.table[neighbor_type][COMPONENT_PUSHABLE])
-	{
-	    Vec3F move_dir       = new_grid_pos - cur_grid_pos;
-	    Vec3F n_cur_grid_pos = active_entities_p->grid_positions[neighbor_id].position;
-	    Vec3F n_new_grid_pos = n_cur_grid_pos + move_dir;
-	    if(!gameMoveEntitiesOnGrid(grid, n_cur_grid_pos, n_new_grid_pos)) {return 0;}
+	    return;
 	}
     }
-
-    // If none of the fail conditions were met, safe to move the entity
-    roomGridRemoveEntity(grid, cur_grid_pos);
-    roomGridSetEntity(grid, new_grid_pos, entity_id);
-    active_entities_p->grid_positions[entity_id].position = new_grid_pos;
-
-    return 1;
 }
 
 static void
@@ -105,218 +99,341 @@ gameInit(uint width, uint height)
     gameUpdateInputs();
 }
 
-static void
-gameUpdatePlayer(int i)
+static Vec3F
+gameGetInputMoveDir()
+{
+    // Grid step of the arrow key held last frame, zero if none
+    if(input_manager.inputs_on_frame[FRAME_1_PRIOR][KEY_ARROW_DOWN] == KEY_DOWN)
+    {
+	return Vec3F(0.0f, 0.0f, 1.0f);
+    }
+    if(input_manager.inputs_on_frame[FRAME_1_PRIOR][KEY_ARROW_UP] == KEY_DOWN)
+    {
+	return Vec3F(0.0f, 0.0f, -1.0f);
+    }
+    if(input_manager.inputs_on_frame[FRAME_1_PRIOR][KEY_ARROW_LEFT] == KEY_DOWN)
+    {
+	return Vec3F(-1.0f, 0.0f, 0.0f);
+    }
+    if(input_manager.inputs_on_frame[FRAME_1_PRIOR][KEY_ARROW_RIGHT] == KEY_DOWN)
+    {
+	return Vec3F(1.0f, 0.0f, 0.0f);
+    }
+    return Vec3F(0.0f, 0.0f, 0.0f);
+}
+
+static uint
+gameUpdatePlayer(uint i)
 {
     // Current and target positions
-    Vec3F cur_grid_pos = active_entities_p->grid_positions[i].position;
+    Vec3F cur_grid_pos = vec3FColumnsGet(active_entities_p->grid_positions, i);
     Vec3F new_grid_pos = cur_grid_pos;
 
     // Set target position based on input
     if(active_entities_p->states[i].input_cooldown == 0)
     {
-	// Down
-	if(input_manager.inputs_on_frame[FRAME_1_PRIOR][KEY_ARROW_DOWN] == KEY_DOWN)
-	{
-	    new_grid_pos = Vec3F(cur_grid_pos.x,
-				 cur_grid_pos.y,
-				 cur_grid_pos.z + 1);
-	    active_entities_p->states[i].input_cooldown = INPUT_COOLDOWN_DUR;
-	}
-	// Up
-	else if(input_manager.inputs_on_frame[FRAME_1_PRIOR][KEY_ARROW_UP] == KEY_DOWN)
-	{
-	    new_grid_pos = Vec3F(cur_grid_pos.x,
-				 cur_grid_pos.y,
-				 cur_grid_pos.z - 1);
-	    active_entities_p->states[i].input_cooldown = INPUT_COOLDOWN_DUR;
-	}
-	// Left
-	else if(input_manager.inputs_on_frame[FRAME_1_PRIOR][KEY_ARROW_LEFT] == KEY_DOWN)
-	{
-	    new_grid_pos = Vec3F(cur_grid_pos.x - 1,
-				 cur_grid_pos.y,
-				 cur_grid_pos.z);
-	    active_entities_p->states[i].input_cooldown = INPUT_COOLDOWN_DUR;
-	}
-	// Right
-	else if(input_manager.inputs_on_frame[FRAME_1_PRIOR][KEY_ARROW_RIGHT] == KEY_DOWN)
-	{
-	    new_grid_pos = Vec3F(cur_grid_pos.x + 1,
-				 cur_grid_pos.y,
-				 cur_grid_pos.z);
-	    active_entities_p->states[i].input_cooldown = INPUT_COOLDOWN_DUR;
-	}
+	new_grid_pos = cur_grid_pos + gameGetInputMoveDir();
+	if(!(new_grid_pos == cur_grid_pos)) {active_entities_p->states[i].input_cooldown = INPUT_COOLDOWN_DUR;}
     }
 
     // Attempt to move player and subsequent entities based on target
-    int roomgrid_id = active_entities_p->grid_positions[i].roomgrid_owner_id;
+    int roomgrid_id = active_entities_p->roomgrid_owner_ids[i];
     if(roomgrid_id > -1)
     {
 	RoomGrid* grid_p = roomgrid_lookup.roomgrid_pointers[roomgrid_id];
-	gameMoveEntitiesOnGrid(*grid_p, cur_grid_pos, new_grid_pos);
+	return gameMoveEntitiesOnGrid(*grid_p, cur_grid_pos, new_grid_pos);
     }
+    return 0;
 }
 
-static void
-gameUpdateAI(int i)
+static uint
+gameUpdateAI(uint i)
 {
+    AI* ai_p = (AI*)activeEntitiesGetComponentP(*active_entities_p, i, COMPONENT_AI);
+
     // If walk, then walk
-    if(active_entities_p->ai[i].next_move == MOVE_WALK)
+    if(ai_p->next_move == MOVE_WALK)
     {
-	int new_x = (rand() % 3) - 1; // x will be -1, 0 or 1
-	int new_z = ((rand() % 3) - 1) * (new_x == 0);
+	int new_x = (int)(aiRandom(*ai_p, active_entities_p->handles[i]) % 3) - 1; // x will be -1, 0 or 1
+	int new_z = ((int)(aiRandom(*ai_p, active_entities_p->handles[i]) % 3) - 1) * (new_x == 0);
 	Vec3F move_dir = Vec3F((float)new_x, 0.0f, (float)new_z);
-	Vec3F cur_pos = active_entities_p->grid_positions[i].position;
+	Vec3F cur_pos = vec3FColumnsGet(active_entities_p->grid_positions, i);
 
 	// Assumes Entity with AI component ALSO has a GridPosition component
-	int roomgrid_id = active_entities_p->grid_positions[i].roomgrid_owner_id;
+	int roomgrid_id = active_entities_p->roomgrid_owner_ids[i];
 	if(roomgrid_id > -1)
 	{
 	    RoomGrid* grid_p = roomgrid_lookup.roomgrid_pointers[roomgrid_id];
-	    gameMoveEntitiesOnGrid(*grid_p, cur_pos, cur_pos + move_dir);
+	    return gameMoveEntitiesOnGrid(*grid_p, cur_pos, cur_pos + move_dir);
 	}
     }
+    return 0;
 }
 
 static void
-gameUpdateStates(int i)
+gameUnshareMoveLines()
 {
+    // Clone bricks are unshared here, before the systems run, along every line a mover
+    // may push this frame, so the Player & AI systems write only bricks of their own.
+    // Players push along the held arrow key, AI may walk any of four ways.
+    const Vec3F walk_dirs[4] = {Vec3F(1.0f, 0.0f, 0.0f), Vec3F(-1.0f, 0.0f, 0.0f),
+				Vec3F(0.0f, 0.0f, 1.0f), Vec3F(0.0f, 0.0f, -1.0f)};
+    Vec3F input_dir = gameGetInputMoveDir();
+    if(!(input_dir == Vec3F(0.0f, 0.0f, 0.0f)))
+    {
+	const EntityQuery& players = active_entities_p->queries[QUERY_PLAYER];
+	for(uint k = 0; k < players.count; k++) {gameUnshareMoveLine(players.ids[k], input_dir);}
+    }
+    const EntityQuery& ais = active_entities_p->queries[QUERY_AI];
+    for(uint k = 0; k < ais.count; k++)
+    {
+	for(uint d = 0; d < 4; d++) {gameUnshareMoveLine(ais.ids[k], walk_dirs[d]);}
+    }
+}
+
+static uint
+gameUpdateStates(uint i)
+{
+    if(active_entities_p->states[i].input_cooldown == 0) {return 0;}
     active_entities_p->states[i].input_cooldown -= 1;
     active_entities_p->states[i].input_cooldown = (int)clamp((float)active_entities_p->states[i].input_cooldown,
 							     0, INPUT_COOLDOWN_DUR);
+    return 1;
+}
+
+static Vec3F
+gameGetRoomOriginOffset(const RoomGrid& rg_owner, const RoomGrid& rg)
+{
+    // Offset from the centre of the owner's cell holding rg to the centre of rg's cell 0
+    return ((Vec3F(-0.5f, -0.5f, -0.5f) * rg_owner.current_scale) +
+	    (Vec3F(0.5f, 0.5f, 0.5f) * rg.current_scale));
+}
+
+static Vec3F
+gameGetRoomHolderPos(const RoomGrid& rg)
+{
+    // Cell of the owning RoomGrid holding rg
+    int holder_id = activeEntitiesGetID(*active_entities_p, rg.owner_entity_handle);
+    if(holder_id < 0) {return Vec3F(0.0f, 0.0f, 0.0f);}
+    return vec3FColumnsGet(active_entities_p->grid_positions, holder_id);
+}
+
+static uint
+gameGetRoomDepth(RoomTransformTable& table, uint id)
+{
+    // Nesting depth of a RoomGrid, memoized in table.depths (UINT_MAX if unknown)
+    if(table.depths[id] != UINT_MAX) {return table.depths[id];}
+    int owner_id = roomgrid_lookup.roomgrid_pointers[id]->roomgrid_owner_id;
+    uint depth = (owner_id > -1) ? gameGetRoomDepth(table, (uint)owner_id) + 1 : 0;
+    table.depths[id] = depth;
+    return depth;
 }
 
 static void
-gameUpdateTransforms(int i)
+gameUpdateRoomTransforms()
 {
-    int rg_id = active_entities_p->grid_positions[i].roomgrid_owner_id; // Should rename to roomgrid_id
-    if(rg_id > -1)
+    // Computes each RoomGrid's transform matrix relative to the viewed RoomGrid, which
+    // sits at the origin, so positions near the camera keep full float precision however
+    // deep the nesting is. The viewed RoomGrid's owners are placed walking outward, then
+    // every other RoomGrid is placed in its owner's cell one depth level at a time. A
+    // level reads only the level above it, so its RoomGrids can be split across workers.
+    // A RoomGrid's contents are flagged for recomputing when its matrix changes.
+    RoomTransformTable& table = room_transforms;
+    uint room_total = (uint)roomgrid_lookup.roomgrid_pointers.size();
+    table.depths.assign(room_total, UINT_MAX);
+    table.placed.assign(room_total, 0);
+    table.bases.resize(room_total);
+    std::vector<Vec3F>& bases = table.bases;
+
+    // Counting sort of the RoomGrids by depth
+    uint level_count = 0;
+    for(uint id = 0; id < room_total; id++)
     {
-	RoomGrid* rg_p = roomgrid_lookup.roomgrid_pointers[rg_id];
-	// Update scale
-	active_entities_p->transforms[i].scale = Vec3F(rg_p->current_scale,
-						       rg_p->current_scale,
-						       rg_p->current_scale);
-	
-	// Update position
-	if(rg_p->roomgrid_owner_id > -1)
+	if(!roomgrid_lookup.roomgrid_pointers[id]) {continue;}
+	level_count = std::max(level_count, gameGetRoomDepth(table, id) + 1);
+    }
+    table.level_starts.assign(level_count + 1, 0);
+    for(uint id = 0; id < room_total; id++)
+    {
+	if(roomgrid_lookup.roomgrid_pointers[id]) {table.level_starts[table.depths[id] + 1]++;}
+    }
+    for(uint level = 0; level < level_count; level++)
+    {
+	table.level_starts[level + 1] += table.level_starts[level];
+    }
+    table.order.resize(table.level_starts[level_count]);
+    std::vector<uint> level_next(table.level_starts.begin(), table.level_starts.end() - 1);
+    for(uint id = 0; id < room_total; id++)
+    {
+	if(roomgrid_lookup.roomgrid_pointers[id]) {table.order[level_next[table.depths[id]]++] = id;}
+    }
+
+    // The viewed RoomGrid, offset by the zoom animation
+    RoomGrid* view_rg_p = rg_transition_status.current_roomgrid_p;
+    Vec3F view_base = vlerp(rg_transition_status.anim_offset, Vec3F(0.0f, 0.0f, 0.0f),
+			    rg_transition_status.t);
+    if(view_rg_p->roomgrid_owner_id > -1)
+    {
+	view_base = view_base + Vec3F(0.5f, 0.5f, 0.5f) * view_rg_p->current_scale;
+    }
+    bases[view_rg_p->roomgrid_id] = view_base;
+    table.placed[view_rg_p->roomgrid_id] = 1;
+
+    // Its owners, outward
+    RoomGrid* rg_p = view_rg_p;
+    while(rg_p->roomgrid_owner_id > -1)
+    {
+	RoomGrid* rg_owner_p = roomgrid_lookup.roomgrid_pointers[rg_p->roomgrid_owner_id];
+	bases[rg_owner_p->roomgrid_id] = (bases[rg_p->roomgrid_id] -
+					  gameGetRoomOriginOffset(*rg_owner_p, *rg_p) -
+					  gameGetRoomHolderPos(*rg_p) * rg_owner_p->current_scale);
+	table.placed[rg_owner_p->roomgrid_id] = 1;
+	rg_p = rg_owner_p;
+    }
+    Vec3F root_base = bases[rg_p->roomgrid_id];
+
+    // Everything else, inward by level
+    for(uint level = 0; level < level_count; level++)
+    {
+	for(uint r = table.level_starts[level]; r < table.level_starts[level + 1]; r++)
+	{
+	    uint id = table.order[r];
+	    if(table.placed[id]) {continue;}
+	    RoomGrid* room_p = roomgrid_lookup.roomgrid_pointers[id];
+	    if(room_p->roomgrid_owner_id > -1)
+	    {
+		RoomGrid* rg_owner_p = roomgrid_lookup.roomgrid_pointers[room_p->roomgrid_owner_id];
+		bases[id] = (bases[rg_owner_p->roomgrid_id] +
+			     gameGetRoomHolderPos(*room_p) * rg_owner_p->current_scale +
+			     gameGetRoomOriginOffset(*rg_owner_p, *room_p));
+	    }
+	    else {bases[id] = root_base;} // Other roots share the viewed tree's origin
+	    table.placed[id] = 1;
+	}
+    }
+
+    // Cache each RoomGrid's matrix & flatten it for the transform loop
+    table.scales.resize(room_total + 1);
+    table.bases_x.resize(room_total + 1);
+    table.bases_y.resize(room_total + 1);
+    table.bases_z.resize(room_total + 1);
+    table.dirty.resize(room_total + 1);
+    table.dirty[0] = 0;
+    for(uint id = 0; id < room_total; id++)
+    {
+	RoomGrid* room_p = roomgrid_lookup.roomgrid_pointers[id];
+	if(!room_p)
 	{
-	    // Update current pos
-	    RoomGrid* rg_owner_p = roomgrid_lookup.roomgrid_pointers[rg_p->roomgrid_owner_id];
-	    Vec3F origin_offset = ((Vec3F(-0.5f, -0.5f, -0.5f) * rg_owner_p->current_scale) +
-				   (Vec3F(0.5f, 0.5f, 0.5f) * rg_p->current_scale));
-	    active_entities_p->transforms[i].position = (active_entities_p->grid_positions[i].position *
-							  rg_p->current_scale) + origin_offset;
-	    active_entities_p->transforms[i].position = (active_entities_p->transforms[i].position +
-							 rg_owner_p->transform_pos);
-
-	    // Update target pos for use in calculating depth offset
-	    Vec3F target_origin_offset = ((Vec3F(-0.5f, -0.5f, -0.5f) * rg_owner_p->target_scale) +
-					  (Vec3F(0.5f, 0.5f, 0.5f) * rg_p->target_scale));
-	    rg_p->target_transform_pos = (active_entities_p->grid_positions[i].position *
-					  rg_p->target_scale) + origin_offset;
-	    rg_p->target_transform_pos = (rg_p->target_transform_pos +
-					  rg_owner_p->target_transform_pos);
+	    table.dirty[id + 1] = 0;
+	    continue;
 	}
-	else
+	// Templates are never drawn, their clones draw the shared cells from their own base
+	if(room_p->is_template)
 	{
-	    active_entities_p->transforms[i].position = (active_entities_p->grid_positions[i].position *
-							 rg_p->current_scale);
-	    rg_p->target_transform_pos = (active_entities_p->grid_positions[i].position *
-							 rg_p->target_scale);
+	    table.dirty[id + 1] = -1;
+	    continue;
 	}
-	rg_p->transform_pos = active_entities_p->transforms[i].position;
+	room_p->dirty = (room_p->dirty ||
+			 room_p->current_scale != room_p->transform_scale ||
+			 !(bases[id] == room_p->transform_base));
+	room_p->transform_base  = bases[id];
+	room_p->transform_scale = room_p->current_scale;
+	if(room_p->dirty)
+	{
+	    float scale = room_p->current_scale;
+	    room_p->transform_matrix = getModelMat(Vec3F(scale, scale, scale), bases[id]);
+	}
+	
+	table.scales[id + 1]  = room_p->current_scale;
+	table.bases_x[id + 1] = bases[id].x;
+	table.bases_y[id + 1] = bases[id].y;
+	table.bases_z[id + 1] = bases[id].z;
+	table.dirty[id + 1]   = room_p->dirty;
+	room_p->dirty = false;
     }
 }
 
-static void
-gameUpdateDepthOffsets()
+static uint
+gameUpdateTransforms(uint i)
 {
-    Vec3F current_pos;
-    Vec3F current_offset;
-    
-    int current_rg_owner_id = rg_transition_status.current_roomgrid_p->roomgrid_owner_id;
-
-    // Current_offset - Distance from the origin after scaling, apply to all transforms
-    if(current_rg_owner_id > -1)
-    {
-	RoomGrid* current_rg_owner_p = roomgrid_lookup.roomgrid_pointers[current_rg_owner_id];  
-        current_pos = (current_rg_owner_p->transform_pos + 
-		       (Vec3F(-0.5f, -0.5f, -0.5f) *
-			current_rg_owner_p->current_scale));
-    }
-    else {current_pos = Vec3F(0.0f, 0.0f, 0.0f);}
-    current_offset = BASE_RG_ORIGIN - current_pos;
-
-    rg_transition_status.apply_offset = (current_offset +
-					 vlerp(rg_transition_status.anim_offset,
-					       Vec3F(0.0f, 0.0f, 0.0f),
-					       rg_transition_status.t));
+    return roomTransformTableUpdateEntity(room_transforms, *active_entities_p, i);
 }
 
-static void
-gameApplyDepthOffsetToTransforms(int i)
+#if AVX2_KERNELS
+static uint
+gameUpdateTransformsRange(uint begin_ID, uint end_ID)
 {
-    active_entities_p->transforms[i].position = (active_entities_p->transforms[i].position +
-						 rg_transition_status.apply_offset);
+    // Only registered if cpuHasAVX2
+    return roomTransformTableUpdateRange(room_transforms, *active_entities_p, begin_ID, end_ID);
 }
+#endif
 
-static void
-gameUpdateCameras(int i, int& cam_id)
+static uint
+gameUpdateCameras(uint i)
 {
+    Camera* cam_p = (Camera*)activeEntitiesGetComponentP(*active_entities_p, i, COMPONENT_CAMERA);
+
     // Update dir from transform
-    active_entities_p->cameras[i].dir = (active_entities_p->cameras[i].target -
-					 active_entities_p->transforms[i].position);
+    Vec3F position = vec3FColumnsGet(active_entities_p->transform_positions, i);
+    cam_p->dir = (cam_p->target - position);
 
-    Vec3F zaxis = normalize(active_entities_p->cameras[i].dir);
+    Vec3F zaxis = normalize(cam_p->dir);
     Vec3F xaxis = normalize(cross(zaxis, Vec3F(0.0f, 1.0f, 0.0f)));
     Vec3F yaxis = cross(xaxis, zaxis);
 
     if(input_manager.inputs_on_frame[FRAME_1_PRIOR][KEY_D] == KEY_DOWN)
     {
-	active_entities_p->transforms[i].position += xaxis; 
+	position += xaxis; 
     }
     if(input_manager.inputs_on_frame[FRAME_1_PRIOR][KEY_A] == KEY_DOWN)
     {
-	active_entities_p->transforms[i].position -= xaxis; 
+	position -= xaxis; 
     }
     if(input_manager.inputs_on_frame[FRAME_1_PRIOR][KEY_W] == KEY_DOWN)
     {
-	active_entities_p->transforms[i].position += yaxis; 
+	position += yaxis; 
     }
     if(input_manager.inputs_on_frame[FRAME_1_PRIOR][KEY_S] == KEY_DOWN)
     {
-	active_entities_p->transforms[i].position -= yaxis; 
+	position -= yaxis; 
     }
+    vec3FColumnsSet(active_entities_p->transform_positions, i, position);
     
     // Set ID to Render Camera
-    if(active_entities_p->cameras[i].is_selected) { cam_id = i; }
+    if(cam_p->is_selected) { frame_cam_handle = active_entities_p->handles[i]; }
+    return 1;
 }
 
 static uint
-gameUpdateDirLights(float time, int i)
+gameUpdateDirLights(uint i)
 {
+    DirLight* dir_light_p = (DirLight*)activeEntitiesGetComponentP(*active_entities_p, i, COMPONENT_DIR_LIGHT);
+
     // Update Position & Direction
-    Vec3F offset = active_entities_p->dir_lights[i].offset;
-    float rotate_speed = active_entities_p->dir_lights[i].speed;
+    Vec3F offset = dir_light_p->offset;
+    float rotate_speed = dir_light_p->speed;
 
     if(rotate_speed)
     {
-	active_entities_p->transforms[i].position = (active_entities_p->dir_lights[i].target +
-						     Vec3F(offset.x * sin(time),
-							   offset.y,
-							   offset.z * cos(time)));
-	active_entities_p->dir_lights[i].dir = (active_entities_p->dir_lights[i].target -
-						active_entities_p->transforms[i].position);
-    }
-    return i;
+	Vec3F position = (dir_light_p->target +
+			  Vec3F(offset.x * sin(frame_time),
+				offset.y,
+				offset.z * cos(frame_time)));
+	vec3FColumnsSet(active_entities_p->transform_positions, i, position);
+	dir_light_p->dir = (dir_light_p->target - position);
+    }
+    frame_dir_light_handle = active_entities_p->handles[i];
+    return 1;
 }
 
-static void
-gameUpdateRoomGrids(int i)
+static uint
+gameUpdateRoomGrids(uint i)
 {
-    RoomGrid* rg_p = roomgrid_lookup.roomgrid_pointers[active_entities_p->roomgrid_ids[i]];
+    // References show a RoomGrid updated through its owner
+    int rg_id = active_entities_p->roomgrid_ids[i];
+    if(rg_id < 0) {return 1;}
+    RoomGrid* rg_p = roomgrid_lookup.roomgrid_pointers[rg_id];
+    if(!rg_p || rg_p->owner_entity_handle != active_entities_p->handles[i]) {return 1;}
 
     // If we have the root roomgrid
     if(rg_p->roomgrid_owner_id == -1)
@@ -345,13 +462,14 @@ gameUpdateRoomGrids(int i)
 		int child_br_id = roomGridGetFirstIDByType(rg_transition_status.current_roomgrid_p,
 							   active_entities_p,
 							   BLOCK_ROOM);
-		if(child_br_id > -1)
+		int child_rg_id = (child_br_id > -1) ? active_entities_p->roomgrid_ids[child_br_id] : -1;
+		RoomGrid* child_rg_p = (child_rg_id > -1) ? roomgrid_lookup.roomgrid_pointers[child_rg_id] : NULL;
+		// Only owned RoomGrids are entered, a reference's RoomGrid is placed elsewhere
+		if(child_rg_p && child_rg_p->owner_entity_handle == active_entities_p->handles[child_br_id])
 		{
-		    int child_rg_id = active_entities_p->roomgrid_ids[child_br_id];
-		    RoomGrid* child_rg_p = roomgrid_lookup.roomgrid_pointers[child_rg_id];
 		    rg_transition_status.current_roomgrid_p = child_rg_p;
 
-		    rg_p->target_scale *= RG_MAX_WIDTH;
+		    rg_p->target_scale *= roomGridGetSpan(*child_rg_p);
 		    rg_p->t = 0.0f;
 		    rg_p->cooldown = 10;
 
@@ -368,10 +486,12 @@ gameUpdateRoomGrids(int i)
 	    {
 		if(rg_transition_status.current_roomgrid_p->roomgrid_owner_id > -1)
 		{
-		    int parent_rg_id = rg_transition_status.current_roomgrid_p->roomgrid_owner_id;
+		    RoomGrid* child_rg_p = rg_transition_status.current_roomgrid_p;
+		    int parent_rg_id = child_rg_p->roomgrid_owner_id;
+		    float child_span = roomGridGetSpan(*child_rg_p);
 		    rg_transition_status.current_roomgrid_p = roomgrid_lookup.roomgrid_pointers[parent_rg_id];
 		    
-		    rg_p->target_scale /= RG_MAX_WIDTH;
+		    rg_p->target_scale /= child_span;
 		    rg_p->t = 0.0f;
 		    rg_p->cooldown = 10;
 
@@ -379,11 +499,10 @@ gameUpdateRoomGrids(int i)
 		    rg_transition_status.update_anim_offset = true;
 		    rg_transition_status.is_complete = false;
 		    
-		    int child_br_id = roomGridGetFirstIDByType(rg_transition_status.current_roomgrid_p,
-							       active_entities_p,
-							       BLOCK_ROOM);
-		    rg_transition_status.anim_offset = (-1.0f * RG_MAX_WIDTH *
-							 active_entities_p->grid_positions[child_br_id].position);
+		    // The owner of the RoomGrid left, other BLOCK_ROOMs may only reference it
+		    int child_br_id = activeEntitiesGetID(*active_entities_p, child_rg_p->owner_entity_handle);
+		    rg_transition_status.anim_offset = (-1.0f * child_span *
+							 vec3FColumnsGet(active_entities_p->grid_positions, child_br_id));
 		}
 	    }
 	}
@@ -391,101 +510,106 @@ gameUpdateRoomGrids(int i)
     else
     {
 	RoomGrid* rg_owner_p = roomgrid_lookup.roomgrid_pointers[rg_p->roomgrid_owner_id]; 
-	rg_p->current_scale = rg_owner_p->current_scale / RG_MAX_WIDTH;
-	rg_p->target_scale = rg_owner_p->target_scale / RG_MAX_WIDTH;
+	rg_p->current_scale = rg_owner_p->current_scale / roomGridGetSpan(*rg_p);
+	rg_p->target_scale = rg_owner_p->target_scale / roomGridGetSpan(*rg_p);
 	rg_p->t = rg_owner_p->t;
 	rg_p->cooldown = rg_owner_p->cooldown;
     }
 
-    rg_p->grid_pos = active_entities_p->grid_positions[i].position;
+    rg_p->grid_pos = vec3FColumnsGet(active_entities_p->grid_positions, i);
+    return 1;
 }
 
 static void
 gameUpdateRoomGridTransition()
 {
+    // The viewed RoomGrid keeps its owner, so the player & the RoomGrids around it stay
+    // alive and the view can zoom back out. gameUpdateRoomTransforms places it at the
+    // origin whatever its depth.
     if(rg_transition_status.is_complete == false && rg_transition_status.t == 1.0f)
     {
-	roomGridRemoveOwner(*rg_transition_status.current_roomgrid_p,
-			    *active_entities_p);
         rg_transition_status.is_complete = true;
     }
 }
 
+static void
+gameRegisterSystems()
+{
+    // Systems are registered in the serial update order. Reads & writes declare the
+    // component data each system touches. RoomGrid data & rg_transition_status are
+    // covered by COMPONENT_ROOM_GRID.
+    uint transform     = componentMask(COMPONENT_TRANSFORM);
+    uint camera        = componentMask(COMPONENT_CAMERA);
+    uint dir_light     = componentMask(COMPONENT_DIR_LIGHT);
+    uint grid_position = componentMask(COMPONENT_GRID_POSITION);
+    uint state         = componentMask(COMPONENT_STATE);
+    uint ai            = componentMask(COMPONENT_AI);
+    uint room_grid     = componentMask(COMPONENT_ROOM_GRID);
+    
+    int states_system = schedulerRegisterSystem(system_scheduler, "States", NULL, gameUpdateStates,
+						QUERY_STATE, state, state, true, 256);
+    schedulerSetSystemBitset(system_scheduler, states_system, BITSET_LIVE);
+    // Moves on the grid also move & read the state of the entities pushed
+    schedulerRegisterSystem(system_scheduler, "Player", NULL, gameUpdatePlayer,
+			    QUERY_PLAYER, state | grid_position | room_grid,
+			    state | grid_position | room_grid, false, 0);
+    // The AI component holds each entity's RNG state
+    schedulerRegisterSystem(system_scheduler, "AI", NULL, gameUpdateAI,
+			    QUERY_AI, ai | state | grid_position | room_grid,
+			    ai | grid_position | room_grid, false, 0);
+    // Child roomgrids read their owner's, so entities are updated in creation order
+    schedulerRegisterSystem(system_scheduler, "RoomGrids", NULL, gameUpdateRoomGrids,
+			    QUERY_ROOM_GRID, grid_position | room_grid, room_grid, false, 0);
+    // RoomGrids are placed before their contents, so entities can be updated in any order
+    int transforms_system = schedulerRegisterSystem(system_scheduler, "Transforms",
+						    gameUpdateRoomTransforms, gameUpdateTransforms,
+						    QUERY_GRID_POSITION, grid_position | room_grid,
+						    transform | grid_position | room_grid, false, 256);
+    schedulerSetSystemBitset(system_scheduler, transforms_system, BITSET_GRID_POSITION);
+#if AVX2_KERNELS
+    // Otherwise the Transforms system updates one entity at a time
+    if(cpuHasAVX2()) {schedulerSetSystemRange(system_scheduler, transforms_system, gameUpdateTransformsRange);}
+#endif
+    schedulerRegisterSystem(system_scheduler, "Cameras", NULL, gameUpdateCameras,
+			    QUERY_CAMERA, camera | transform, camera | transform, true, 0);
+    schedulerRegisterSystem(system_scheduler, "DirLights", NULL, gameUpdateDirLights,
+			    QUERY_DIR_LIGHT, dir_light | transform, dir_light | transform, true, 0);
+    
+    schedulerBuild(system_scheduler, *active_entities_p);
+}
+
 static int
 gameUpdate(SoundStream* sound_stream_p,
-	       int& cam_id,
-	       int& dir_light_id)
+	       int& cam_handle,
+	       int& dir_light_handle)
 {
     // Update //
-    
-    for(uint i = 0; i < active_entities_p->count; i++)
-    {
-	if(!active_entities_p->states[i].inactive)
-	{
-	    if(active_entities_p->entity_templates.table[active_entities_p->types[i]][COMPONENT_STATE])
-	    {
-		// Update State
-		gameUpdateStates(i);
-	    }
-
-	    if(active_entities_p->entity_templates.table[active_entities_p->types[i]][COMPONENT_PLAYER])
-	    {
-		// Update Player
-		gameUpdatePlayer(i);
-	    }
-
-	    if(active_entities_p->entity_templates.table[active_entities_p->types[i]][COMPONENT_AI])
-	    {
-		// Update AI
-		gameUpdateAI(i);
-	    }
-	    
-	    if(active_entities_p->entity_templates.table[active_entities_p->types[i]][COMPONENT_ROOM_GRID])
-	    {
-		// Update RoomGrids
-		gameUpdateRoomGrids(i);
-	    }
-
-	    if(active_entities_p->entity_templates.table[active_entities_p->types[i]][COMPONENT_GRID_POSITION])
-	    {
-		// Update Transforms
-		gameUpdateTransforms(i);
-	    }
-	    
-	    if(active_entities_p->entity_templates.table[active_entities_p->types[i]][COMPONENT_CAMERA])
-	    {
-		// Update Camera
-		gameUpdateCameras(i, cam_id);
-	    }
-
-	    if(active_entities_p->entity_templates.table[active_entities_p->types[i]][COMPONENT_DIR_LIGHT])
-	    {
-		// Update DirLight
-		dir_light_id = gameUpdateDirLights((float)platformGetTime(), i);
-	    }
-	}	
-    }
 
-    gameUpdateDepthOffsets();
-    
-    for(uint j = 0; j < active_entities_p->count; j++)
-    {
-	if(!active_entities_p->states[j].inactive)
-	{
-	    if(active_entities_p->entity_templates.table[active_entities_p->types[j]][COMPONENT_GRID_POSITION])
-	    {
-		// 2nd Pass to Offset Transforms
-		gameApplyDepthOffsetToTransforms(j);
-	    }
-	}
-    }
+    // Run the systems registered in gameRegisterSystems
+    frame_time = (float)platformGetTime();
+    frame_cam_handle = cam_handle;
+    frame_dir_light_handle = dir_light_handle;
+    gameUnshareMoveLines();
+    schedulerRun(system_scheduler, *active_entities_p);
+    cam_handle = frame_cam_handle;
+    dir_light_handle = frame_dir_light_handle;
 
     gameUpdateRoomGridTransition();
     soundStreamUpdate(sound_stream_p);
+
+    // Apply the structural changes recorded this frame
+    activeEntitiesPublishCreated(*active_entities_p, roomgrid_lookup);
+    entityCommandBufferPlayback(entity_command_buffer, *active_entities_p, roomgrid_lookup);
         
     // Remove Inactive Entities - Must be run after all other entity updates
     activeEntitiesRemoveInactives(*active_entities_p, roomgrid_lookup);
 
+    // Group each RoomGrid's entities while no transition is animating
+    if(rg_transition_status.is_complete)
+    {
+	activeEntitiesDefragment(*active_entities_p, ENTITY_DEFRAG_SWAPS);
+    }
+
     return 1;
 }
 
@@ -495,15 +619,25 @@ gameRender(FrameTexture* depth_ftexture_p,
 	       FrameTexture* ftexture_non_msaa_p,
 	       const RoomGridLookup& roomgrid_lookup,
 	       DebugGrid* grid_p,
-	       uint cam_id,
-	       uint dir_light_id)
+	       int cam_handle,
+	       int dir_light_handle)
 {
     Profiler p;
     p.start_time = platformGetTime();
+    // Resolve handles after the frame's removals
+    uint cam_id       = activeEntitiesGetID(*active_entities_p, cam_handle);
+    uint dir_light_id = activeEntitiesGetID(*active_entities_p, dir_light_handle);
+    // Pick the RoomGrids drawn as impostors, shared by both passes
+    platformUpdateRoomImpostors(room_impostors,
+				*active_entities_p,
+				roomgrid_lookup,
+				asset_manager,
+				*ftexture_msaa_p);
     // Render Pass 1 - Shadow Map
     platformRenderShadowMapToBuffer(*active_entities_p,
 				    *depth_ftexture_p,
 				    roomgrid_lookup,
+				    room_impostors,
 				    asset_manager,
 				    game_window,
 				    dir_light_id);
@@ -513,16 +647,18 @@ gameRender(FrameTexture* depth_ftexture_p,
 				   *ftexture_msaa_p,
 				   *depth_ftexture_p,
 				   roomgrid_lookup,
+				   room_impostors,
 				   game_window,
 				   asset_manager,
 				   dir_light_id,
 				   cam_id);
 
     // Render Pass 3 - Debug 
+    Camera* cam_p = (Camera*)activeEntitiesGetComponentP(*active_entities_p, cam_id, COMPONENT_CAMERA);
     platformRenderDebugElementsToBuffer(game_window,
 					asset_manager,
-					active_entities_p->transforms[cam_id].position,
-				        active_entities_p->cameras[cam_id].target,
+					vec3FColumnsGet(active_entities_p->transform_positions, cam_id),
+				        cam_p->target,
                                         grid_p);
 	
     // Render Pass 4 - Post Processing
@@ -543,6 +679,13 @@ gameRender(FrameTexture* depth_ftexture_p,
     
     p.end_time = platformGetTime();
     profilerGetTime(p);
+#if RENDER_PRINT_COUNTERS
+    sprintf_s(p.msg, PROFILER_MSG_LENGTH, "Draw calls: %u (Shadow: %u), Impostors: %u\n",
+	      room_impostors.draw_calls,
+	      room_impostors.shadow_draw_calls,
+	      room_impostors.impostor_count);
+    OutputDebugStringA(p.msg);
+#endif
     return 1;
 }
 
@@ -553,23 +696,32 @@ main()
     gameInit(1920, 1080);
     SoundInterface  sound_interface;
     platformLoadEntityTemplatesFromTxt(*active_entities_p, "..\\data\\templates\\entity_templates.txt");
+    activeEntitiesInitArchetypes(*active_entities_p);
+    activeEntitiesInitQueries(*active_entities_p);
+
+    // Systems & Worker Threads //
+    gameRegisterSystems();
+    uint thread_count = std::thread::hardware_concurrency();
+    schedulerStartWorkers(system_scheduler, (thread_count > 1) ? thread_count - 1 : 0);
     
     // Base Room Grid //
     roomGridLookupInit(roomgrid_lookup);
-    int br_id = activeEntitiesCreateEntity(*active_entities_p,
-					   roomgrid_lookup,
-					   -1,
-					   ROOMGRID_A,
-					   Vec3F(0.0f, 0.0f, 0.0f),
-					   BLOCK_ROOM);
+    int br_handle = activeEntitiesCreateEntity(*active_entities_p,
+					       roomgrid_lookup,
+					       -1,
+					       ROOMGRID_A,
+					       Vec3F(0.0f, 0.0f, 0.0f),
+					       BLOCK_ROOM);
+    int br_id = activeEntitiesGetID(*active_entities_p, br_handle);
     int br_rg_id = active_entities_p->roomgrid_ids[br_id];
     rg_transition_status.current_roomgrid_p = roomgrid_lookup.roomgrid_pointers[ROOMGRID_A];
 
     // Create Debug Grid Object
-    float br_current_scale = roomgrid_lookup.roomgrid_pointers[br_rg_id]->current_scale;
+    RoomGrid* br_rg_p = roomgrid_lookup.roomgrid_pointers[br_rg_id];
+    float br_current_scale = br_rg_p->current_scale;
     DebugGrid* grid_p = new DebugGrid(br_current_scale,
-				      RG_MAX_WIDTH + 1,
-				      RG_MAX_LENGTH + 1,
+				      br_rg_p->width + 1,
+				      br_rg_p->length + 1,
 				      Vec3F(-br_current_scale * 0.5f,
 					    -0.5f,
 					    -br_current_scale * 0.5f));
@@ -590,20 +742,25 @@ main()
 							 false);
     frameTextureDataToGPU(ftexture_non_msaa_p);
     
-    // 1st Block Room Entities //
-    // Blocks
-    for(int x = 0; x < RG_MAX_WIDTH; x++)
+    // Floor positions, shared by the floor blocks of every Block Room
+    Vec3F floor_positions[RG_DEFAULT_WIDTH * RG_DEFAULT_LENGTH];
+    for(int x = 0; x < RG_DEFAULT_WIDTH; x++)
     {
-	    for(int z = 0; z < RG_MAX_LENGTH; z++)
-	    {
-		activeEntitiesCreateEntity(*active_entities_p,
-					   roomgrid_lookup,
-					   ROOMGRID_A,
-					   -1,
-					   Vec3F((float)x, 0.0f, (float)z),
-					   BLOCK);	    
-	    }
+	for(int z = 0; z < RG_DEFAULT_LENGTH; z++)
+	{
+	    floor_positions[x * RG_DEFAULT_LENGTH + z] = Vec3F((float)x, 0.0f, (float)z);
+	}
     }
+    
+    // 1st Block Room Entities //
+    // Blocks
+    activeEntitiesCreateEntities(*active_entities_p,
+				 roomgrid_lookup,
+				 ROOMGRID_A,
+				 floor_positions,
+				 RG_DEFAULT_WIDTH * RG_DEFAULT_LENGTH,
+				 BLOCK,
+				 NULL);
     activeEntitiesCreateEntity(*active_entities_p,
 			       roomgrid_lookup,
 			       ROOMGRID_A,
@@ -621,12 +778,12 @@ main()
 			       roomgrid_lookup,
 			       ROOMGRID_A,
 			       -1,
-			       Vec3F(1.0f, 1.0f, RG_MAX_LENGTH - 2), SPECIAL_BLOCK);
+			       Vec3F(1.0f, 1.0f, RG_DEFAULT_LENGTH - 2), SPECIAL_BLOCK);
     activeEntitiesCreateEntity(*active_entities_p,
 			       roomgrid_lookup,
 			       ROOMGRID_A,
 			       -1,
-			       Vec3F(RG_MAX_WIDTH - 2, 1.0f, 1.0f),
+			       Vec3F(RG_DEFAULT_WIDTH - 2, 1.0f, 1.0f),
 			       SPECIAL_BLOCK);
     // Player
     activeEntitiesCreateEntity(*active_entities_p,
@@ -644,30 +801,25 @@ main()
 			       Vec3F(1.0f, 1.0f, 1.0f),
 			       BLOCK_ROOM);
     // Blocks
-    for(int x = 0; x < RG_MAX_WIDTH; x++)
-    {
-	    for(int z = 0; z < RG_MAX_LENGTH; z++)
-	    {
-		activeEntitiesCreateEntity(*active_entities_p,
-					   roomgrid_lookup,
-					   ROOMGRID_B,
-					   -1,
-					   Vec3F((float)x, 0.0f, (float)z),
-					   BLOCK);	    
-	    }
-    }
+    activeEntitiesCreateEntities(*active_entities_p,
+				 roomgrid_lookup,
+				 ROOMGRID_B,
+				 floor_positions,
+				 RG_DEFAULT_WIDTH * RG_DEFAULT_LENGTH,
+				 BLOCK,
+				 NULL);
     // Special Block
     activeEntitiesCreateEntity(*active_entities_p,
 			       roomgrid_lookup,
 			       ROOMGRID_B,
 			       -1,
-			       Vec3F(1.0f, 1.0f, RG_MAX_LENGTH - 2),
+			       Vec3F(1.0f, 1.0f, RG_DEFAULT_LENGTH - 2),
 			       SPECIAL_BLOCK);
     activeEntitiesCreateEntity(*active_entities_p,
 			       roomgrid_lookup,
 			       ROOMGRID_B,
 			       -1,
-			       Vec3F(RG_MAX_WIDTH - 2, 1.0f, 1.0f),
+			       Vec3F(RG_DEFAULT_WIDTH - 2, 1.0f, 1.0f),
 			       SPECIAL_BLOCK);
     // 3rd Block Room Entities //
     activeEntitiesCreateEntity(*active_entities_p,
@@ -677,18 +829,13 @@ main()
 			       Vec3F(1.0f, 1.0f, 1.0f),
 			       BLOCK_ROOM);
     // Blocks
-    for(int x = 0; x < RG_MAX_WIDTH; x++)
-    {
-	    for(int z = 0; z < RG_MAX_LENGTH; z++)
-	    {
-		activeEntitiesCreateEntity(*active_entities_p,
-					   roomgrid_lookup,
-					   ROOMGRID_C,
-					   -1,
-					   Vec3F((float)x, 0.0f, (float)z),
-					   BLOCK);	    
-	    }
-    }
+    activeEntitiesCreateEntities(*active_entities_p,
+				 roomgrid_lookup,
+				 ROOMGRID_C,
+				 floor_positions,
+				 RG_DEFAULT_WIDTH * RG_DEFAULT_LENGTH,
+				 BLOCK,
+				 NULL);
     // Special Block
     activeEntitiesCreateEntity(*active_entities_p,
 			       roomgrid_lookup,
@@ -700,13 +847,13 @@ main()
 			       roomgrid_lookup,
 			       ROOMGRID_C,
 			       -1,
-			       Vec3F(1.0f, 1.0f, RG_MAX_LENGTH - 2),
+			       Vec3F(1.0f, 1.0f, RG_DEFAULT_LENGTH - 2),
 			       SPECIAL_BLOCK);
     activeEntitiesCreateEntity(*active_entities_p,
 			       roomgrid_lookup,
 			       ROOMGRID_C,
 			       -1,
-			       Vec3F(RG_MAX_WIDTH - 2, 1.0f, 1.0f),
+			       Vec3F(RG_DEFAULT_WIDTH - 2, 1.0f, 1.0f),
 			       SPECIAL_BLOCK);
     // 4th Block Room Entities //
     activeEntitiesCreateEntity(*active_entities_p,
@@ -716,18 +863,13 @@ main()
 			       Vec3F(5.0f, 1.0f, 5.0f),
 			       BLOCK_ROOM);
     // Blocks
-    for(int x = 0; x < RG_MAX_WIDTH; x++)
-    {
-	    for(int z = 0; z < RG_MAX_LENGTH; z++)
-	    {
-		activeEntitiesCreateEntity(*active_entities_p,
-					   roomgrid_lookup,
-					   ROOMGRID_D,
-					   -1,
-					   Vec3F((float)x, 0.0f, (float)z),
-					   BLOCK);	    
-	    }
-    }
+    activeEntitiesCreateEntities(*active_entities_p,
+				 roomgrid_lookup,
+				 ROOMGRID_D,
+				 floor_positions,
+				 RG_DEFAULT_WIDTH * RG_DEFAULT_LENGTH,
+				 BLOCK,
+				 NULL);
     // Special Block
     activeEntitiesCreateEntity(*active_entities_p,
 			       roomgrid_lookup,
@@ -739,13 +881,13 @@ main()
 			       roomgrid_lookup,
 			       ROOMGRID_D,
 			       -1,
-			       Vec3F(1.0f, 1.0f, RG_MAX_LENGTH - 2),
+			       Vec3F(1.0f, 1.0f, RG_DEFAULT_LENGTH - 2),
 			       SPECIAL_BLOCK);
     activeEntitiesCreateEntity(*active_entities_p,
 			       roomgrid_lookup,
 			       ROOMGRID_D,
 			       -1,
-			       Vec3F(RG_MAX_WIDTH - 2, 1.0f, 1.0f),
+			       Vec3F(RG_DEFAULT_WIDTH - 2, 1.0f, 1.0f),
 			       SPECIAL_BLOCK);
     // 5th Block Room Entities //
     activeEntitiesCreateEntity(*active_entities_p,
@@ -755,18 +897,13 @@ main()
 			       Vec3F(8.0f, 1.0f, 5.0f),
 			       BLOCK_ROOM);
     // Blocks
-    for(int x = 0; x < RG_MAX_WIDTH; x++)
-    {
-	    for(int z = 0; z < RG_MAX_LENGTH; z++)
-	    {
-		activeEntitiesCreateEntity(*active_entities_p,
-					   roomgrid_lookup,
-					   ROOMGRID_E,
-					   -1,
-					   Vec3F((float)x, 0.0f, (float)z),
-					   BLOCK);	    
-	    }
-    }
+    activeEntitiesCreateEntities(*active_entities_p,
+				 roomgrid_lookup,
+				 ROOMGRID_E,
+				 floor_positions,
+				 RG_DEFAULT_WIDTH * RG_DEFAULT_LENGTH,
+				 BLOCK,
+				 NULL);
     // Special Block
     activeEntitiesCreateEntity(*active_entities_p,
 			       roomgrid_lookup,
@@ -778,13 +915,13 @@ main()
 			       roomgrid_lookup,
 			       ROOMGRID_E,
 			       -1,
-			       Vec3F(1.0f, 1.0f, RG_MAX_LENGTH - 2),
+			       Vec3F(1.0f, 1.0f, RG_DEFAULT_LENGTH - 2),
 			       SPECIAL_BLOCK);
     activeEntitiesCreateEntity(*active_entities_p,
 			       roomgrid_lookup,
 			       ROOMGRID_E,
 			       -1,
-			       Vec3F(RG_MAX_WIDTH - 2, 1.0f, 1.0f),
+			       Vec3F(RG_DEFAULT_WIDTH - 2, 1.0f, 1.0f),
 			       SPECIAL_BLOCK);
     // 6th Block Room Entities //
     activeEntitiesCreateEntity(*active_entities_p,
@@ -794,18 +931,13 @@ main()
 			       Vec3F(5.0f, 1.0f, 8.0f),
 			       BLOCK_ROOM);
     // Blocks
-    for(int x = 0; x < RG_MAX_WIDTH; x++)
-    {
-	    for(int z = 0; z < RG_MAX_LENGTH; z++)
-	    {
-		activeEntitiesCreateEntity(*active_entities_p,
-					   roomgrid_lookup,
-					   ROOMGRID_F,
-					   -1,
-					   Vec3F((float)x, 0.0f, (float)z),
-					   BLOCK);	    
-	    }
-    }
+    activeEntitiesCreateEntities(*active_entities_p,
+				 roomgrid_lookup,
+				 ROOMGRID_F,
+				 floor_positions,
+				 RG_DEFAULT_WIDTH * RG_DEFAULT_LENGTH,
+				 BLOCK,
+				 NULL);
     // Special Block
     activeEntitiesCreateEntity(*active_entities_p,
 			       roomgrid_lookup,
@@ -817,55 +949,62 @@ main()
 			       roomgrid_lookup,
 			       ROOMGRID_F,
 			       -1,
-			       Vec3F(1.0f, 1.0f, RG_MAX_LENGTH - 2),
+			       Vec3F(1.0f, 1.0f, RG_DEFAULT_LENGTH - 2),
 			       SPECIAL_BLOCK);
     activeEntitiesCreateEntity(*active_entities_p,
 			       roomgrid_lookup,
 			       ROOMGRID_F,
 			       -1,
-			       Vec3F(RG_MAX_WIDTH - 2, 1.0f, 1.0f),
+			       Vec3F(RG_DEFAULT_WIDTH - 2, 1.0f, 1.0f),
 			       SPECIAL_BLOCK);
     
     // DirLight //
     Vec3F dirlight_target = roomgrid_lookup.roomgrid_pointers[ROOMGRID_A]->center;
     Vec3F dirlight_offset = Vec3F(20.0f, 20.0f, -20.0f);
-    int dir_light_id = activeEntitiesCreateEntity(*active_entities_p,
-						  roomgrid_lookup,
-						  ROOMGRID_A,
-						  -1,
-						  dirlight_target + dirlight_offset,
-						  DIR_LIGHT);
-    active_entities_p->dir_lights[dir_light_id].target = dirlight_target;
-    active_entities_p->dir_lights[dir_light_id].offset = dirlight_offset;
-    active_entities_p->dir_lights[dir_light_id].dir = (dirlight_target - (dirlight_target + dirlight_offset));
+    int dir_light_handle = activeEntitiesCreateEntity(*active_entities_p,
+						      roomgrid_lookup,
+						      ROOMGRID_A,
+						      -1,
+						      dirlight_target + dirlight_offset,
+						      DIR_LIGHT);
+    DirLight* dir_light_p = (DirLight*)activeEntitiesGetComponentP(*active_entities_p,
+								   activeEntitiesGetID(*active_entities_p,
+										       dir_light_handle),
+								   COMPONENT_DIR_LIGHT);
+    dir_light_p->target = dirlight_target;
+    dir_light_p->offset = dirlight_offset;
+    dir_light_p->dir = (dirlight_target - (dirlight_target + dirlight_offset));
 
     // Camera //
-    int cam_id = activeEntitiesCreateEntity(*active_entities_p,
-					    roomgrid_lookup,
-					    ROOMGRID_A,
-					    -1,
-					    (roomgrid_lookup.roomgrid_pointers[br_rg_id]->center +
-					     Vec3F(RG_MAX_WIDTH * 3.0f,
-						   RG_MAX_HEIGHT * 3.0f,
-						   RG_MAX_LENGTH * 3.0f)),
-					     CAMERA);
-    active_entities_p->cameras[cam_id].target = roomgrid_lookup.roomgrid_pointers[ROOMGRID_A]->center;
+    int cam_handle = activeEntitiesCreateEntity(*active_entities_p,
+						roomgrid_lookup,
+						ROOMGRID_A,
+						-1,
+						(br_rg_p->center +
+						 Vec3F(br_rg_p->width * 3.0f,
+						       br_rg_p->height * 3.0f,
+						       br_rg_p->length * 3.0f)),
+						CAMERA);
+    Camera* cam_p = (Camera*)activeEntitiesGetComponentP(*active_entities_p,
+							 activeEntitiesGetID(*active_entities_p, cam_handle),
+							 COMPONENT_CAMERA);
+    cam_p->target = roomgrid_lookup.roomgrid_pointers[ROOMGRID_A]->center;
     
     // Game Loop //
     
     while(!game_window.close)
     {	
         gameUpdate(test_soundStream_p,
-		   cam_id,
-		   dir_light_id);
+		   cam_handle,
+		   dir_light_handle);
 
 	gameRender(depth_ftexture_p,
 		   ftexture_msaa_p,
 		   ftexture_non_msaa_p,
 		   roomgrid_lookup,
 		   grid_p,
-		   cam_id,
-		   dir_light_id);
+		   cam_handle,
+		   dir_light_handle);
 
 	gameUpdateInputs();
 	
@@ -875,9 +1014,10 @@ main()
 
     // Cleanup //
 
+    schedulerStopWorkers(system_scheduler);
     platformFreeWindow(game_window);
 
-    for(uint i = 0; i < TOTAL_ROOMGRIDS; i++)
+    for(uint i = 0; i < roomgrid_lookup.roomgrid_pointers.size(); i++)
     {
 	delete roomgrid_lookup.roomgrid_pointers[i];
     }
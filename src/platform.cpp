@@ -285,10 +285,294 @@ platformRenderShadowMapToScreen(AssetManager& asset_manager,
     glDrawArrays(GL_TRIANGLES, 0, 6);    
 }
 
+RoomImpostors::RoomImpostors()
+{
+    memset(type_colors_set, 0, sizeof(type_colors_set));
+    impostor_count    = 0;
+    instance_count    = 0;
+    shadow_draw_calls = 0;
+    draw_calls        = 0;
+}
+
+static Vec3F
+platformGetTypeColor(RoomImpostors& impostors, AssetManager& asset_manager, uint type)
+{
+    // Average texel of the type's diffuse map, white if it has none
+    if(impostors.type_colors_set[type]) {return impostors.type_colors[type];}
+    Vec3F color = Vec3F(1.0f, 1.0f, 1.0f);
+    Texture* texture_d_p = (Texture*)assetManagerGetAssetP(asset_manager, type, TEXTURE_D, 0);
+    if(texture_d_p && texture_d_p->map.size() >= 3)
+    {
+	double sums[3] = {0.0, 0.0, 0.0};
+	uint texels = (uint)texture_d_p->map.size() / 3;
+	const uchar* map_p = texture_d_p->map.data();
+	for(uint i = 0; i < texels; i++)
+	{
+	    sums[0] += map_p[i * 3 + 2]; // .bmp stores BGR
+	    sums[1] += map_p[i * 3 + 1];
+	    sums[2] += map_p[i * 3 + 0];
+	}
+	double denom = (double)texels * 255.0;
+	color = Vec3F((float)(sums[0] / denom), (float)(sums[1] / denom), (float)(sums[2] / denom));
+    }
+    impostors.type_colors[type]     = color;
+    impostors.type_colors_set[type] = true;
+    return color;
+}
+
+static uint
+platformGetRoomLod(RoomImpostors& impostors, const RoomGridLookup& roomgrid_lookup,
+		   int id, float pixels_per_unit)
+{
+    // Memoized in impostors.lods. Owners are resolved first, a RoomGrid inside an
+    // impostor is hidden whatever its own size.
+    if(impostors.lods[id + 1] != ROOM_LOD_UNKNOWN) {return impostors.lods[id + 1];}
+    uint lod = ROOM_LOD_FULL;
+    const RoomGrid* rg_p = roomgrid_lookup.roomgrid_pointers[id];
+    if(rg_p)
+    {
+	int owner_id = rg_p->roomgrid_owner_id;
+	float pixels = (float)roomGridGetSpan(*rg_p) * rg_p->transform_scale * pixels_per_unit;
+	if(rg_p->is_template ||
+	   (owner_id > -1 &&
+	    platformGetRoomLod(impostors, roomgrid_lookup, owner_id, pixels_per_unit) != ROOM_LOD_FULL))
+	{
+	    lod = ROOM_LOD_HIDDEN;
+	}
+	else if(pixels < RG_IMPOSTOR_PIXELS)
+	{
+	    lod = ROOM_LOD_IMPOSTOR;
+	}
+    }
+    impostors.lods[id + 1] = (uchar)lod;
+    return lod;
+}
+
+static void
+platformBuildRoomTint(RoomImpostors& impostors,
+		      const ActiveEntities& active_entities,
+		      AssetManager& asset_manager,
+		      RoomGrid& rg)
+{
+    // Uploads the average color of the RoomGrid's rendered contents as a 1x1 texture
+    uint id = (uint)rg.roomgrid_id;
+    Vec3F sum = Vec3F(0.0f, 0.0f, 0.0f);
+    uint count = 0;
+    const uint64* live_p   = active_entities.bitsets[BITSET_LIVE];
+    const uint64* render_p = active_entities.bitsets[BITSET_RENDER];
+    for(uint k = 0; k < rg.contents.size(); k++)
+    {
+	int entity_id = activeEntitiesGetID(active_entities, rg.contents[k]);
+	if(entity_id < 0 ||
+	   !bitsetGet(live_p, (uint)entity_id) ||
+	   !bitsetGet(render_p, (uint)entity_id)) {continue;}
+	sum += platformGetTypeColor(impostors, asset_manager, active_entities.types[entity_id]);
+	count++;
+    }
+    // Template entities standing in for a clone's
+    for(uint b = 0; b < rg.brick_count; b++)
+    {
+	if(!roomGridBrickIsShared(rg, b)) {continue;}
+	uint64 word = rg.occupancy[b];
+	while(word)
+	{
+	    int entity_id = activeEntitiesGetID(active_entities, rg.bricks[b]->cells[bitsetPopLowest(word)]);
+	    if(entity_id < 0 || !bitsetGet(render_p, (uint)entity_id)) {continue;}
+	    sum += platformGetTypeColor(impostors, asset_manager, active_entities.types[entity_id]);
+	    count++;
+	}
+    }
+    impostors.tint_counts[id] = count;
+    rg.impostor_dirty = false;
+    if(!count) {return;}
+
+    Vec3F color = sum * (1.0f / (float)count);
+    uchar texel[4] = {(uchar)(color.x * 255.0f + 0.5f),
+		      (uchar)(color.y * 255.0f + 0.5f),
+		      (uchar)(color.z * 255.0f + 0.5f),
+		      255};
+    if(!impostors.texture_ids[id])
+    {
+	glGenTextures(1, &impostors.texture_ids[id]);
+	glBindTexture(GL_TEXTURE_2D, impostors.texture_ids[id]);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    }
+    glBindTexture(GL_TEXTURE_2D, impostors.texture_ids[id]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+}
+
+static Mat4F
+platformGetImpostorModelMat(const RoomGrid& rg, Vec3F base, float scale)
+{
+    // Box covering every cell of the RoomGrid, placed like its contents
+    Vec3F extents = Vec3F((float)rg.width, (float)rg.height, (float)rg.length);
+    Vec3F center  = base + ((extents - Vec3F(1.0f, 1.0f, 1.0f)) * (0.5f * scale));
+    return getModelMat(extents * scale, center);
+}
+
+static RoomInstance
+platformGetNestedInstance(const RoomGrid& rg, Vec3F holder_pos, float holder_scale)
+{
+    // rg placed in the cell centered on holder_pos, the same way owned RoomGrids are
+    RoomInstance instance;
+    instance.roomgrid_id = rg.roomgrid_id;
+    instance.scale       = holder_scale / (float)roomGridGetSpan(rg);
+    instance.base        = (holder_pos +
+			    (Vec3F(-0.5f, -0.5f, -0.5f) * holder_scale) +
+			    (Vec3F(0.5f, 0.5f, 0.5f) * instance.scale));
+    return instance;
+}
+
+static void
+platformAddSharedCellDraws(RoomImpostors& impostors,
+			   const ActiveEntities& active_entities,
+			   const RoomGrid& rg,
+			   Vec3F base,
+			   float scale)
+{
+    // Draws of the template entities in the bricks a clone still shares, placed in the clone
+    if(rg.template_id < 0) {return;}
+    const uint64* render_p = active_entities.bitsets[BITSET_RENDER];
+    Vec3F entity_scale = Vec3F(scale, scale, scale);
+    for(uint b = 0; b < rg.brick_count; b++)
+    {
+	if(!roomGridBrickIsShared(rg, b)) {continue;}
+	uint64 word = rg.occupancy[b];
+	while(word)
+	{
+	    uint cell = bitsetPopLowest(word);
+	    int entity_id = activeEntitiesGetID(active_entities, rg.bricks[b]->cells[cell]);
+	    if(entity_id < 0 || !bitsetGet(render_p, (uint)entity_id)) {continue;}
+	    RoomInstanceDraw draw;
+	    draw.model       = getModelMat(entity_scale, base + (roomGridGetCellPosition(rg, b, cell) * scale));
+	    draw.entity_id   = entity_id;
+	    draw.roomgrid_id = rg.roomgrid_id;
+	    impostors.instance_draws.push_back(draw);
+	}
+    }
+}
+
+static void
+platformExpandRoomInstances(RoomImpostors& impostors,
+			    const ActiveEntities& active_entities,
+			    const RoomGridLookup& roomgrid_lookup,
+			    AssetManager& asset_manager,
+			    float pixels_per_unit)
+{
+    // Seeds the queue with the references held in fully drawn RoomGrids, then expands
+    // it breadth-first into impostors.instance_draws. Each RoomGrid costs one copy of
+    // its cells however many instances it has. The template cells of fully drawn clones
+    // are added to the draws too, as they have no transforms in the clone either.
+    std::vector<RoomInstance>& queue = impostors.instance_queue;
+    queue.clear();
+    impostors.instance_draws.clear();
+    impostors.instance_count = 0;
+
+    const uint64* live_p   = active_entities.bitsets[BITSET_LIVE];
+    const uint64* render_p = active_entities.bitsets[BITSET_RENDER];
+    uint room_total = (uint)roomgrid_lookup.roomgrid_pointers.size();
+    for(uint id = 0; id < room_total; id++)
+    {
+	const RoomGrid* rg_p = roomgrid_lookup.roomgrid_pointers[id];
+	if(!rg_p) {continue;}
+	if(impostors.lods[id + 1] == ROOM_LOD_FULL)
+	{
+	    platformAddSharedCellDraws(impostors, active_entities, *rg_p, rg_p->transform_base, rg_p->transform_scale);
+	}
+	for(uint r = 0; r < rg_p->references.size(); r++)
+	{
+	    int holder_id = activeEntitiesGetID(active_entities, rg_p->references[r]);
+	    if(holder_id < 0 || !bitsetGet(live_p, (uint)holder_id)) {continue;}
+	    int holder_rg_id = active_entities.roomgrid_owner_ids[holder_id];
+	    if(holder_rg_id < 0 || impostors.lods[holder_rg_id + 1] != ROOM_LOD_FULL) {continue;}
+	    queue.push_back(platformGetNestedInstance(*rg_p,
+						      vec3FColumnsGet(active_entities.transform_positions, holder_id),
+						      roomgrid_lookup.roomgrid_pointers[holder_rg_id]->transform_scale));
+	}
+    }
+
+    for(uint head = 0; head < queue.size(); head++)
+    {
+	RoomInstance instance = queue[head]; // Copied, the queue grows below
+	RoomGrid* rg_p = roomgrid_lookup.roomgrid_pointers[instance.roomgrid_id];
+	float pixels = (float)roomGridGetSpan(*rg_p) * instance.scale * pixels_per_unit;
+	if(pixels < RG_IMPOSTOR_PIXELS || impostors.instance_count >= RG_MAX_ROOM_INSTANCES)
+	{
+	    if(rg_p->impostor_dirty) {platformBuildRoomTint(impostors, active_entities, asset_manager, *rg_p);}
+	    if(!impostors.tint_counts[instance.roomgrid_id]) {continue;}
+	    RoomInstanceDraw draw;
+	    draw.model       = platformGetImpostorModelMat(*rg_p, instance.base, instance.scale);
+	    draw.entity_id   = -1;
+	    draw.roomgrid_id = instance.roomgrid_id;
+	    impostors.instance_draws.push_back(draw);
+	    continue;
+	}
+	impostors.instance_count++;
+
+	platformAddSharedCellDraws(impostors, active_entities, *rg_p, instance.base, instance.scale);
+	Vec3F scale = Vec3F(instance.scale, instance.scale, instance.scale);
+	for(uint c = 0; c < rg_p->contents.size(); c++)
+	{
+	    int content_id = activeEntitiesGetID(active_entities, rg_p->contents[c]);
+	    if(content_id < 0 || !bitsetGet(live_p, (uint)content_id)) {continue;}
+	    Vec3F pos = instance.base + (vec3FColumnsGet(active_entities.grid_positions, content_id) * instance.scale);
+	    if(bitsetGet(render_p, (uint)content_id))
+	    {
+		RoomInstanceDraw draw;
+		draw.model       = getModelMat(scale, pos);
+		draw.entity_id   = content_id;
+		draw.roomgrid_id = instance.roomgrid_id;
+		impostors.instance_draws.push_back(draw);
+	    }
+	    // Owned & referenced RoomGrids alike are nested in this instance
+	    int child_rg_id = active_entities.roomgrid_ids[content_id];
+	    if(child_rg_id > -1 && roomgrid_lookup.roomgrid_pointers[child_rg_id])
+	    {
+		queue.push_back(platformGetNestedInstance(*roomgrid_lookup.roomgrid_pointers[child_rg_id],
+							  pos,
+							  instance.scale));
+	    }
+	}
+    }
+}
+
+void
+platformUpdateRoomImpostors(RoomImpostors& impostors,
+				 const ActiveEntities& active_entities,
+				 const RoomGridLookup& roomgrid_lookup,
+				 AssetManager& asset_manager,
+				 const FrameTexture& framebuffer)
+{
+    // Picks each RoomGrid's RoomLod from its projected size this frame, rebuilds the
+    // tints of impostors whose contents changed & expands the shared RoomGrid instances.
+    // Must run after the transforms update.
+    uint room_total = (uint)roomgrid_lookup.roomgrid_pointers.size();
+    impostors.lods.assign(room_total + 1, ROOM_LOD_UNKNOWN);
+    impostors.lods[0] = ROOM_LOD_FULL;
+    impostors.texture_ids.resize(room_total, 0);
+    impostors.tint_counts.resize(room_total, 0);
+    impostors.impostor_count = 0;
+
+    float pixels_per_unit = (float)framebuffer.height / CAM_ORTHO_HEIGHT;
+    for(uint id = 0; id < room_total; id++)
+    {
+	if(platformGetRoomLod(impostors, roomgrid_lookup, (int)id, pixels_per_unit) != ROOM_LOD_IMPOSTOR)
+	{
+	    continue;
+	}
+	RoomGrid* rg_p = roomgrid_lookup.roomgrid_pointers[id];
+	if(rg_p->impostor_dirty) {platformBuildRoomTint(impostors, active_entities, asset_manager, *rg_p);}
+	impostors.impostor_count++;
+    }
+    platformExpandRoomInstances(impostors, active_entities, roomgrid_lookup, asset_manager, pixels_per_unit);
+}
+
 void
 platformRenderShadowMapToBuffer(ActiveEntities& active_entities,
 				     const FrameTexture& depth_framebuffer,
 				     const RoomGridLookup& roomgrid_lookup,
+				     RoomImpostors& impostors,
 				     AssetManager& asset_manager,
 				     const GameWindow& game_window,
 				     uint dir_light_id)
@@ -305,13 +589,16 @@ platformRenderShadowMapToBuffer(ActiveEntities& active_entities,
     glUseProgram(shadowmap_shader_p->program_id);
 
     // View Mat
-    Mat4F view = lookAt(active_entities.transforms[dir_light_id].position,
-		        active_entities.dir_lights[dir_light_id].target,
+    DirLight* dir_light_p = (DirLight*)activeEntitiesGetComponentP(active_entities,
+								   dir_light_id,
+								   COMPONENT_DIR_LIGHT);
+    Mat4F view = lookAt(vec3FColumnsGet(active_entities.transform_positions, dir_light_id),
+		        dir_light_p->target,
 			Vec3F(0.0f, 1.0f, 0.0f));
     shaderAddMat4Uniform(shadowmap_shader_p, "view", view.getPointer());
 
     // Projection Mat
-    float ortho_height = 30.0f;
+    float ortho_height = CAM_ORTHO_HEIGHT;
     float ortho_width  = ortho_height * game_window.win_ar;
     Mat4F projection = getOrthoProjection(-ortho_width * 0.5f,
 					   ortho_width * 0.5f,
@@ -323,13 +610,20 @@ platformRenderShadowMapToBuffer(ActiveEntities& active_entities,
 
     // Render Entity Depths //
    
-    for(uint i = 0; i < active_entities.count; i++)
+    const uint64* live_p   = active_entities.bitsets[BITSET_LIVE];
+    const uint64* render_p = active_entities.bitsets[BITSET_RENDER];
+    const uchar*  lods_p   = impostors.lods.data();
+    uint draw_calls = 0;
+    uint word_count = bitsetWordCount(active_entities.count);
+    for(uint w = 0; w < word_count; w++)
     {
-	if(active_entities.entity_templates.table[active_entities.types[i]][COMPONENT_RENDER] &&
-	   active_entities.entity_templates.table[active_entities.types[i]][COMPONENT_TRANSFORM])
+	uint64 word = live_p[w] & render_p[w];
+	while(word)
 	{
-	    Mat4F model = getModelMat(active_entities.transforms[i].scale,
-				      active_entities.transforms[i].position);
+	    uint i = (w << 6) + bitsetPopLowest(word);
+	    if(lods_p[active_entities.roomgrid_owner_ids[i] + 1] != ROOM_LOD_FULL) {continue;}
+	    Mat4F model = getModelMat(vec3FColumnsGet(active_entities.transform_scales, i),
+				      vec3FColumnsGet(active_entities.transform_positions, i));
 	    shaderAddMat4Uniform(shadowmap_shader_p, "model", model.getPointer());
 	    Mesh* mesh_01_p = (Mesh*)assetManagerGetAssetP(asset_manager,
 							   active_entities.types[i],
@@ -337,8 +631,40 @@ platformRenderShadowMapToBuffer(ActiveEntities& active_entities,
 							   0);
 	    glBindVertexArray(mesh_01_p->vao);
 	    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)mesh_01_p->data.size());
+	    draw_calls++;
 	}
     }
+
+    // Render Impostor Depths //
+
+    Mesh* box_mesh_p = (Mesh*)assetManagerGetAssetP(asset_manager, BLOCK, MESH01, 0);
+    glBindVertexArray(box_mesh_p->vao);
+    for(uint id = 0; id < impostors.tint_counts.size(); id++)
+    {
+	if(lods_p[id + 1] != ROOM_LOD_IMPOSTOR || !impostors.tint_counts[id]) {continue;}
+	const RoomGrid* rg_p = roomgrid_lookup.roomgrid_pointers[id];
+	Mat4F model = platformGetImpostorModelMat(*rg_p, rg_p->transform_base, rg_p->transform_scale);
+	shaderAddMat4Uniform(shadowmap_shader_p, "model", model.getPointer());
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)box_mesh_p->data.size());
+	draw_calls++;
+    }
+
+    // Render Shared RoomGrid Instance Depths //
+
+    for(uint d = 0; d < impostors.instance_draws.size(); d++)
+    {
+	RoomInstanceDraw& draw = impostors.instance_draws[d];
+	Mesh* mesh_p = box_mesh_p;
+	if(draw.entity_id > -1)
+	{
+	    mesh_p = (Mesh*)assetManagerGetAssetP(asset_manager, active_entities.types[draw.entity_id], MESH01, 0);
+	}
+	shaderAddMat4Uniform(shadowmap_shader_p, "model", draw.model.getPointer());
+	glBindVertexArray(mesh_p->vao);
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)mesh_p->data.size());
+	draw_calls++;
+    }
+    impostors.shadow_draw_calls = draw_calls;
 }
 
 void
@@ -346,6 +672,7 @@ platformRenderEntitiesToBuffer(const ActiveEntities& active_entities,
 				    const FrameTexture& framebuffer,
 				    const FrameTexture& depth_framebuffer,
 				    const RoomGridLookup& roomgrid_lookup,
+				    RoomImpostors& impostors,
 				    const GameWindow& game_window,
 				    AssetManager& asset_manager,
 				    uint dir_light_id,
@@ -361,18 +688,24 @@ platformRenderEntitiesToBuffer(const ActiveEntities& active_entities,
     // Set Shader Uniforms //
     Shader* bp_shader_p = (Shader*)assetManagerGetShaderP(asset_manager, BLINNPHONG);
     glUseProgram(bp_shader_p->program_id);
+    Camera*   cam_p       = (Camera*)activeEntitiesGetComponentP(active_entities,
+								 cam_id,
+								 COMPONENT_CAMERA);
+    DirLight* dir_light_p = (DirLight*)activeEntitiesGetComponentP(active_entities,
+								   dir_light_id,
+								   COMPONENT_DIR_LIGHT);
     // Light View Mat
-    Mat4F light_view = lookAt(active_entities.transforms[dir_light_id].position,
-			      active_entities.cameras[cam_id].target,
+    Mat4F light_view = lookAt(vec3FColumnsGet(active_entities.transform_positions, dir_light_id),
+			      cam_p->target,
 			      Vec3F(0.0f, 1.0f, 0.0f));
     shaderAddMat4Uniform(bp_shader_p, "light_view", light_view.getPointer());    
     // Cam View Mat
-    Mat4F cam_view = lookAt(active_entities.transforms[cam_id].position,
-			    active_entities.cameras[cam_id].target,
+    Mat4F cam_view = lookAt(vec3FColumnsGet(active_entities.transform_positions, cam_id),
+			    cam_p->target,
 			    Vec3F(0.0f, 1.0f, 0.0f));
     shaderAddMat4Uniform(bp_shader_p, "cam_view", cam_view.getPointer());
     // Projection Mat
-    float ortho_height = 30.0f;
+    float ortho_height = CAM_ORTHO_HEIGHT;
     float ortho_width = ortho_height * game_window.win_ar;
     Mat4F projection = getOrthoProjection(-ortho_width * 0.5f,
 					   ortho_width * 0.5f,
@@ -382,17 +715,17 @@ platformRenderEntitiesToBuffer(const ActiveEntities& active_entities,
 					   ortho_height * 10.0f);
     shaderAddMat4Uniform(bp_shader_p, "projection", projection.getPointer());
     // Cam Pos
-    shaderAddVec3Uniform(bp_shader_p, "cam_pos", active_entities.transforms[cam_id].position);
+    shaderAddVec3Uniform(bp_shader_p, "cam_pos", vec3FColumnsGet(active_entities.transform_positions, cam_id));
     // Single Dir Light
     shaderAddVec3Uniform(bp_shader_p,
 			 "dirLight.color",
-			 active_entities.dir_lights[dir_light_id].color);
+			 dir_light_p->color);
     shaderAddVec3Uniform(bp_shader_p,
 			 "dirLight.dir",
-			 active_entities.dir_lights[dir_light_id].dir);
+			 dir_light_p->dir);
     shaderAddFloatUniform(bp_shader_p,
 			  "dirLight.ambient_strength",
-			  active_entities.dir_lights[dir_light_id].ambient_strength);
+			  dir_light_p->ambient_strength);
     // Textures
     shaderAddIntUniform(bp_shader_p, "diffuse_map", 0);
     shaderAddIntUniform(bp_shader_p, "normal_map", 1);
@@ -401,11 +734,19 @@ platformRenderEntitiesToBuffer(const ActiveEntities& active_entities,
     
     // Render Entities to Buffer //
 
-    for(uint i = 0; i < active_entities.count; i++)
+    const uint64* live_p   = active_entities.bitsets[BITSET_LIVE];
+    const uint64* render_p = active_entities.bitsets[BITSET_RENDER];
+    const uchar*  lods_p   = impostors.lods.data();
+    uint draw_calls = 0;
+    uint word_count = bitsetWordCount(active_entities.count);
+    for(uint w = 0; w < word_count; w++)
     {
-	if(active_entities.entity_templates.table[active_entities.types[i]][COMPONENT_RENDER] &&
-	   active_entities.entity_templates.table[active_entities.types[i]][COMPONENT_TRANSFORM])
+	uint64 word = live_p[w] & render_p[w];
+	while(word)
 	{
+	    uint i = (w << 6) + bitsetPopLowest(word);
+	    // Contents of impostor & hidden RoomGrids are drawn as the impostor's box
+	    if(lods_p[active_entities.roomgrid_owner_ids[i] + 1] != ROOM_LOD_FULL) {continue;}
 	    // Mesh 01
 	    Mesh* mesh_01_p  = (Mesh*)assetManagerGetAssetP(asset_manager,
 							    active_entities.types[i],
@@ -428,8 +769,8 @@ platformRenderEntitiesToBuffer(const ActiveEntities& active_entities,
 								   0);
 	    
 	    // Update Model Uniform in Shader
-	    Mat4F model = getModelMat(active_entities.transforms[i].scale,
-				      active_entities.transforms[i].position);
+	    Mat4F model = getModelMat(vec3FColumnsGet(active_entities.transform_scales, i),
+				      vec3FColumnsGet(active_entities.transform_positions, i));
 	    shaderAddMat4Uniform(bp_shader_p, "model", model.getPointer());
 	    // Bind Diffuse Texture
 	    glActiveTexture(GL_TEXTURE0);
@@ -447,8 +788,63 @@ platformRenderEntitiesToBuffer(const ActiveEntities& active_entities,
 	    glBindVertexArray(mesh_01_p->vao);
 	    // Draw
 	    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)mesh_01_p->data.size());
+	    draw_calls++;
+	}
+    }
+
+    // Render Impostors to Buffer //
+
+    Mesh*    box_mesh_p      = (Mesh*)assetManagerGetAssetP(asset_manager, BLOCK, MESH01, 0);
+    Texture* box_texture_n_p = (Texture*)assetManagerGetAssetP(asset_manager, BLOCK, TEXTURE_N, 0);
+    Texture* box_texture_s_p = (Texture*)assetManagerGetAssetP(asset_manager, BLOCK, TEXTURE_S, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, box_texture_n_p->texture_id);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, box_texture_s_p->texture_id);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, depth_framebuffer.depth_text_id);
+    glBindVertexArray(box_mesh_p->vao);
+    for(uint id = 0; id < impostors.tint_counts.size(); id++)
+    {
+	if(lods_p[id + 1] != ROOM_LOD_IMPOSTOR || !impostors.tint_counts[id]) {continue;}
+	const RoomGrid* rg_p = roomgrid_lookup.roomgrid_pointers[id];
+	Mat4F model = platformGetImpostorModelMat(*rg_p, rg_p->transform_base, rg_p->transform_scale);
+	shaderAddMat4Uniform(bp_shader_p, "model", model.getPointer());
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, impostors.texture_ids[id]);
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)box_mesh_p->data.size());
+	draw_calls++;
+    }
+
+    // Render Shared RoomGrid Instances to Buffer //
+
+    for(uint d = 0; d < impostors.instance_draws.size(); d++)
+    {
+	RoomInstanceDraw& draw = impostors.instance_draws[d];
+	Mesh*  mesh_p       = box_mesh_p;
+	GLuint texture_d_id = impostors.texture_ids[draw.roomgrid_id];
+	GLuint texture_n_id = box_texture_n_p->texture_id;
+	GLuint texture_s_id = box_texture_s_p->texture_id;
+	if(draw.entity_id > -1)
+	{
+	    uint type = active_entities.types[draw.entity_id];
+	    mesh_p       = (Mesh*)assetManagerGetAssetP(asset_manager, type, MESH01, 0);
+	    texture_d_id = ((Texture*)assetManagerGetAssetP(asset_manager, type, TEXTURE_D, 0))->texture_id;
+	    texture_n_id = ((Texture*)assetManagerGetAssetP(asset_manager, type, TEXTURE_N, 0))->texture_id;
+	    texture_s_id = ((Texture*)assetManagerGetAssetP(asset_manager, type, TEXTURE_S, 0))->texture_id;
 	}
+	shaderAddMat4Uniform(bp_shader_p, "model", draw.model.getPointer());
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture_d_id);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, texture_n_id);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, texture_s_id);
+	glBindVertexArray(mesh_p->vao);
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)mesh_p->data.size());
+	draw_calls++;
     }
+    impostors.draw_calls = draw_calls;
 }
 
 void
@@ -468,7 +864,7 @@ platformRenderDebugElementsToBuffer(const GameWindow& game_window,
     Mat4F view = lookAt(cam_pos, cam_target, Vec3F(0.0f, 1.0f, 0.0f));
     shaderAddMat4Uniform(grid_shader_p, "view", view.getPointer());
     // Projection
-    float ortho_height = 30.0f;
+    float ortho_height = CAM_ORTHO_HEIGHT;
     float ortho_width = ortho_height * game_window.win_ar;
     Mat4F projection = getOrthoProjection(-ortho_width * 0.5f,
 					   ortho_width * 0.5f,
@@ -532,39 +928,32 @@ int
 platformLoadEntityTemplatesFromTxt(ActiveEntities& active_entities, c_char* path)
 {
     // Returns 1 on success, 0 on failure
+    if(!entityTemplatesLoadFromTxt(active_entities.entity_templates, path))
+    {
+	OutputDebugStringA("ERROR: Failed to load entity templates. File not found.\n");
+	return 0;
+    }
 
-    FILE* file_p = NULL;
-    fopen_s(&file_p, path, "r");
-    if(!file_p) {return 0;}
-
-    char  next[256];
-    int   entity_type;
-    int   component_type;
-    
-    do
+#if STATIC_ENTITY_TEMPLATES
+    // Component checks use the compiled signatures, so keep the table consistent with them
+    for(uint type = 0; type < TOTAL_ENTITY_TYPES; type++)
     {
-	// Get first string
-	fscanf_s(file_p, "%s", next, 256);
-	if(next[0] != '#')
+	for(uint component = 0; component < TOTAL_COMPONENT_TYPES; component++)
 	{
-	    // Read entity type
-	    fscanf_s(file_p, "%i", &entity_type);
-	    // Eat hyphen
-	    fscanf_s(file_p, "%s", next, 256);
-	    do
+	    uint compiled = entityTraitsHas(type, component);
+	    if(active_entities.entity_templates.table[type][component] != compiled)
 	    {
-		// Get component type
-		fscanf_s(file_p, "%i", &component_type);
-		if(component_type != -1) {active_entities.entity_templates.table[entity_type][component_type] = 1;}
-	    } while(component_type != -1);
+		// tests/test_templates.cpp catches this before a build ships
+		char msg[128];
+		sprintf_s(msg, "ERROR: Template file differs from entity_traits.hpp (type %u, component %u).\n",
+			  type, component);
+		OutputDebugStringA(msg);
+		_assert(false);
+		active_entities.entity_templates.table[type][component] = compiled;
+	    }
 	}
-	else
-	{
-	    // Eat line
-	    fgets(next, 512, file_p);
-	}
-    } while(!feof(file_p)); 
-    fclose(file_p);
+    }
+#endif
 
     return 1;
 }
@@ -0,0 +1,342 @@
+// ====================================================================================
+// Title: scheduler.cpp
+// Description: The source file for the system scheduler
+// ====================================================================================
+
+#include "scheduler.hpp"
+
+// Struct SystemScheduler //
+
+SystemScheduler::SystemScheduler()
+{
+    system_count   = 0;
+    level_count    = 0;
+    force_serial   = SCHEDULER_FORCE_SERIAL;
+    worker_count   = 0;
+    next_job       = 0;
+    jobs_remaining = 0;
+    quit           = false;
+    entities_p     = NULL;
+}
+
+SystemScheduler::~SystemScheduler()
+{
+    schedulerStopWorkers(*this);
+}
+
+static bool
+schedulerQueriesOverlap(const ActiveEntities& entities, uint query_a, uint query_b)
+{
+    // Returns true if any entity type matches both queries
+    uint bits = (1 << query_a) | (1 << query_b);
+    for(uint type = 0; type < TOTAL_ENTITY_TYPES; type++)
+    {
+	if((entities.type_queries[type] & bits) == bits) {return true;}
+    }
+    return false;
+}
+
+static bool
+schedulerSystemsConflict(const ActiveEntities& entities, const System& a, const System& b)
+{
+    uint conflicts = ((a.writes & (b.reads | b.writes)) |
+		      (b.writes & a.reads));
+    if(!conflicts) {return false;}
+    if(a.local && b.local && !schedulerQueriesOverlap(entities, a.query, b.query)) {return false;}
+    return true;
+}
+
+static void
+schedulerRunJob(const SystemScheduler& scheduler, const SystemJob& job, uint& visited, uint& touched)
+{
+    const System& system = scheduler.systems[job.system];
+    const ActiveEntities& entities = *scheduler.entities_p;
+    visited = 0;
+    touched = 0;
+    if(system.bitset > -1)
+    {
+	// Only the set bits of each word are visited
+	const uint64* live_p = entities.bitsets[BITSET_LIVE];
+	const uint64* tag_p  = entities.bitsets[system.bitset];
+	if(system.update_range)
+	{
+	    uint end_ID = job.end << 6;
+	    if(end_ID > entities.count) {end_ID = entities.count;}
+	    visited = bitsetCountAnd(live_p, tag_p, job.begin, job.end);
+	    touched = system.update_range(job.begin << 6, end_ID);
+	    return;
+	}
+	for(uint w = job.begin; w < job.end; w++)
+	{
+	    uint64 word = live_p[w] & tag_p[w];
+	    while(word)
+	    {
+		uint i = (w << 6) + bitsetPopLowest(word);
+		touched += system.update(i);
+		visited++;
+	    }
+	}
+	return;
+    }
+
+    const EntityQuery& query = entities.queries[system.query];
+    for(uint j = job.begin; j < job.end; j++)
+    {
+	uint i = query.ids[j];
+	if(activeEntitiesIsActive(entities, i))
+	{
+	    touched += system.update(i);
+	    visited++;
+	}
+    }
+}
+
+static uint
+schedulerGetJobCount(const System& system, const ActiveEntities& entities)
+{
+    // Number of query entries or bitset words the system's jobs cover
+    if(system.bitset > -1) {return bitsetWordCount(entities.count);}
+    return entities.queries[system.query].count;
+}
+
+static uint
+schedulerGetChunkSize(const System& system, uint count)
+{
+    // Query entries or bitset words per job
+    if(!system.chunk_size) {return count;}
+    if(system.bitset > -1) {return (system.chunk_size > 64) ? system.chunk_size / 64 : 1;}
+    return system.chunk_size;
+}
+
+static void
+schedulerWorkerLoop(SystemScheduler* scheduler_p)
+{
+    std::unique_lock<std::mutex> lock(scheduler_p->mutex);
+    while(true)
+    {
+	while(!scheduler_p->quit && scheduler_p->next_job >= scheduler_p->jobs.size())
+	{
+	    scheduler_p->work_cv.wait(lock);
+	}
+	if(scheduler_p->quit) {return;}
+
+	SystemJob job = scheduler_p->jobs[scheduler_p->next_job++];
+	uint visited, touched;
+	lock.unlock();
+	schedulerRunJob(*scheduler_p, job, visited, touched);
+	lock.lock();
+
+	scheduler_p->systems[job.system].visited += visited;
+	scheduler_p->systems[job.system].touched += touched;
+	scheduler_p->jobs_remaining--;
+	if(scheduler_p->jobs_remaining == 0) {scheduler_p->done_cv.notify_all();}
+    }
+}
+
+int
+schedulerRegisterSystem(SystemScheduler& scheduler,
+			c_char* name,
+			SystemBegin begin,
+			SystemUpdate update,
+			uint query,
+			uint reads,
+			uint writes,
+			bool local,
+			uint chunk_size)
+{
+    // Returns the index of the system, -1 on failure
+    _assert(update);
+    _assert(query < TOTAL_QUERIES);
+    if(scheduler.system_count >= MAX_SYSTEMS)
+    {
+	OutputDebugStringA("ERROR: Too many systems registered with the scheduler.\n");
+	return -1;
+    }
+
+    System& system      = scheduler.systems[scheduler.system_count];
+    system.name         = name;
+    system.begin        = begin;
+    system.update       = update;
+    system.update_range = NULL;
+    system.query        = query;
+    system.reads        = reads;
+    system.writes       = writes;
+    system.local        = local;
+    system.chunk_size   = chunk_size;
+    system.bitset       = -1;
+    system.dependencies = 0;
+    system.level        = 0;
+    system.visited      = 0;
+    system.touched      = 0;
+
+    return scheduler.system_count++;
+}
+
+void
+schedulerSetSystemBitset(SystemScheduler& scheduler, int system, int bitset)
+{
+    // Iterate bitset instead of the system's query list. Every entity of the system's
+    // query must have the bit set, as the update no longer sees the query.
+    _assert(system > -1 && system < (int)scheduler.system_count);
+    _assert(bitset >= -1 && bitset < TOTAL_ENTITY_BITSETS);
+    scheduler.systems[system].bitset = bitset;
+}
+
+void
+schedulerSetSystemRange(SystemScheduler& scheduler, int system, SystemUpdateRange update_range)
+{
+    // The range starts on a bitset word, so update_range can test the bits of a whole
+    // word or byte at once. Only valid for systems iterating a bitset.
+    _assert(system > -1 && system < (int)scheduler.system_count);
+    _assert(scheduler.systems[system].bitset > -1);
+    scheduler.systems[system].update_range = update_range;
+}
+
+void
+schedulerBuild(SystemScheduler& scheduler, const ActiveEntities& entities)
+{
+    // Build the dependency graph. A system depends on every earlier system it conflicts
+    // with, and runs in the wave after the last of its dependencies.
+    scheduler.level_count = 0;
+    for(uint j = 0; j < scheduler.system_count; j++)
+    {
+	System& system = scheduler.systems[j];
+	system.dependencies = 0;
+	system.level = 0;
+	for(uint i = 0; i < j; i++)
+	{
+	    if(schedulerSystemsConflict(entities, scheduler.systems[i], system))
+	    {
+		system.dependencies |= (1 << i);
+		if(scheduler.systems[i].level + 1 > system.level)
+		{
+		    system.level = scheduler.systems[i].level + 1;
+		}
+	    }
+	}
+	if(system.level + 1 > scheduler.level_count) {scheduler.level_count = system.level + 1;}
+    }
+}
+
+void
+schedulerStartWorkers(SystemScheduler& scheduler, uint worker_count)
+{
+    _assert(scheduler.worker_count == 0);
+    if(worker_count > MAX_WORKERS) {worker_count = MAX_WORKERS;}
+
+    scheduler.quit = false;
+    for(uint i = 0; i < worker_count; i++)
+    {
+	scheduler.workers[i] = std::thread(schedulerWorkerLoop, &scheduler);
+    }
+    scheduler.worker_count = worker_count;
+}
+
+void
+schedulerStopWorkers(SystemScheduler& scheduler)
+{
+    {
+	std::lock_guard<std::mutex> lock(scheduler.mutex);
+	scheduler.quit = true;
+    }
+    scheduler.work_cv.notify_all();
+    for(uint i = 0; i < scheduler.worker_count; i++)
+    {
+	scheduler.workers[i].join();
+    }
+    scheduler.worker_count = 0;
+}
+
+static void
+schedulerRunWaves(SystemScheduler& scheduler, const ActiveEntities& entities)
+{
+    for(uint level = 0; level < scheduler.level_count; level++)
+    {
+	// Every system of a wave has finished its dependencies, so begin callbacks can run
+	// before any of the wave's jobs are dispatched
+	std::unique_lock<std::mutex> lock(scheduler.mutex);
+	scheduler.jobs.clear();
+	for(uint s = 0; s < scheduler.system_count; s++)
+	{
+	    const System& system = scheduler.systems[s];
+	    if(system.level != level) {continue;}
+	    if(system.begin) {system.begin();}
+
+	    uint count = schedulerGetJobCount(system, entities);
+	    uint chunk_size = schedulerGetChunkSize(system, count);
+	    for(uint begin = 0; begin < count; begin += chunk_size)
+	    {
+		uint end = (count - begin > chunk_size) ? begin + chunk_size : count;
+		SystemJob job = {s, begin, end};
+		scheduler.jobs.push_back(job);
+	    }
+	}
+	if(scheduler.jobs.empty()) {continue;}
+	scheduler.next_job = 0;
+	scheduler.jobs_remaining = (uint)scheduler.jobs.size();
+	scheduler.work_cv.notify_all();
+
+	// The calling thread takes jobs alongside the workers
+	while(scheduler.next_job < scheduler.jobs.size())
+	{
+	    SystemJob job = scheduler.jobs[scheduler.next_job++];
+	    uint visited, touched;
+	    lock.unlock();
+	    schedulerRunJob(scheduler, job, visited, touched);
+	    lock.lock();
+	    scheduler.systems[job.system].visited += visited;
+	    scheduler.systems[job.system].touched += touched;
+	    scheduler.jobs_remaining--;
+	}
+	while(scheduler.jobs_remaining > 0)
+	{
+	    scheduler.done_cv.wait(lock);
+	}
+    }
+}
+
+void
+schedulerRun(SystemScheduler& scheduler, const ActiveEntities& entities)
+{
+    // Systems must not create or remove entities while running, structural changes are
+    // recorded to a command buffer and played back after the scheduler returns.
+    scheduler.entities_p = &entities;
+    for(uint s = 0; s < scheduler.system_count; s++)
+    {
+	scheduler.systems[s].visited = 0;
+	scheduler.systems[s].touched = 0;
+    }
+
+    if(scheduler.force_serial || scheduler.worker_count == 0)
+    {
+	for(uint s = 0; s < scheduler.system_count; s++)
+	{
+	    System& system = scheduler.systems[s];
+	    if(system.begin) {system.begin();}
+
+	    SystemJob job = {s, 0, schedulerGetJobCount(system, entities)};
+	    schedulerRunJob(scheduler, job, system.visited, system.touched);
+	}
+    }
+    else
+    {
+	schedulerRunWaves(scheduler, entities);
+    }
+
+#if SCHEDULER_PRINT_COUNTERS
+    schedulerPrintCounters(scheduler);
+#endif
+}
+
+void
+schedulerPrintCounters(const SystemScheduler& scheduler)
+{
+    char msg[PROFILER_MSG_LENGTH];
+    for(uint s = 0; s < scheduler.system_count; s++)
+    {
+	const System& system = scheduler.systems[s];
+	sprintf_s(msg, PROFILER_MSG_LENGTH, "%s - Visited: %u, Touched: %u\n",
+		  system.name, system.visited, system.touched);
+	OutputDebugStringA(msg);
+    }
+}
@@ -0,0 +1,89 @@
+// ====================================================================================
+// Title: test.hpp
+// Description: Checks & timers shared by the headless tests and benchmarks.
+//              Built & run by build/build_tests.bat
+// ====================================================================================
+
+#ifndef TEST_H
+#define TEST_H
+
+#include "ecs.hpp"
+#include "entity_traits.hpp"
+
+#include <stdio.h>
+#include <chrono>
+
+static int test_failures = 0;
+
+// Reports a failed check, the test keeps running so one run lists every failure
+#define TEST_CHECK(Expression) testCheck((Expression), #Expression, __FILE__, __LINE__)
+
+static void
+testCheck(bool passed, const char* expression, const char* file, int line)
+{
+    if(!passed)
+    {
+	printf("FAILED %s(%d): %s\n", file, line, expression);
+	test_failures++;
+    }
+}
+
+static int
+testFinish(const char* test_name)
+{
+    // Returns the process exit code, non-zero if any check failed
+    printf("%s: %s\n", test_name, (test_failures == 0) ? "passed" : "FAILED");
+    return (test_failures == 0) ? 0 : 1;
+}
+
+// Timing //
+
+typedef std::chrono::high_resolution_clock TestClock;
+
+static inline TestClock::time_point
+testTimerStart()
+{
+    return TestClock::now();
+}
+
+static inline double
+testTimerMs(TestClock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(TestClock::now() - start).count();
+}
+
+// Random //
+
+static uint test_random_state = 0x9E3779B9;
+
+static inline uint
+testRandom()
+{
+    // xorshift32, same sequence on every CRT
+    test_random_state ^= test_random_state << 13;
+    test_random_state ^= test_random_state >> 17;
+    test_random_state ^= test_random_state << 5;
+    return test_random_state;
+}
+
+// Setup //
+
+static ActiveEntities*
+testCreateEntities(RoomGridLookup& roomgrid_lookup)
+{
+    // ActiveEntities with the templates in entity_traits.hpp, so tests don't read data/
+    ActiveEntities* entities_p = new ActiveEntities();
+    for(uint type = 0; type < TOTAL_ENTITY_TYPES; type++)
+    {
+	for(uint component = 0; component < TOTAL_COMPONENT_TYPES; component++)
+	{
+	    entities_p->entity_templates.table[type][component] = entityTraitsHas(type, component);
+	}
+    }
+    activeEntitiesInitArchetypes(*entities_p);
+    activeEntitiesInitQueries(*entities_p);
+    roomGridLookupInit(roomgrid_lookup);
+    return entities_p;
+}
+
+#endif
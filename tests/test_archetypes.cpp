@@ -0,0 +1,244 @@
+// ====================================================================================
+// Title: test_archetypes.cpp
+// Description: Archetype chunks & entity columns against the fixed per-component
+//              arrays they replaced - committed memory and one frame of state,
+//              transform, camera & dir light updates at 10k, 100k & 1M entities
+// ====================================================================================
+
+#include "test.hpp"
+
+#define BENCH_FRAMES    8
+#define BENCH_CAMERAS   4   // Fewer than ten entities use the chunked components, like main()
+#define BENCH_DIRLIGHTS 4
+
+const uint BENCH_COUNTS[] = {10000, 100000, 1000000};
+
+// The layout before archetypes: every component an array of MAX_ENTITIES structs,
+// sized here to the entity count so both layouts hold the same entities
+typedef struct LegacyTransform
+{
+    Vec3F position;
+    Vec3F scale;
+} LegacyTransform;
+
+typedef struct LegacyGridPosition
+{
+    Vec3F position;
+    int roomgrid_owner_id;
+} LegacyGridPosition;
+
+typedef struct LegacyState
+{
+    bool inactive;
+    int input_cooldown;
+} LegacyState;
+
+typedef struct LegacyEntities
+{
+    uint*               types;
+    LegacyTransform*    transforms;
+    Camera*             cameras;
+    DirLight*           dir_lights;
+    PointLight*         point_lights;
+    LegacyGridPosition* grid_positions;
+    LegacyState*        states;
+    AI*                 ai;
+    int*                roomgrid_ids;
+    uint                count;
+} LegacyEntities;
+
+static size_t
+legacyEntitiesGetBytes(uint capacity)
+{
+    return (size_t)capacity * (sizeof(uint) + sizeof(LegacyTransform) + sizeof(Camera) +
+			       sizeof(DirLight) + sizeof(PointLight) + sizeof(LegacyGridPosition) +
+			       sizeof(LegacyState) + sizeof(AI) + sizeof(int));
+}
+
+static uint
+benchGetType(uint i)
+{
+    if(i < BENCH_CAMERAS)                   {return CAMERA;}
+    if(i < BENCH_CAMERAS + BENCH_DIRLIGHTS) {return DIR_LIGHT;}
+    return BLOCK;
+}
+
+static Vec3F
+benchGetOrigin(uint i)
+{
+    return Vec3F((float)(i % 20), (float)((i / 400) % 20), (float)((i / 20) % 20));
+}
+
+static void
+legacyEntitiesInit(LegacyEntities& entities, uint count)
+{
+    // The old constructor wrote every slot, so all of it is resident
+    entities.types          = new uint[count];
+    entities.transforms     = new LegacyTransform[count];
+    entities.cameras        = new Camera[count];
+    entities.dir_lights     = new DirLight[count];
+    entities.point_lights   = new PointLight[count];
+    entities.grid_positions = new LegacyGridPosition[count];
+    entities.states         = new LegacyState[count];
+    entities.ai             = new AI[count];
+    entities.roomgrid_ids   = new int[count];
+    entities.count          = count;
+    for(uint i = 0; i < count; i++)
+    {
+	entities.types[i] = benchGetType(i);
+	entities.transforms[i].position = benchGetOrigin(i);
+	entities.transforms[i].scale    = Vec3F(1.0f, 1.0f, 1.0f);
+	entities.grid_positions[i].position = benchGetOrigin(i);
+	entities.grid_positions[i].roomgrid_owner_id = -1;
+	entities.states[i].inactive = false;
+	entities.states[i].input_cooldown = (int)(i & 15);
+	entities.roomgrid_ids[i] = -1;
+    }
+}
+
+static void
+legacyEntitiesRelease(LegacyEntities& entities)
+{
+    delete[] entities.types;
+    delete[] entities.transforms;
+    delete[] entities.cameras;
+    delete[] entities.dir_lights;
+    delete[] entities.point_lights;
+    delete[] entities.grid_positions;
+    delete[] entities.states;
+    delete[] entities.ai;
+    delete[] entities.roomgrid_ids;
+}
+
+static void
+legacyEntitiesUpdate(LegacyEntities& entities, const EntityTemplates& templates, Vec3F base)
+{
+    // One loop over every entity, checking the template per system like gameUpdate did
+    for(uint i = 0; i < entities.count; i++)
+    {
+	if(entities.states[i].inactive) {continue;}
+	const uint* components = templates.table[entities.types[i]];
+	if(components[COMPONENT_STATE] && entities.states[i].input_cooldown > 0)
+	{
+	    entities.states[i].input_cooldown -= 1;
+	}
+	if(components[COMPONENT_GRID_POSITION])
+	{
+	    entities.transforms[i].position = entities.grid_positions[i].position + base;
+	}
+	if(components[COMPONENT_CAMERA])
+	{
+	    entities.cameras[i].dir = entities.cameras[i].target - entities.transforms[i].position;
+	}
+	if(components[COMPONENT_DIR_LIGHT])
+	{
+	    entities.dir_lights[i].dir = entities.dir_lights[i].target - entities.transforms[i].position;
+	}
+    }
+}
+
+static void
+chunkedEntitiesUpdate(ActiveEntities& entities, Vec3F base)
+{
+    // Each system walks its query, chunked components are read from their archetype
+    const EntityQuery& states = entities.queries[QUERY_STATE];
+    for(uint k = 0; k < states.count; k++)
+    {
+	State& state = entities.states[states.ids[k]];
+	if(state.input_cooldown > 0) {state.input_cooldown -= 1;}
+    }
+    const EntityQuery& grid = entities.queries[QUERY_GRID_POSITION];
+    for(uint k = 0; k < grid.count; k++)
+    {
+	uint i = grid.ids[k];
+	entities.transform_positions.x[i] = entities.grid_positions.x[i] + base.x;
+	entities.transform_positions.y[i] = entities.grid_positions.y[i] + base.y;
+	entities.transform_positions.z[i] = entities.grid_positions.z[i] + base.z;
+    }
+    const EntityQuery& cameras = entities.queries[QUERY_CAMERA];
+    for(uint k = 0; k < cameras.count; k++)
+    {
+	uint i = cameras.ids[k];
+	Camera* cam_p = (Camera*)activeEntitiesGetComponentP(entities, i, COMPONENT_CAMERA);
+	cam_p->dir = cam_p->target - vec3FColumnsGet(entities.transform_positions, i);
+    }
+    const EntityQuery& dir_lights = entities.queries[QUERY_DIR_LIGHT];
+    for(uint k = 0; k < dir_lights.count; k++)
+    {
+	uint i = dir_lights.ids[k];
+	DirLight* light_p = (DirLight*)activeEntitiesGetComponentP(entities, i, COMPONENT_DIR_LIGHT);
+	light_p->dir = light_p->target - vec3FColumnsGet(entities.transform_positions, i);
+    }
+}
+
+static void
+benchLayouts(uint count)
+{
+    // Same entities in both layouts, BLOCKs apart from a few cameras & dir lights
+    LegacyEntities legacy;
+    legacyEntitiesInit(legacy, count);
+
+    RoomGridLookup roomgrid_lookup;
+    ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+    ActiveEntities& entities = *entities_p;
+    std::vector<Vec3F> origins(count);
+    for(uint i = 0; i < count; i++) {origins[i] = benchGetOrigin(i);}
+    uint created = 0;
+    while(created < count)
+    {
+	uint type = benchGetType(created);
+	uint run = 1;
+	while(created + run < count && benchGetType(created + run) == type) {run++;}
+	TEST_CHECK(activeEntitiesCreateEntities(entities, roomgrid_lookup, -1, &origins[created], run, type, NULL));
+	created += run;
+    }
+    TEST_CHECK(entities.count == count);
+    for(uint i = 0; i < count; i++) {entities.states[i].input_cooldown = (int)(i & 15);}
+
+    // Best frame of each, alternating so both see the same cache & clock state
+    Vec3F base = Vec3F(0.5f, 0.0f, 0.5f);
+    double legacy_ms  = 1.0e30;
+    double chunked_ms = 1.0e30;
+    for(uint frame = 0; frame < BENCH_FRAMES; frame++)
+    {
+	TestClock::time_point start = testTimerStart();
+	legacyEntitiesUpdate(legacy, entities.entity_templates, base);
+	double ms = testTimerMs(start);
+	if(ms < legacy_ms) {legacy_ms = ms;}
+
+	start = testTimerStart();
+	chunkedEntitiesUpdate(entities, base);
+	ms = testTimerMs(start);
+	if(ms < chunked_ms) {chunked_ms = ms;}
+    }
+
+    // Both layouts computed the same frames
+    uint bad_entities = 0;
+    for(uint i = 0; i < count; i++)
+    {
+	if(!(vec3FColumnsGet(entities.transform_positions, i) == legacy.transforms[i].position) ||
+	   entities.states[i].input_cooldown != legacy.states[i].input_cooldown)
+	{
+	    bad_entities++;
+	}
+    }
+    TEST_CHECK(bad_entities == 0);
+
+    printf("%7u entities: fixed arrays %7.2f MB %7.3f ms/frame, archetypes %7.2f MB %7.3f ms/frame\n",
+	   count,
+	   legacyEntitiesGetBytes(count) / (1024.0 * 1024.0), legacy_ms,
+	   activeEntitiesGetCommittedBytes(entities) / (1024.0 * 1024.0), chunked_ms);
+
+    legacyEntitiesRelease(legacy);
+    delete entities_p;
+}
+
+int
+main()
+{
+    for(uint c = 0; c < sizeof(BENCH_COUNTS) / sizeof(BENCH_COUNTS[0]); c++)
+    {
+	benchLayouts(BENCH_COUNTS[c]);
+    }
+    return testFinish("test_archetypes");
+}
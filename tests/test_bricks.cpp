@@ -0,0 +1,144 @@
+// ====================================================================================
+// Title: test_bricks.cpp
+// Description: Sparse RoomGrid bricks - checked against a dense array, then memory &
+//              lookup latency for empty, typical & full rooms
+// ====================================================================================
+
+#include "test.hpp"
+
+#define ROOM_SIZE     20  // RG_DEFAULT_WIDTH, HEIGHT & LENGTH
+#define BENCH_LOOKUPS (1 << 22)
+
+typedef struct DenseGrid
+{
+    int grid[ROOM_SIZE][ROOM_SIZE][ROOM_SIZE];  // The layout bricks replaced
+} DenseGrid;
+
+static void
+testAgainstDense()
+{
+    RoomGrid* room_grid_p = new RoomGrid();
+    DenseGrid* dense_p = new DenseGrid;
+    memset(dense_p->grid, -1, sizeof(dense_p->grid));
+
+    uint bad_cells = 0;
+    for(uint i = 0; i < 200000; i++)
+    {
+	uint x = testRandom() % ROOM_SIZE;
+	uint y = testRandom() % ROOM_SIZE;
+	uint z = testRandom() % ROOM_SIZE;
+	Vec3F pos = Vec3F((float)x, (float)y, (float)z);
+	if(testRandom() % 3)
+	{
+	    int handle = (int)(testRandom() % 1000);
+	    roomGridSetEntity(*room_grid_p, pos, handle, 0);
+	    dense_p->grid[x][y][z] = handle;
+	}
+	else
+	{
+	    roomGridRemoveEntity(*room_grid_p, pos);
+	    dense_p->grid[x][y][z] = NO_ENTITY;
+	}
+	if(i % 5000 != 0) {continue;}
+
+	for(uint a = 0; a < ROOM_SIZE; a++)
+	{
+	    for(uint b = 0; b < ROOM_SIZE; b++)
+	    {
+		for(uint c = 0; c < ROOM_SIZE; c++)
+		{
+		    Vec3F cell_pos = Vec3F((float)a, (float)b, (float)c);
+		    if(roomGridGetEntity(*room_grid_p, cell_pos) != dense_p->grid[a][b][c]) {bad_cells++;}
+		}
+	    }
+	}
+    }
+    TEST_CHECK(bad_cells == 0);
+    TEST_CHECK(roomGridGetEntity(*room_grid_p, Vec3F((float)ROOM_SIZE, 0.0f, 0.0f)) == INVALID_RANGE);
+
+    // Emptied bricks are freed
+    for(uint x = 0; x < ROOM_SIZE; x++)
+    {
+	for(uint y = 0; y < ROOM_SIZE; y++)
+	{
+	    for(uint z = 0; z < ROOM_SIZE; z++) {roomGridRemoveEntity(*room_grid_p, Vec3F((float)x, (float)y, (float)z));}
+	}
+    }
+    RoomGrid empty_grid;
+    TEST_CHECK(roomGridGetMemory(*room_grid_p) == roomGridGetMemory(empty_grid));
+
+    delete dense_p;
+    delete room_grid_p;
+}
+
+static void
+benchRoom(const char* room_name, uint occupied_layers, uint extra_cells)
+{
+    // occupied_layers full y layers from y = 0, plus extra_cells scattered above them
+    RoomGrid* room_grid_p = new RoomGrid();
+    DenseGrid* dense_p = new DenseGrid;
+    memset(dense_p->grid, -1, sizeof(dense_p->grid));
+
+    uint occupied = 0;
+    for(uint x = 0; x < ROOM_SIZE; x++)
+    {
+	for(uint y = 0; y < occupied_layers; y++)
+	{
+	    for(uint z = 0; z < ROOM_SIZE; z++)
+	    {
+		roomGridSetEntity(*room_grid_p, Vec3F((float)x, (float)y, (float)z), (int)occupied, 0);
+		dense_p->grid[x][y][z] = (int)occupied++;
+	    }
+	}
+    }
+    for(uint i = 0; i < extra_cells; i++)
+    {
+	uint x = testRandom() % ROOM_SIZE;
+	uint y = occupied_layers + testRandom() % (ROOM_SIZE - occupied_layers);
+	uint z = testRandom() % ROOM_SIZE;
+	roomGridSetEntity(*room_grid_p, Vec3F((float)x, (float)y, (float)z), (int)occupied, 0);
+	dense_p->grid[x][y][z] = (int)occupied++;
+    }
+
+    std::vector<Vec3F> positions(BENCH_LOOKUPS);
+    for(uint i = 0; i < BENCH_LOOKUPS; i++)
+    {
+	// Most lookups are around the floor, like the push & pathing code
+	uint y = (i & 3) ? testRandom() % 3 : testRandom() % ROOM_SIZE;
+	positions[i] = Vec3F((float)(testRandom() % ROOM_SIZE), (float)y, (float)(testRandom() % ROOM_SIZE));
+    }
+
+    TestClock::time_point start = testTimerStart();
+    uint brick_sum = 0;
+    for(uint i = 0; i < BENCH_LOOKUPS; i++) {brick_sum += (uint)roomGridGetEntity(*room_grid_p, positions[i]);}
+    double brick_ms = testTimerMs(start);
+
+    start = testTimerStart();
+    uint dense_sum = 0;
+    for(uint i = 0; i < BENCH_LOOKUPS; i++)
+    {
+	const Vec3F& pos = positions[i];
+	dense_sum += (uint)dense_p->grid[(int)pos.x][(int)pos.y][(int)pos.z];
+    }
+    double dense_ms = testTimerMs(start);
+    TEST_CHECK(brick_sum == dense_sum);
+
+    // The dense grid holds no cell flags, with a byte per cell for them it would be 40000
+    uint dense_flagged = (uint)(sizeof(dense_p->grid) + ROOM_SIZE * ROOM_SIZE * ROOM_SIZE * sizeof(uchar));
+    printf("%-8s room: %4u cells, memory %6u bytes (dense %u, %u with flags), lookup %.2f ns (dense %.2f ns)\n",
+	   room_name, occupied, roomGridGetMemory(*room_grid_p), (uint)sizeof(dense_p->grid), dense_flagged,
+	   brick_ms * 1.0e6 / BENCH_LOOKUPS, dense_ms * 1.0e6 / BENCH_LOOKUPS);
+
+    delete dense_p;
+    delete room_grid_p;
+}
+
+int
+main()
+{
+    testAgainstDense();
+    benchRoom("Empty", 0, 0);
+    benchRoom("Typical", 1, 40);
+    benchRoom("Full", ROOM_SIZE, 0);
+    return testFinish("test_bricks");
+}
@@ -0,0 +1,188 @@
+// ====================================================================================
+// Title: test_clone_types.cpp
+// Description: Type queries on a RoomGrid clone - roomGridFindNearestType &
+//              roomGridGetFirstIDByType checked against a full cell scan while the
+//              clone's bricks are shared, partly unshared & written, then timed, &
+//              both timed on RoomGrids with more & more entities of the target type
+// ====================================================================================
+
+#include "test.hpp"
+
+#define QUERY_POSITIONS 2000
+#define BENCH_QUERIES   (1 << 16)
+
+const uint BENCH_TYPE_COUNTS[] = {1, 8, 64, 512, 4096};  // SPECIAL_BLOCKs in a 20x20x20 RoomGrid
+
+static Vec3F
+referenceNearestType(const RoomGrid& room_grid, const ActiveEntities& entities,
+		     Vec3F cur_pos, uint target_type, int& first_id)
+{
+    // Every cell in x, y, z order, so ties go to the earliest like the lists do
+    Vec3F best_pos = Vec3F((float)room_grid.width * 2, (float)room_grid.height * 2, (float)room_grid.length * 2);
+    float best_distance = FLT_MAX;
+    first_id = -1;
+    for(uint x = 0; x < room_grid.width; x++)
+    {
+	for(uint y = 0; y < room_grid.height; y++)
+	{
+	    for(uint z = 0; z < room_grid.length; z++)
+	    {
+		Vec3F pos = Vec3F((float)x, (float)y, (float)z);
+		int id = activeEntitiesGetID(entities, roomGridGetEntity(room_grid, pos));
+		if(id < 0 || entities.types[id] != target_type) {continue;}
+		if(first_id == -1) {first_id = id;}
+		Vec3F d = pos - cur_pos;
+		float distance = d.x * d.x + d.y * d.y + d.z * d.z;
+		if(distance > 0.0f && distance < best_distance)
+		{
+		    best_distance = distance;
+		    best_pos      = pos;
+		}
+	    }
+	}
+    }
+    return best_pos;
+}
+
+static uint
+checkTypeQueries(RoomGrid& room_grid, ActiveEntities& entities, uint target_type)
+{
+    // Returns the number of queries differing from the reference
+    uint bad_queries = 0;
+    for(uint i = 0; i < QUERY_POSITIONS; i++)
+    {
+	Vec3F cur_pos = Vec3F((float)(testRandom() % room_grid.width),
+			      (float)(testRandom() % room_grid.height),
+			      (float)(testRandom() % room_grid.length));
+	int first_id = -1;
+	Vec3F expected = referenceNearestType(room_grid, entities, cur_pos, target_type, first_id);
+	if(!(roomGridFindNearestType(room_grid, entities, cur_pos, target_type) == expected) ||
+	   roomGridGetFirstIDByType(&room_grid, &entities, target_type) != first_id)
+	{
+	    bad_queries++;
+	}
+    }
+    return bad_queries;
+}
+
+static double
+benchNearestType(RoomGrid& room_grid, ActiveEntities& entities, uint target_type)
+{
+    TestClock::time_point start = testTimerStart();
+    float sum = 0.0f;
+    for(uint i = 0; i < BENCH_QUERIES; i++)
+    {
+	Vec3F cur_pos = Vec3F((float)(i % room_grid.width), 1.0f, (float)((i / room_grid.width) % room_grid.length));
+	sum += roomGridFindNearestType(room_grid, entities, cur_pos, target_type).x;
+    }
+    double ms = testTimerMs(start);
+    TEST_CHECK(sum > 0.0f);
+    return ms * 1.0e6 / BENCH_QUERIES;
+}
+
+static void
+benchTypeCounts()
+{
+    // Both queries visit every entity of the target type, whatever else the RoomGrid holds
+    for(uint c = 0; c < sizeof(BENCH_TYPE_COUNTS) / sizeof(BENCH_TYPE_COUNTS[0]); c++)
+    {
+	RoomGridLookup roomgrid_lookup;
+	ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+	ActiveEntities& entities = *entities_p;
+	activeEntitiesCreateEntity(entities, roomgrid_lookup, -1, ROOMGRID_A, Vec3F(0.0f, 0.0f, 0.0f), BLOCK_ROOM);
+	RoomGrid& room_grid = *roomgrid_lookup.roomgrid_pointers[ROOMGRID_A];
+	std::vector<Vec3F> positions;
+	for(uint x = 0; x < room_grid.width; x++)
+	{
+	    for(uint y = 0; y < room_grid.height; y++)
+	    {
+		for(uint z = 0; z < room_grid.length; z++) {positions.push_back(Vec3F((float)x, (float)y, (float)z));}
+	    }
+	}
+	for(uint i = (uint)positions.size() - 1; i > 0; i--) {std::swap(positions[i], positions[testRandom() % (i + 1)]);}
+	uint count = BENCH_TYPE_COUNTS[c];
+	TEST_CHECK(activeEntitiesCreateEntities(entities, roomgrid_lookup, ROOMGRID_A, &positions[0],
+						count, SPECIAL_BLOCK, NULL));
+	TEST_CHECK(room_grid.type_lists[SPECIAL_BLOCK].handles.size() == count);
+	TEST_CHECK(checkTypeQueries(room_grid, entities, SPECIAL_BLOCK) == 0);
+
+	double nearest_ns = benchNearestType(room_grid, entities, SPECIAL_BLOCK);
+	TestClock::time_point start = testTimerStart();
+	int id_sum = 0;
+	for(uint i = 0; i < BENCH_QUERIES; i++) {id_sum += roomGridGetFirstIDByType(&room_grid, &entities, SPECIAL_BLOCK);}
+	double first_ns = testTimerMs(start) * 1.0e6 / BENCH_QUERIES;
+	TEST_CHECK(id_sum >= 0);
+	printf("%4u SPECIAL_BLOCKs: roomGridFindNearestType %.2f ns, roomGridGetFirstIDByType %.2f ns\n",
+	       count, nearest_ns, first_ns);
+
+	delete entities_p;
+    }
+}
+
+int
+main()
+{
+    // A floor of BLOCKs with SPECIAL_BLOCKs above it in the template, cloned into ROOMGRID_B
+    RoomGridLookup roomgrid_lookup;
+    ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+    ActiveEntities& entities = *entities_p;
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, -1, ROOMGRID_A, Vec3F(0.0f, 0.0f, 0.0f), BLOCK_ROOM);
+    TEST_CHECK(roomGridLookupAddTemplate(roomgrid_lookup, ROOMGRID_G));
+    std::vector<Vec3F> floor;
+    for(uint x = 0; x < RG_DEFAULT_WIDTH; x++)
+    {
+	for(uint z = 0; z < RG_DEFAULT_LENGTH; z++) {floor.push_back(Vec3F((float)x, 0.0f, (float)z));}
+    }
+    TEST_CHECK(activeEntitiesCreateEntities(entities, roomgrid_lookup, ROOMGRID_G, &floor[0],
+					    (uint)floor.size(), BLOCK, NULL));
+    for(uint i = 0; i < 12; i++)
+    {
+	Vec3F pos = Vec3F((float)(testRandom() % RG_DEFAULT_WIDTH), 1.0f, (float)(testRandom() % RG_DEFAULT_LENGTH));
+	if(roomGridGetEntity(*roomgrid_lookup.roomgrid_pointers[ROOMGRID_G], pos) != NO_ENTITY) {continue;}
+	activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_G, -1, pos, SPECIAL_BLOCK);
+    }
+    TEST_CHECK(activeEntitiesCreateRoomClone(entities, roomgrid_lookup, ROOMGRID_A, ROOMGRID_B, ROOMGRID_G,
+					     Vec3F(1.0f, 1.0f, 1.0f), BLOCK_ROOM));
+    RoomGrid& clone = *roomgrid_lookup.roomgrid_pointers[ROOMGRID_B];
+
+    // Every brick shared: the clone's own type lists are empty
+    TEST_CHECK(clone.type_lists[SPECIAL_BLOCK].handles.size() == 0);
+    TEST_CHECK(roomGridGetFirstIDByType(&clone, &entities, SPECIAL_BLOCK) > -1);
+    TEST_CHECK(checkTypeQueries(clone, entities, SPECIAL_BLOCK) == 0);
+    double shared_ns = benchNearestType(clone, entities, SPECIAL_BLOCK);
+
+    // Unshare half the bricks holding SPECIAL_BLOCKs, then move & remove copies
+    const RoomGridTypeList& template_list = roomgrid_lookup.roomgrid_pointers[ROOMGRID_G]->type_lists[SPECIAL_BLOCK];
+    std::vector<Vec3F> specials;
+    for(uint k = 0; k < template_list.handles.size(); k++)
+    {
+	specials.push_back(Vec3F(template_list.xs[k], template_list.ys[k], template_list.zs[k]));
+    }
+    for(uint k = 0; k < specials.size(); k += 2)
+    {
+	TEST_CHECK(roomGridPrepareWrite(clone, entities, roomgrid_lookup, specials[k]));
+    }
+    TEST_CHECK(clone.type_lists[SPECIAL_BLOCK].handles.size() > 0);
+    TEST_CHECK(checkTypeQueries(clone, entities, SPECIAL_BLOCK) == 0);
+    TEST_CHECK(checkTypeQueries(clone, entities, BLOCK) == 0);
+
+    int moved_handle = roomGridGetEntity(clone, specials[0]);
+    Vec3F moved_to = specials[0] + Vec3F(0.0f, 1.0f, 0.0f);
+    roomGridRemoveEntity(clone, specials[0]);
+    roomGridSetEntity(clone, moved_to, moved_handle, CELL_COLLISION | CELL_PUSHABLE);
+    activeEntitiesSetGridPosition(entities, roomgrid_lookup, activeEntitiesGetID(entities, moved_handle), moved_to);
+    if(specials.size() > 2) {roomGridRemoveEntity(clone, specials[2]);}
+    TEST_CHECK(checkTypeQueries(clone, entities, SPECIAL_BLOCK) == 0);
+
+    // The template is unchanged
+    TEST_CHECK(checkTypeQueries(*roomgrid_lookup.roomgrid_pointers[ROOMGRID_G], entities, SPECIAL_BLOCK) == 0);
+    TEST_CHECK(template_list.handles.size() == specials.size());
+
+    double unshared_ns = benchNearestType(clone, entities, SPECIAL_BLOCK);
+    printf("roomGridFindNearestType on a clone: %.2f ns all bricks shared, %.2f ns partly unshared\n",
+	   shared_ns, unshared_ns);
+
+    delete entities_p;
+    benchTypeCounts();
+    return testFinish("test_clone_types");
+}
@@ -0,0 +1,117 @@
+// ====================================================================================
+// Title: test_concurrent.cpp
+// Description: activeEntitiesCreateEntitiesConcurrent stress test - 16 threads create
+//              1M entities on top of a non-empty free list
+// ====================================================================================
+
+#include "test.hpp"
+
+#include <thread>
+
+#define STRESS_THREADS  16
+#define STRESS_ENTITIES 1000000
+#define STRESS_BATCH    100
+
+static void
+stressCreate(ActiveEntities* entities_p, uint thread, int* handles_p, uint* failures_p)
+{
+    // Alternates batches of BLOCKs & CAMERAs, recording the handles in creation order
+    uint per_thread = STRESS_ENTITIES / STRESS_THREADS;
+    Vec3F origins[STRESS_BATCH];
+    for(uint done = 0; done < per_thread; done += STRESS_BATCH)
+    {
+	uint batch = (per_thread - done < STRESS_BATCH) ? per_thread - done : STRESS_BATCH;
+	for(uint k = 0; k < batch; k++) {origins[k] = Vec3F((float)k, (float)thread, 0.0f);}
+	uint type = ((done / STRESS_BATCH) & 1) ? CAMERA : BLOCK;
+	if(!activeEntitiesCreateEntitiesConcurrent(*entities_p, -1, origins, batch, type, &handles_p[done]))
+	{
+	    (*failures_p)++;
+	}
+    }
+}
+
+int
+main()
+{
+    RoomGridLookup roomgrid_lookup;
+    ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+    ActiveEntities& entities = *entities_p;
+
+    // Removed entities leave indices on the free list, the concurrent path must use them
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, -1, ROOMGRID_A, Vec3F(0.0f, 0.0f, 0.0f), BLOCK_ROOM);
+    for(uint i = 0; i < 100; i++)
+    {
+	activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1, Vec3F((float)(i % 20), 0.0f, (float)(i / 20)), BLOCK);
+    }
+    for(uint i = 1; i < entities.count; i += 2) {activeEntitiesMarkInactive(entities, i);}
+    activeEntitiesRemoveInactives(entities, roomgrid_lookup);
+    uint base_count   = entities.count;
+    uint free_count   = entities.free_count;
+    uint sparse_count = entities.sparse_count;
+    TEST_CHECK(free_count == 50);
+
+    TEST_CHECK(activeEntitiesReserve(entities, entities.count + STRESS_ENTITIES));
+    TEST_CHECK(entities.columns.capacity >= sparse_count + STRESS_ENTITIES - free_count);
+
+    std::vector<int> handles(STRESS_ENTITIES, -1);
+    uint failures[STRESS_THREADS] = {};
+    std::vector<std::thread> threads;
+    TestClock::time_point start = testTimerStart();
+    for(uint t = 0; t < STRESS_THREADS; t++)
+    {
+	threads.push_back(std::thread(stressCreate, entities_p, t,
+				      &handles[t * (STRESS_ENTITIES / STRESS_THREADS)], &failures[t]));
+    }
+    for(uint t = 0; t < STRESS_THREADS; t++) {threads[t].join();}
+    double create_ms = testTimerMs(start);
+    for(uint t = 0; t < STRESS_THREADS; t++) {TEST_CHECK(failures[t] == 0);}
+
+    // Pending entities are only found through activeEntitiesGetPendingID
+    uint bad_pending = 0;
+    for(uint i = 0; i < STRESS_ENTITIES; i += 997)
+    {
+	if(activeEntitiesGetID(entities, handles[i]) != -1 ||
+	   activeEntitiesGetPendingID(entities, handles[i]) < (int)base_count)
+	{
+	    bad_pending++;
+	}
+    }
+    TEST_CHECK(bad_pending == 0);
+
+    // Creating past the reservation fails instead of writing uncommitted memory
+    uint unreserved = entities.columns.capacity - entities.count - entities.pending_count.load() + 1;
+    std::vector<Vec3F> extra_origins(unreserved);
+    TEST_CHECK(!activeEntitiesCreateEntitiesConcurrent(entities, -1, &extra_origins[0], unreserved, BLOCK, NULL));
+
+    start = testTimerStart();
+    activeEntitiesPublishCreated(entities, roomgrid_lookup);
+    double publish_ms = testTimerMs(start);
+    printf("Concurrent creation: %u entities on %u threads in %.3f ms, published in %.3f ms\n",
+	   STRESS_ENTITIES, STRESS_THREADS, create_ms, publish_ms);
+
+    TEST_CHECK(entities.count == base_count + STRESS_ENTITIES);
+    TEST_CHECK(entities.free_count == 0);
+    TEST_CHECK(entities.sparse_count == sparse_count + STRESS_ENTITIES - free_count);
+
+    // Every handle resolves to its own entity, rows & queries match
+    std::vector<uchar> seen(entities.count, 0);
+    uint bad_entities = 0;
+    for(uint i = 0; i < STRESS_ENTITIES; i++)
+    {
+	int id = activeEntitiesGetID(entities, handles[i]);
+	if(id < (int)base_count || seen[id]++ || entities.handles[id] != handles[i]) {bad_entities++;}
+    }
+    for(uint i = 0; i < entities.count; i++)
+    {
+	const Archetype& archetype = entities.archetypes[entities.type_archetypes[entities.types[i]]];
+	if(*archetypeGetEntityIDP(archetype, entities.archetype_rows[i]) != (int)i || !activeEntitiesIsActive(entities, i))
+	{
+	    bad_entities++;
+	}
+    }
+    TEST_CHECK(bad_entities == 0);
+    TEST_CHECK(entities.queries[QUERY_CAMERA].count + entities.queries[QUERY_RENDER].count == entities.count - 1);
+
+    delete entities_p;
+    return testFinish("test_concurrent");
+}
@@ -0,0 +1,238 @@
+// ====================================================================================
+// Title: test_creation.cpp
+// Description: Entity creation - per-call, bulk & command buffer paths compared &
+//              timed, plus bitset and entity column growth checks
+// ====================================================================================
+
+#include "test.hpp"
+
+#define BENCH_ROOMS 50
+#define FLOOR_SIZE  20  // Blocks per room side, 400 per room like main()
+
+typedef enum CreationPath
+{
+    CREATE_PER_CALL = 0,
+    CREATE_BULK,
+    CREATE_COMMAND_BUFFER,
+    TOTAL_CREATION_PATHS
+} CreationPath;
+
+static const char* CREATION_PATH_NAMES[TOTAL_CREATION_PATHS] = {"Per-call", "Bulk", "Command buffer"};
+
+static void
+testBitsets()
+{
+    // Ranges & counts against a plain bool array
+    const uint bit_count = 1000;
+    uint64 a[16] = {};
+    uint64 b[16] = {};
+    bool reference_a[bit_count] = {};
+    bool reference_b[bit_count] = {};
+    for(uint i = 0; i < 2000; i++)
+    {
+	uint begin = testRandom() % bit_count;
+	uint end = begin + testRandom() % (bit_count - begin + 1);
+	bool value = (testRandom() & 1) != 0;
+	bool to_a = (i & 1) != 0;
+	bitsetAssignRange(to_a ? a : b, begin, end, value);
+	for(uint j = begin; j < end; j++) {(to_a ? reference_a : reference_b)[j] = value;}
+    }
+
+    uint bad_bits = 0;
+    uint count_a = 0;
+    uint count_and = 0;
+    for(uint i = 0; i < bit_count; i++)
+    {
+	if(bitsetGet(a, i) != reference_a[i] || bitsetGet(b, i) != reference_b[i]) {bad_bits++;}
+	count_a += reference_a[i];
+	count_and += (reference_a[i] && reference_b[i]);
+    }
+    TEST_CHECK(bad_bits == 0);
+    TEST_CHECK(bitsetCount(a, 0, bitsetWordCount(bit_count)) == count_a);
+    TEST_CHECK(bitsetCountAnd(a, b, 0, bitsetWordCount(bit_count)) == count_and);
+    uint fallback_count = 0;
+    for(uint w = 0; w < bitsetWordCount(bit_count); w++) {fallback_count += bitsetCountWord(a[w]);}
+    TEST_CHECK(fallback_count == count_a);
+    TEST_CHECK(bitsetCountWord(~0ULL) == 64 && bitsetCountWord(0) == 0);
+
+    // Popping visits each set bit once, lowest first
+    uint popped = 0;
+    int last_bit = -1;
+    for(uint w = 0; w < bitsetWordCount(bit_count); w++)
+    {
+	uint64 word = a[w];
+	while(word)
+	{
+	    int bit = (int)(w * 64 + bitsetPopLowest(word));
+	    if(bit <= last_bit || !reference_a[bit]) {bad_bits++;}
+	    last_bit = bit;
+	    popped++;
+	}
+    }
+    TEST_CHECK(bad_bits == 0);
+    TEST_CHECK(popped == count_a);
+}
+
+static void
+testColumnGrowth()
+{
+    // Columns grow in place past several commit steps, values & tags survive removal
+    RoomGridLookup roomgrid_lookup;
+    ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+    ActiveEntities& entities = *entities_p;
+
+    float* positions_x_p = entities.transform_positions.x;
+    uint64* live_p = entities.bitsets[BITSET_LIVE];
+    Vec3F origins[1000];
+    for(uint i = 0; i < 1000; i++) {origins[i] = Vec3F((float)i, 0.0f, 0.0f);}
+    for(uint i = 0; i < 20; i++)
+    {
+	TEST_CHECK(activeEntitiesCreateEntities(entities, roomgrid_lookup, -1, origins, 1000, BLOCK, NULL));
+	activeEntitiesCreateEntity(entities, roomgrid_lookup, -1, -1, Vec3F(0.0f, 0.0f, 0.0f), CAMERA);
+    }
+    TEST_CHECK(entities.count == 20 * 1001);
+    TEST_CHECK(entities.columns.capacity >= entities.count);
+    TEST_CHECK(entities.transform_positions.x == positions_x_p);
+    TEST_CHECK(entities.bitsets[BITSET_LIVE] == live_p);
+
+    for(uint i = 0; i < entities.count; i += 3) {activeEntitiesMarkInactive(entities, i);}
+    activeEntitiesRemoveInactives(entities, roomgrid_lookup);
+
+    uint bad_entities = 0;
+    uint blocks = 0;
+    for(uint i = 0; i < bitsetWordCount(entities.columns.capacity) * 64; i++)
+    {
+	bool live = bitsetGet(entities.bitsets[BITSET_LIVE], i);
+	if(live != (i < entities.count)) {bad_entities++;}
+	if(i >= entities.count) {continue;}
+
+	bool is_block = (entities.types[i] == BLOCK);
+	blocks += is_block;
+	if(bitsetGet(entities.bitsets[BITSET_RENDER], i) != is_block ||
+	   bitsetGet(entities.bitsets[BITSET_COLLISION], i) != is_block)
+	{
+	    bad_entities++;
+	}
+	if(is_block && vec3FColumnsGet(entities.grid_positions, i).x >= 1000.0f) {bad_entities++;}
+    }
+    TEST_CHECK(bad_entities == 0);
+    TEST_CHECK(blocks == entities.queries[QUERY_RENDER].count);
+
+    delete entities_p;
+}
+
+static double
+createFloors(ActiveEntities& entities, RoomGridLookup& roomgrid_lookup, uint creation_path, int* room_ids)
+{
+    // BENCH_ROOMS rooms in ROOMGRID_A, each with a full floor. Returns the ms spent on floors.
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, -1, ROOMGRID_A, Vec3F(0.0f, 0.0f, 0.0f), BLOCK_ROOM);
+    for(uint r = 0; r < BENCH_ROOMS; r++)
+    {
+	room_ids[r] = roomGridLookupAddID(roomgrid_lookup);
+	Vec3F room_pos = Vec3F((float)(r % RG_DEFAULT_WIDTH), 1.0f, (float)(r / RG_DEFAULT_WIDTH));
+	activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, room_ids[r], room_pos, BLOCK_ROOM);
+    }
+
+    Vec3F origins[FLOOR_SIZE * FLOOR_SIZE];
+    for(uint x = 0; x < FLOOR_SIZE; x++)
+    {
+	for(uint z = 0; z < FLOOR_SIZE; z++) {origins[x * FLOOR_SIZE + z] = Vec3F((float)x, 0.0f, (float)z);}
+    }
+
+    EntityCommandBuffer buffer;
+    TestClock::time_point start = testTimerStart();
+    for(uint r = 0; r < BENCH_ROOMS; r++)
+    {
+	for(uint i = 0; i < FLOOR_SIZE * FLOOR_SIZE && creation_path != CREATE_BULK; i++)
+	{
+	    if(creation_path == CREATE_PER_CALL)
+	    {
+		activeEntitiesCreateEntity(entities, roomgrid_lookup, room_ids[r], -1, origins[i], BLOCK);
+	    }
+	    else
+	    {
+		entityCommandBufferCreate(buffer, room_ids[r], -1, origins[i], BLOCK);
+	    }
+	}
+	if(creation_path == CREATE_BULK)
+	{
+	    activeEntitiesCreateEntities(entities, roomgrid_lookup, room_ids[r], origins,
+					 FLOOR_SIZE * FLOOR_SIZE, BLOCK, NULL);
+	}
+    }
+    if(creation_path == CREATE_COMMAND_BUFFER) {entityCommandBufferPlayback(buffer, entities, roomgrid_lookup);}
+    return testTimerMs(start);
+}
+
+static void
+testCreationPaths()
+{
+    // Every path fills the same cells, then timings are compared
+    for(uint path = 0; path < TOTAL_CREATION_PATHS; path++)
+    {
+	RoomGridLookup roomgrid_lookup;
+	ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+	ActiveEntities& entities = *entities_p;
+	int room_ids[BENCH_ROOMS];
+
+	double floor_ms = createFloors(entities, roomgrid_lookup, path, room_ids);
+	printf("%s creation: %u entities in %.3f ms\n",
+	       CREATION_PATH_NAMES[path], BENCH_ROOMS * FLOOR_SIZE * FLOOR_SIZE, floor_ms);
+
+	TEST_CHECK(entities.count == 1 + BENCH_ROOMS + BENCH_ROOMS * FLOOR_SIZE * FLOOR_SIZE);
+	uint bad_cells = 0;
+	for(uint r = 0; r < BENCH_ROOMS; r++)
+	{
+	    const RoomGrid& room_grid = *roomgrid_lookup.roomgrid_pointers[room_ids[r]];
+	    for(uint x = 0; x < FLOOR_SIZE; x++)
+	    {
+		for(uint z = 0; z < FLOOR_SIZE; z++)
+		{
+		    Vec3F pos = Vec3F((float)x, 0.0f, (float)z);
+		    int id = activeEntitiesGetID(entities, roomGridGetEntity(room_grid, pos));
+		    if(id < 0 || entities.types[id] != BLOCK || entities.roomgrid_owner_ids[id] != room_ids[r] ||
+		       !(vec3FColumnsGet(entities.grid_positions, id) == pos))
+		    {
+			bad_cells++;
+		    }
+		}
+	    }
+	}
+	TEST_CHECK(bad_cells == 0);
+
+	// Recorded moves & destroys apply at playback, destroys before moves
+	const RoomGrid& room_grid = *roomgrid_lookup.roomgrid_pointers[room_ids[0]];
+	int moved = roomGridGetEntity(room_grid, Vec3F(3.0f, 0.0f, 0.0f));
+	int destroyed = roomGridGetEntity(room_grid, Vec3F(4.0f, 0.0f, 0.0f));
+	EntityCommandBuffer buffer;
+	entityCommandBufferMove(buffer, moved, Vec3F(3.0f, 1.0f, 0.0f));
+	entityCommandBufferDestroy(buffer, destroyed);
+	TEST_CHECK(roomGridGetEntity(room_grid, Vec3F(3.0f, 0.0f, 0.0f)) == moved);
+	entityCommandBufferPlayback(buffer, entities, roomgrid_lookup);
+	activeEntitiesRemoveInactives(entities, roomgrid_lookup);
+	TEST_CHECK(roomGridGetEntity(room_grid, Vec3F(3.0f, 1.0f, 0.0f)) == moved);
+	TEST_CHECK(roomGridGetEntity(room_grid, Vec3F(3.0f, 0.0f, 0.0f)) == NO_ENTITY);
+	TEST_CHECK(roomGridGetEntity(room_grid, Vec3F(4.0f, 0.0f, 0.0f)) == NO_ENTITY);
+	TEST_CHECK(activeEntitiesGetID(entities, destroyed) == -1);
+	TEST_CHECK(vec3FColumnsGet(entities.grid_positions, activeEntitiesGetID(entities, moved)) == Vec3F(3.0f, 1.0f, 0.0f));
+
+	// A move onto an occupied cell is reported & dropped
+	int blocker = roomGridGetEntity(room_grid, Vec3F(5.0f, 0.0f, 0.0f));
+	entityCommandBufferMove(buffer, moved, Vec3F(5.0f, 0.0f, 0.0f));
+	entityCommandBufferPlayback(buffer, entities, roomgrid_lookup);
+	TEST_CHECK(roomGridGetEntity(room_grid, Vec3F(3.0f, 1.0f, 0.0f)) == moved);
+	TEST_CHECK(roomGridGetEntity(room_grid, Vec3F(5.0f, 0.0f, 0.0f)) == blocker);
+	TEST_CHECK(buffer.commands.size() == 0);
+
+	delete entities_p;
+    }
+}
+
+int
+main()
+{
+    testBitsets();
+    testColumnGrowth();
+    testCreationPaths();
+    return testFinish("test_creation");
+}
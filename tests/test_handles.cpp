@@ -0,0 +1,140 @@
+// ====================================================================================
+// Title: test_handles.cpp
+// Description: Generational entity handles - stale handle checks, plus removal &
+//              lookup benchmarks over 100k RoomGrid entities
+// ====================================================================================
+
+#include "test.hpp"
+
+#define BENCH_WIDTH   100
+#define BENCH_HEIGHT  10
+#define BENCH_LENGTH  100
+#define BENCH_ENTITIES (BENCH_WIDTH * BENCH_HEIGHT * BENCH_LENGTH)
+#define BENCH_LOOKUPS  (1 << 22)
+
+static void
+testStaleHandles()
+{
+    RoomGridLookup roomgrid_lookup;
+    ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+    ActiveEntities& entities = *entities_p;
+
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, -1, ROOMGRID_A, Vec3F(0.0f, 0.0f, 0.0f), BLOCK_ROOM);
+    int first = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1, Vec3F(1.0f, 0.0f, 1.0f), BLOCK);
+    int second = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1, Vec3F(2.0f, 0.0f, 1.0f), BLOCK);
+    TEST_CHECK(activeEntitiesGetID(entities, first) > -1);
+
+    // Removing the first entity moves the second into its ID, the second's handle follows
+    activeEntitiesMarkInactive(entities, activeEntitiesGetID(entities, first));
+    activeEntitiesRemoveInactives(entities, roomgrid_lookup);
+    TEST_CHECK(activeEntitiesGetID(entities, first) == -1);
+    TEST_CHECK(activeEntitiesGetID(entities, second) > -1);
+    TEST_CHECK(roomGridGetEntity(*roomgrid_lookup.roomgrid_pointers[ROOMGRID_A], Vec3F(1.0f, 0.0f, 1.0f)) == NO_ENTITY);
+    TEST_CHECK(roomGridGetEntity(*roomgrid_lookup.roomgrid_pointers[ROOMGRID_A], Vec3F(2.0f, 0.0f, 1.0f)) == second);
+
+    // Reuse one index until its generation wraps. No old handle may resolve again.
+    std::vector<int> old_handles;
+    old_handles.push_back(first);
+    uint first_index = entityHandleGetIndex(first);
+    bool index_retired = false;
+    for(uint i = 0; i < (1 << HANDLE_GENERATION_BITS) + 1; i++)
+    {
+	int handle = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1, Vec3F(1.0f, 0.0f, 1.0f), BLOCK);
+	for(uint j = 0; j < old_handles.size(); j += 97)
+	{
+	    TEST_CHECK(old_handles[j] != handle);
+	}
+	TEST_CHECK(old_handles.back() != handle);
+	if(entityHandleGetIndex(handle) != first_index) {index_retired = true;}
+
+	activeEntitiesMarkInactive(entities, activeEntitiesGetID(entities, handle));
+	activeEntitiesRemoveInactives(entities, roomgrid_lookup);
+	TEST_CHECK(activeEntitiesGetID(entities, handle) == -1);
+	old_handles.push_back(handle);
+    }
+    TEST_CHECK(index_retired);
+    TEST_CHECK(activeEntitiesGetID(entities, second) > -1);
+
+    delete entities_p;
+}
+
+static void
+benchRemoval()
+{
+    // Half of 100k RoomGrid entities die in one frame
+    RoomGridLookup roomgrid_lookup;
+    ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+    ActiveEntities& entities = *entities_p;
+
+    roomGridLookupSetExtents(roomgrid_lookup, ROOMGRID_A, BENCH_WIDTH, BENCH_HEIGHT, BENCH_LENGTH);
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, -1, ROOMGRID_A, Vec3F(0.0f, 0.0f, 0.0f), BLOCK_ROOM);
+
+    std::vector<Vec3F> origins;
+    origins.reserve(BENCH_ENTITIES);
+    for(uint x = 0; x < BENCH_WIDTH; x++)
+    {
+	for(uint y = 0; y < BENCH_HEIGHT; y++)
+	{
+	    for(uint z = 0; z < BENCH_LENGTH; z++) {origins.push_back(Vec3F((float)x, (float)y, (float)z));}
+	}
+    }
+    std::vector<int> handles(BENCH_ENTITIES);
+    TEST_CHECK(activeEntitiesCreateEntities(entities, roomgrid_lookup, ROOMGRID_A, &origins[0],
+					    BENCH_ENTITIES, BLOCK, &handles[0]));
+
+    for(uint i = 0; i < BENCH_ENTITIES; i += 2)
+    {
+	activeEntitiesMarkInactive(entities, activeEntitiesGetID(entities, handles[i]));
+    }
+    TestClock::time_point start = testTimerStart();
+    activeEntitiesRemoveInactives(entities, roomgrid_lookup);
+    double removal_ms = testTimerMs(start);
+    printf("Removal: %u of %u entities in %.3f ms (%.1f ns per entity)\n",
+	   BENCH_ENTITIES / 2, BENCH_ENTITIES, removal_ms, removal_ms * 1.0e6 / (BENCH_ENTITIES / 2));
+
+    // Survivors keep their cells & handles, removed entities left empty cells
+    const RoomGrid& room_grid = *roomgrid_lookup.roomgrid_pointers[ROOMGRID_A];
+    uint bad_cells = 0;
+    for(uint i = 0; i < BENCH_ENTITIES; i++)
+    {
+	int cell_handle = roomGridGetEntity(room_grid, origins[i]);
+	if(i % 2 == 0)
+	{
+	    if(cell_handle != NO_ENTITY || activeEntitiesGetID(entities, handles[i]) != -1) {bad_cells++;}
+	    continue;
+	}
+	int id = activeEntitiesGetID(entities, handles[i]);
+	if(cell_handle != handles[i] || id < 0 || !(vec3FColumnsGet(entities.grid_positions, id) == origins[i]))
+	{
+	    bad_cells++;
+	}
+    }
+    TEST_CHECK(bad_cells == 0);
+    TEST_CHECK(entities.count == BENCH_ENTITIES / 2 + 1);
+
+    // Lookup: random live & stale handles through the sparse-to-dense table
+    std::vector<int> lookups(BENCH_LOOKUPS);
+    for(uint i = 0; i < BENCH_LOOKUPS; i++)
+    {
+	lookups[i] = handles[testRandom() % BENCH_ENTITIES];
+    }
+    start = testTimerStart();
+    int found = 0;
+    for(uint i = 0; i < BENCH_LOOKUPS; i++)
+    {
+	found += (activeEntitiesGetID(entities, lookups[i]) > -1);
+    }
+    double lookup_ms = testTimerMs(start);
+    printf("Lookup: %u handles (%d live) in %.3f ms (%.2f ns per lookup)\n",
+	   BENCH_LOOKUPS, found, lookup_ms, lookup_ms * 1.0e6 / BENCH_LOOKUPS);
+
+    delete entities_p;
+}
+
+int
+main()
+{
+    testStaleHandles();
+    benchRemoval();
+    return testFinish("test_handles");
+}
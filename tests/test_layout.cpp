@@ -0,0 +1,154 @@
+// ====================================================================================
+// Title: test_layout.cpp
+// Description: RoomGrid brick cell layout - index helper checks, then neighbour scan &
+//              full-room sweep timings. build_tests.bat builds it with
+//              ROOMGRID_MORTON_CELLS 0 & 1 to compare the linear & Morton layouts.
+// ====================================================================================
+
+#include "test.hpp"
+
+#define BENCH_ROOMS   64  // Full 20x20x20 rooms, ~2.7 MB of bricks
+#define BENCH_PROBES  (1 << 18)
+#define BENCH_SWEEPS  4
+
+static uint
+referenceMortonEncode(uint x, uint y, uint z)
+{
+    // Bit by bit interleave, x highest
+    uint code = 0;
+    for(uint bit = 0; bit < 2; bit++)
+    {
+	code |= ((x >> bit) & 1) << (bit * 3 + 2);
+	code |= ((y >> bit) & 1) << (bit * 3 + 1);
+	code |= ((z >> bit) & 1) << (bit * 3 + 0);
+    }
+    return code;
+}
+
+static void
+testIndexHelpers()
+{
+    uint bad_codes = 0;
+    for(uint x = 0; x < RG_BRICK_SIZE; x++)
+    {
+	for(uint y = 0; y < RG_BRICK_SIZE; y++)
+	{
+	    for(uint z = 0; z < RG_BRICK_SIZE; z++)
+	    {
+		uint code = roomGridMortonEncode(x, y, z);
+		uint dx, dy, dz;
+		roomGridMortonDecode(code, dx, dy, dz);
+		if(code != referenceMortonEncode(x, y, z) || dx != x || dy != y || dz != z) {bad_codes++;}
+	    }
+	}
+    }
+    TEST_CHECK(bad_codes == 0);
+
+    // Every cell of odd-sized rooms maps to one brick & cell and back
+    uint extents[][3] = {{20, 20, 20}, {7, 3, 9}, {5, 5, 5}};
+    for(uint e = 0; e < 3; e++)
+    {
+	RoomGrid* room_grid_p = new RoomGrid(extents[e][0], extents[e][1], extents[e][2]);
+	std::vector<uchar> used(room_grid_p->brick_count * RG_BRICK_CELLS, 0);
+	uint bad_cells = 0;
+	for(uint x = 0; x < room_grid_p->width; x++)
+	{
+	    for(uint y = 0; y < room_grid_p->height; y++)
+	    {
+		for(uint z = 0; z < room_grid_p->length; z++)
+		{
+		    uint brick = roomGridGetBrickIndex(*room_grid_p, x, y, z);
+		    uint cell  = roomGridGetBrickCell(x, y, z);
+		    if(used[brick * RG_BRICK_CELLS + cell]++ ||
+		       !(roomGridGetCellPosition(*room_grid_p, brick, cell) == Vec3F((float)x, (float)y, (float)z)))
+		    {
+			bad_cells++;
+		    }
+		}
+	    }
+	}
+	TEST_CHECK(bad_cells == 0);
+	delete room_grid_p;
+    }
+}
+
+static void
+benchLayout()
+{
+    std::vector<RoomGrid*> rooms(BENCH_ROOMS);
+    for(uint r = 0; r < BENCH_ROOMS; r++)
+    {
+	rooms[r] = new RoomGrid();
+	for(uint x = 0; x < RG_DEFAULT_WIDTH; x++)
+	{
+	    for(uint y = 0; y < RG_DEFAULT_HEIGHT; y++)
+	    {
+		for(uint z = 0; z < RG_DEFAULT_LENGTH; z++)
+		{
+		    int handle = (int)(testRandom() & 0xFFFF);
+		    roomGridSetEntity(*rooms[r], Vec3F((float)x, (float)y, (float)z), handle, 0);
+		}
+	    }
+	}
+    }
+
+    // Neighbour scan: the 3x3x3 block around random cells, like pathing & pushes
+    std::vector<uint> probes(BENCH_PROBES);
+    for(uint i = 0; i < BENCH_PROBES; i++) {probes[i] = testRandom();}
+    TestClock::time_point start = testTimerStart();
+    uint neighbour_sum = 0;
+    for(uint i = 0; i < BENCH_PROBES; i++)
+    {
+	const RoomGrid& room_grid = *rooms[probes[i] % BENCH_ROOMS];
+	int cx = 1 + (int)((probes[i] >> 6) % (RG_DEFAULT_WIDTH - 2));
+	int cy = 1 + (int)((probes[i] >> 11) % (RG_DEFAULT_HEIGHT - 2));
+	int cz = 1 + (int)((probes[i] >> 16) % (RG_DEFAULT_LENGTH - 2));
+	for(int x = cx - 1; x <= cx + 1; x++)
+	{
+	    for(int y = cy - 1; y <= cy + 1; y++)
+	    {
+		for(int z = cz - 1; z <= cz + 1; z++)
+		{
+		    neighbour_sum += (uint)roomGridGetEntity(room_grid, Vec3F((float)x, (float)y, (float)z));
+		}
+	    }
+	}
+    }
+    double neighbour_ms = testTimerMs(start);
+
+    // Full-room sweep in x, y, z order
+    start = testTimerStart();
+    uint sweep_sum = 0;
+    for(uint s = 0; s < BENCH_SWEEPS; s++)
+    {
+	for(uint r = 0; r < BENCH_ROOMS; r++)
+	{
+	    for(uint x = 0; x < RG_DEFAULT_WIDTH; x++)
+	    {
+		for(uint y = 0; y < RG_DEFAULT_HEIGHT; y++)
+		{
+		    for(uint z = 0; z < RG_DEFAULT_LENGTH; z++)
+		    {
+			sweep_sum += (uint)roomGridGetEntity(*rooms[r], Vec3F((float)x, (float)y, (float)z));
+		    }
+		}
+	    }
+	}
+    }
+    double sweep_ms = testTimerMs(start);
+    uint swept_cells = BENCH_SWEEPS * BENCH_ROOMS * RG_DEFAULT_WIDTH * RG_DEFAULT_HEIGHT * RG_DEFAULT_LENGTH;
+    TEST_CHECK(sweep_sum != 0 && neighbour_sum != 0);
+
+    printf("ROOMGRID_MORTON_CELLS %d: neighbour scan %.2f ns per cell, full-room sweep %.2f ns per cell\n",
+	   ROOMGRID_MORTON_CELLS, neighbour_ms * 1.0e6 / (BENCH_PROBES * 27.0), sweep_ms * 1.0e6 / swept_cells);
+
+    for(uint r = 0; r < BENCH_ROOMS; r++) {delete rooms[r];}
+}
+
+int
+main()
+{
+    testIndexHelpers();
+    benchLayout();
+    return testFinish("test_layout");
+}
@@ -0,0 +1,165 @@
+// ====================================================================================
+// Title: test_push.cpp
+// Description: Push resolution - roomGridMoveEntities on a chain, a blocked chain, a
+//              chain into a BLOCK_ROOM & a line that reaches its own cells again, then
+//              the scan of a long chain timed
+// ====================================================================================
+
+#include "test.hpp"
+
+#define BENCH_ROUNDS 64
+#define BENCH_WIDTH  RG_MAX_EXTENT  // The chain runs along x from 0 & leaves a cell to end in
+
+static Vec3F
+gridPos(const ActiveEntities& entities, int handle)
+{
+    int id = activeEntitiesGetID(entities, handle);
+    return (id > -1) ? vec3FColumnsGet(entities.grid_positions, id) : Vec3F(-1.0f, -1.0f, -1.0f);
+}
+
+static int
+ownerID(const ActiveEntities& entities, int handle)
+{
+    int id = activeEntitiesGetID(entities, handle);
+    return (id > -1) ? entities.roomgrid_owner_ids[id] : -1;
+}
+
+static bool
+isDirty(const ActiveEntities& entities, int handle)
+{
+    int id = activeEntitiesGetID(entities, handle);
+    return id > -1 && bitsetGet(entities.bitsets[BITSET_GRID_DIRTY], id);
+}
+
+static void
+benchChain()
+{
+    RoomGridLookup roomgrid_lookup;
+    ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+    ActiveEntities& entities = *entities_p;
+    roomGridLookupSetExtents(roomgrid_lookup, ROOMGRID_A, BENCH_WIDTH, 1, 1);
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, -1, ROOMGRID_A, Vec3F(0.0f, 0.0f, 0.0f), BLOCK_ROOM);
+    RoomGrid& room_grid = *roomgrid_lookup.roomgrid_pointers[ROOMGRID_A];
+    std::vector<Vec3F> positions;
+    for(uint x = 0; x < BENCH_WIDTH - 1; x++) {positions.push_back(Vec3F((float)x, 0.0f, 0.0f));}
+    TEST_CHECK(activeEntitiesCreateEntities(entities, roomgrid_lookup, ROOMGRID_A, &positions[0],
+					    (uint)positions.size(), SPECIAL_BLOCK, NULL));
+
+    // Each pushed entity's cell is checked against the line once, so the scan stays
+    // linear in the chain's length
+    std::vector<GridMove> moves;
+    double best_ms = 1.0e30;
+    uint moved = 0;
+    for(uint round = 0; round < BENCH_ROUNDS; round++)
+    {
+	TestClock::time_point start = testTimerStart();
+	TEST_CHECK(roomGridGetPushLine(room_grid, entities, roomgrid_lookup, Vec3F(0.0f, 0.0f, 0.0f),
+				       Vec3F(1.0f, 0.0f, 0.0f), moves));
+	double ms = testTimerMs(start);
+	if(ms < best_ms) {best_ms = ms;}
+	moved = (uint)moves.size();
+    }
+    TEST_CHECK(moved == BENCH_WIDTH - 1);
+    printf("%u long chain: push line scanned in %.2f us, %.2f ns/entity\n",
+	   moved, best_ms * 1.0e3, best_ms * 1.0e6 / moved);
+
+    delete entities_p;
+}
+
+int
+main()
+{
+    // ROOMGRID_A holds a row per case along x, ROOMGRID_B & ROOMGRID_C are held in it
+    RoomGridLookup roomgrid_lookup;
+    ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+    ActiveEntities& entities = *entities_p;
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, -1, ROOMGRID_A, Vec3F(0.0f, 0.0f, 0.0f), BLOCK_ROOM);
+    RoomGrid& room_a = *roomgrid_lookup.roomgrid_pointers[ROOMGRID_A];
+    std::vector<GridMove> moves;
+
+    // Chain: the mover pushes three SPECIAL_BLOCKs a cell along
+    int mover = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1, Vec3F(2.0f, 1.0f, 2.0f), SPECIAL_BLOCK);
+    int chain[3];
+    for(uint k = 0; k < 3; k++)
+    {
+	chain[k] = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1,
+					      Vec3F(3.0f + k, 1.0f, 2.0f), SPECIAL_BLOCK);
+    }
+    bitsetAssignRange(entities.bitsets[BITSET_GRID_DIRTY], 0, entities.count, false);
+    TEST_CHECK(roomGridMoveEntities(room_a, entities, roomgrid_lookup, Vec3F(2.0f, 1.0f, 2.0f),
+				    Vec3F(3.0f, 1.0f, 2.0f), moves));
+    TEST_CHECK(moves.size() == 4);
+    TEST_CHECK(gridPos(entities, mover) == Vec3F(3.0f, 1.0f, 2.0f) && isDirty(entities, mover));
+    for(uint k = 0; k < 3; k++)
+    {
+	TEST_CHECK(gridPos(entities, chain[k]) == Vec3F(4.0f + k, 1.0f, 2.0f) && isDirty(entities, chain[k]));
+	TEST_CHECK(roomGridGetEntity(room_a, Vec3F(4.0f + k, 1.0f, 2.0f)) == chain[k]);
+    }
+    TEST_CHECK(roomGridGetCell(room_a, Vec3F(2.0f, 1.0f, 2.0f)) < 0);
+
+    // Blocked chain: a BLOCK at the far end stops the line & nothing moves
+    mover = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1, Vec3F(2.0f, 1.0f, 4.0f), SPECIAL_BLOCK);
+    for(uint k = 0; k < 2; k++)
+    {
+	chain[k] = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1,
+					      Vec3F(3.0f + k, 1.0f, 4.0f), SPECIAL_BLOCK);
+    }
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1, Vec3F(5.0f, 1.0f, 4.0f), BLOCK);
+    TEST_CHECK(!roomGridMoveEntities(room_a, entities, roomgrid_lookup, Vec3F(2.0f, 1.0f, 4.0f),
+				     Vec3F(3.0f, 1.0f, 4.0f), moves));
+    TEST_CHECK(gridPos(entities, mover) == Vec3F(2.0f, 1.0f, 4.0f));
+    TEST_CHECK(gridPos(entities, chain[0]) == Vec3F(3.0f, 1.0f, 4.0f));
+    TEST_CHECK(gridPos(entities, chain[1]) == Vec3F(4.0f, 1.0f, 4.0f));
+
+    // Chain into a room: the BLOCK_ROOM holding ROOMGRID_B is blocked, so the
+    // SPECIAL_BLOCK pushed onto it enters ROOMGRID_B at the middle of its facing side
+    mover = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1, Vec3F(2.0f, 1.0f, 6.0f), SPECIAL_BLOCK);
+    int entering = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1, Vec3F(3.0f, 1.0f, 6.0f), SPECIAL_BLOCK);
+    int holder = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, ROOMGRID_B, Vec3F(4.0f, 1.0f, 6.0f), BLOCK_ROOM);
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1, Vec3F(5.0f, 1.0f, 6.0f), BLOCK);
+    RoomGrid& room_b = *roomgrid_lookup.roomgrid_pointers[ROOMGRID_B];
+    Vec3F entry = Vec3F(0.0f, 1.0f, (float)(RG_DEFAULT_LENGTH / 2));
+    TEST_CHECK(roomGridMoveEntities(room_a, entities, roomgrid_lookup, Vec3F(2.0f, 1.0f, 6.0f),
+				    Vec3F(3.0f, 1.0f, 6.0f), moves));
+    TEST_CHECK(moves.size() == 2);
+    TEST_CHECK(gridPos(entities, mover) == Vec3F(3.0f, 1.0f, 6.0f));
+    TEST_CHECK(gridPos(entities, entering) == entry);
+    TEST_CHECK(ownerID(entities, entering) == ROOMGRID_B);
+    TEST_CHECK(roomGridGetEntity(room_b, entry) == entering);
+    TEST_CHECK(gridPos(entities, holder) == Vec3F(4.0f, 1.0f, 6.0f));
+
+    // A line reaching its own cells again: the mover enters ROOMGRID_C, pushes its row
+    // into a BLOCK_ROOM showing ROOMGRID_C itself & the entity entering that lands on
+    // the cell the line left at the entry. The line fails, nothing moves. A failed scan
+    // leaves the moves it kept, the mover's & the first SPECIAL_BLOCK's.
+    mover = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1, Vec3F(2.0f, 1.0f, 8.0f), SPECIAL_BLOCK);
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, ROOMGRID_C, Vec3F(3.0f, 1.0f, 8.0f), BLOCK_ROOM);
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1, Vec3F(4.0f, 1.0f, 8.0f), BLOCK);
+    RoomGrid& room_c = *roomgrid_lookup.roomgrid_pointers[ROOMGRID_C];
+    for(uint k = 0; k < 2; k++)
+    {
+	chain[k] = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_C, -1,
+					      entry + Vec3F((float)k, 0.0f, 0.0f), SPECIAL_BLOCK);
+    }
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_C, ROOMGRID_C, entry + Vec3F(2.0f, 0.0f, 0.0f), BLOCK_ROOM);
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_C, -1, entry + Vec3F(3.0f, 0.0f, 0.0f), BLOCK);
+    TEST_CHECK(!roomGridGetPushLine(room_a, entities, roomgrid_lookup, Vec3F(2.0f, 1.0f, 8.0f),
+				    Vec3F(3.0f, 1.0f, 8.0f), moves));
+    TEST_CHECK(moves.size() == 2);  // Stopped at the revisit, not by GRID_PUSH_MAX_ENTRIES
+    TEST_CHECK(!roomGridMoveEntities(room_a, entities, roomgrid_lookup, Vec3F(2.0f, 1.0f, 8.0f),
+				     Vec3F(3.0f, 1.0f, 8.0f), moves));
+    TEST_CHECK(gridPos(entities, mover) == Vec3F(2.0f, 1.0f, 8.0f) && ownerID(entities, mover) == ROOMGRID_A);
+    TEST_CHECK(gridPos(entities, chain[0]) == entry);
+    TEST_CHECK(gridPos(entities, chain[1]) == entry + Vec3F(1.0f, 0.0f, 0.0f));
+
+    // Scans leave no cell marked, a later line over the same cells moves
+    for(uint i = 0; i < room_c.brick_count; i++) {TEST_CHECK(!room_c.push_marks || room_c.push_marks[i] == 0);}
+    for(uint i = 0; i < room_a.brick_count; i++) {TEST_CHECK(!room_a.push_marks || room_a.push_marks[i] == 0);}
+    TEST_CHECK(roomGridMoveEntities(room_c, entities, roomgrid_lookup, entry + Vec3F(1.0f, 0.0f, 0.0f),
+				    entry + Vec3F(1.0f, 0.0f, 1.0f), moves));
+    TEST_CHECK(gridPos(entities, chain[1]) == entry + Vec3F(1.0f, 0.0f, 1.0f));
+
+    delete entities_p;
+    benchChain();
+    return testFinish("test_push");
+}
@@ -0,0 +1,125 @@
+// ====================================================================================
+// Title: test_push_cells.cpp
+// Description: Packed RoomGrid cells against handle lookups - long push lines checked
+//              from the cell flags alone, and through the entity columns as
+//              gameMoveEntitiesOnGrid did before cells held flags
+// ====================================================================================
+
+#include "test.hpp"
+
+#define BENCH_LINES  256   // Lines side by side along z, every other one ends in a BLOCK
+#define BENCH_ROUNDS 8
+#define BENCH_WIDTH  RG_MAX_EXTENT  // Lines run along x from 0
+
+const uint BENCH_LENGTHS[] = {8, 64, RG_MAX_EXTENT - 1};  // The longest leaves a cell to end in
+
+static uint
+scanPackedCells(const RoomGrid& room_grid, Vec3F pos, Vec3F move_dir)
+{
+    // Entities the push from pos moves, 0 if the line is blocked. Reads only the grid.
+    uint length = 1;
+    Vec3F next = pos + move_dir;
+    for(;;)
+    {
+	RoomGridCell cell = roomGridGetCell(room_grid, next);
+	uint flags = roomGridCellGetFlags(cell);
+	if(cell == INVALID_RANGE || (flags & CELL_COLLISION)) {return 0;}
+	if(!(flags & CELL_PUSHABLE)) {return length;}
+	length++;
+	next = next + move_dir;
+    }
+}
+
+static uint
+scanHandles(const RoomGrid& room_grid, const ActiveEntities& entities, Vec3F pos, Vec3F move_dir)
+{
+    // Same result from the handle in each cell: the entity's ID, liveness, collision &
+    // pushable bits and grid position, each a dependent read
+    uint length = 1;
+    Vec3F next = pos + move_dir;
+    for(;;)
+    {
+	int handle = roomGridGetEntity(room_grid, next);
+	if(handle == INVALID_RANGE) {return 0;}
+	int neighbor_id = activeEntitiesGetID(entities, handle);
+	if(neighbor_id < 0 || !activeEntitiesIsActive(entities, neighbor_id)) {return length;}
+	if(bitsetGet(entities.bitsets[BITSET_COLLISION], neighbor_id)) {return 0;}
+	if(!bitsetGet(entities.bitsets[BITSET_PUSHABLE], neighbor_id)) {return length;}
+	length++;
+	next = vec3FColumnsGet(entities.grid_positions, neighbor_id) + move_dir;
+    }
+}
+
+static void
+benchLines(uint line_length)
+{
+    RoomGridLookup roomgrid_lookup;
+    ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+    ActiveEntities& entities = *entities_p;
+    roomGridLookupSetExtents(roomgrid_lookup, ROOMGRID_A, BENCH_WIDTH, 1, BENCH_LINES);
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, -1, ROOMGRID_A, Vec3F(0.0f, 0.0f, 0.0f), BLOCK_ROOM);
+    RoomGrid& room_grid = *roomgrid_lookup.roomgrid_pointers[ROOMGRID_A];
+
+    // Created in shuffled order, as pushes leave entity IDs out of grid order
+    std::vector<Vec3F> positions;
+    for(uint z = 0; z < BENCH_LINES; z++)
+    {
+	for(uint x = 0; x < line_length; x++) {positions.push_back(Vec3F((float)x, 0.0f, (float)z));}
+    }
+    for(uint i = (uint)positions.size() - 1; i > 0; i--) {std::swap(positions[i], positions[testRandom() % (i + 1)]);}
+    TEST_CHECK(activeEntitiesCreateEntities(entities, roomgrid_lookup, ROOMGRID_A, &positions[0],
+					    (uint)positions.size(), SPECIAL_BLOCK, NULL));
+    for(uint z = 1; z < BENCH_LINES; z += 2)
+    {
+	activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1, Vec3F((float)line_length, 0.0f, (float)z), BLOCK);
+    }
+
+    // Both read the same lines
+    Vec3F move_dir = Vec3F(1.0f, 0.0f, 0.0f);
+    uint bad_lines = 0;
+    for(uint z = 0; z < BENCH_LINES; z++)
+    {
+	Vec3F start = Vec3F(0.0f, 0.0f, (float)z);
+	uint expected = (z & 1) ? 0 : line_length;
+	if(scanPackedCells(room_grid, start, move_dir) != expected ||
+	   scanHandles(room_grid, entities, start, move_dir) != expected)
+	{
+	    bad_lines++;
+	}
+    }
+    TEST_CHECK(bad_lines == 0);
+
+    double packed_ms  = 1.0e30;
+    double handles_ms = 1.0e30;
+    uint packed_sum  = 0;
+    uint handles_sum = 0;
+    for(uint round = 0; round < BENCH_ROUNDS; round++)
+    {
+	TestClock::time_point start = testTimerStart();
+	for(uint z = 0; z < BENCH_LINES; z++) {packed_sum += scanPackedCells(room_grid, Vec3F(0.0f, 0.0f, (float)z), move_dir);}
+	double ms = testTimerMs(start);
+	if(ms < packed_ms) {packed_ms = ms;}
+
+	start = testTimerStart();
+	for(uint z = 0; z < BENCH_LINES; z++) {handles_sum += scanHandles(room_grid, entities, Vec3F(0.0f, 0.0f, (float)z), move_dir);}
+	ms = testTimerMs(start);
+	if(ms < handles_ms) {handles_ms = ms;}
+    }
+    TEST_CHECK(packed_sum == handles_sum);
+
+    double steps = (double)BENCH_LINES * line_length;
+    printf("%3u long lines: packed cells %.2f ns/step, handle lookups %.2f ns/step\n",
+	   line_length, packed_ms * 1.0e6 / steps, handles_ms * 1.0e6 / steps);
+
+    delete entities_p;
+}
+
+int
+main()
+{
+    for(uint l = 0; l < sizeof(BENCH_LENGTHS) / sizeof(BENCH_LENGTHS[0]); l++)
+    {
+	benchLines(BENCH_LENGTHS[l]);
+    }
+    return testFinish("test_push_cells");
+}
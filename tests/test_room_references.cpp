@@ -0,0 +1,69 @@
+// ====================================================================================
+// Title: test_room_references.cpp
+// Description: Shared RoomGrids - a RoomGrid shown inside itself & beside its owner,
+//              then removing a reference & the owner
+// ====================================================================================
+
+#include "test.hpp"
+
+int
+main()
+{
+    // ROOMGRID_B is held by a BLOCK_ROOM in ROOMGRID_A, shown again by one in A and by
+    // one in B itself
+    RoomGridLookup roomgrid_lookup;
+    ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+    ActiveEntities& entities = *entities_p;
+    Vec3F floor[RG_DEFAULT_WIDTH * RG_DEFAULT_LENGTH];
+    for(uint x = 0; x < RG_DEFAULT_WIDTH; x++)
+    {
+	for(uint z = 0; z < RG_DEFAULT_LENGTH; z++) {floor[x * RG_DEFAULT_LENGTH + z] = Vec3F((float)x, 0.0f, (float)z);}
+    }
+    uint floor_count = RG_DEFAULT_WIDTH * RG_DEFAULT_LENGTH;
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, -1, ROOMGRID_A, Vec3F(0.0f, 0.0f, 0.0f), BLOCK_ROOM);
+    TEST_CHECK(activeEntitiesCreateEntities(entities, roomgrid_lookup, ROOMGRID_A, floor, floor_count, BLOCK, NULL));
+    int owner = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, ROOMGRID_B,
+					   Vec3F(1.0f, 1.0f, 1.0f), BLOCK_ROOM);
+    TEST_CHECK(activeEntitiesCreateEntities(entities, roomgrid_lookup, ROOMGRID_B, floor, floor_count, BLOCK, NULL));
+    int special = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_B, -1,
+					     Vec3F(2.0f, 1.0f, 2.0f), SPECIAL_BLOCK);
+    RoomGrid* room_b_p = roomgrid_lookup.roomgrid_pointers[ROOMGRID_B];
+    int self_ref = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_B, ROOMGRID_B,
+					      Vec3F(8.0f, 1.0f, 8.0f), BLOCK_ROOM);
+    int side_ref = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, ROOMGRID_B,
+					      Vec3F(5.0f, 1.0f, 5.0f), BLOCK_ROOM);
+
+    // Both references show ROOMGRID_B without a copy, its first holder stays the owner
+    TEST_CHECK(roomgrid_lookup.roomgrid_pointers[ROOMGRID_B] == room_b_p);
+    TEST_CHECK(room_b_p->owner_entity_handle == owner);
+    TEST_CHECK(room_b_p->roomgrid_owner_id == ROOMGRID_A);
+    TEST_CHECK(room_b_p->references.size() == 2);
+    int self_id = activeEntitiesGetID(entities, self_ref);
+    TEST_CHECK(self_id > -1);
+    TEST_CHECK(entities.roomgrid_ids[self_id] == ROOMGRID_B);
+    TEST_CHECK(entities.roomgrid_owner_ids[self_id] == ROOMGRID_B);
+    TEST_CHECK(roomGridGetEntity(*room_b_p, Vec3F(8.0f, 1.0f, 8.0f)) == self_ref);
+    TEST_CHECK(roomGridCellGetFlags(roomGridGetCell(*room_b_p, Vec3F(8.0f, 1.0f, 8.0f))) & CELL_ROOM);
+    TEST_CHECK(room_b_p->contents.size() == floor_count + 2);
+
+    // Removing a reference leaves ROOMGRID_B & its contents
+    uint count = entities.count;
+    activeEntitiesMarkInactive(entities, activeEntitiesGetID(entities, side_ref));
+    activeEntitiesRemoveInactives(entities, roomgrid_lookup);
+    TEST_CHECK(entities.count == count - 1);
+    TEST_CHECK(roomgrid_lookup.roomgrid_pointers[ROOMGRID_B] == room_b_p);
+    TEST_CHECK(room_b_p->references.size() == 1 && room_b_p->references[0] == self_ref);
+    TEST_CHECK(activeEntitiesGetID(entities, special) > -1);
+
+    // Removing the owner removes ROOMGRID_B once, the reference inside it included
+    activeEntitiesMarkInactive(entities, activeEntitiesGetID(entities, owner));
+    activeEntitiesRemoveInactives(entities, roomgrid_lookup);
+    TEST_CHECK(roomgrid_lookup.roomgrid_pointers[ROOMGRID_B] == NULL);
+    TEST_CHECK(activeEntitiesGetID(entities, self_ref) == -1);
+    TEST_CHECK(activeEntitiesGetID(entities, special) == -1);
+    TEST_CHECK(entities.count == 1 + floor_count);
+    TEST_CHECK(roomgrid_lookup.roomgrid_pointers[ROOMGRID_A]->contents.size() == floor_count);
+
+    delete entities_p;
+    return testFinish("test_room_references");
+}
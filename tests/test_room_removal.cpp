@@ -0,0 +1,134 @@
+// ====================================================================================
+// Title: test_room_removal.cpp
+// Description: RoomGrid lifetimes - a completed zoom-in keeps every entity, while
+//              roomGridRemoveOwner & removing a BLOCK_ROOM cascade to the contents
+// ====================================================================================
+
+#include "test.hpp"
+
+typedef struct TestLevel
+{
+    int room_b;     // BLOCK_ROOM holding ROOMGRID_B, in ROOMGRID_A
+    int room_c;     // BLOCK_ROOM holding ROOMGRID_C, in ROOMGRID_B
+    int room_d;     // BLOCK_ROOM holding ROOMGRID_D, in ROOMGRID_A beside room_b
+    int player;     // In ROOMGRID_A
+    int special_d;  // In ROOMGRID_D
+} TestLevel;
+
+static void
+createLevel(ActiveEntities& entities, RoomGridLookup& roomgrid_lookup, TestLevel& level)
+{
+    // A floored ROOMGRID_A holding the player and two rooms, one with a room inside
+    Vec3F floor[RG_DEFAULT_WIDTH * RG_DEFAULT_LENGTH];
+    for(uint x = 0; x < RG_DEFAULT_WIDTH; x++)
+    {
+	for(uint z = 0; z < RG_DEFAULT_LENGTH; z++) {floor[x * RG_DEFAULT_LENGTH + z] = Vec3F((float)x, 0.0f, (float)z);}
+    }
+    uint floor_count = RG_DEFAULT_WIDTH * RG_DEFAULT_LENGTH;
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, -1, ROOMGRID_A, Vec3F(0.0f, 0.0f, 0.0f), BLOCK_ROOM);
+    TEST_CHECK(activeEntitiesCreateEntities(entities, roomgrid_lookup, ROOMGRID_A, floor, floor_count, BLOCK, NULL));
+    level.player = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1, Vec3F(0.0f, 1.0f, 1.0f), PLAYER);
+    level.room_b = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, ROOMGRID_B,
+					      Vec3F(1.0f, 1.0f, 1.0f), BLOCK_ROOM);
+    TEST_CHECK(activeEntitiesCreateEntities(entities, roomgrid_lookup, ROOMGRID_B, floor, floor_count, BLOCK, NULL));
+    level.room_c = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_B, ROOMGRID_C,
+					      Vec3F(5.0f, 1.0f, 5.0f), BLOCK_ROOM);
+    TEST_CHECK(activeEntitiesCreateEntities(entities, roomgrid_lookup, ROOMGRID_C, floor, floor_count, BLOCK, NULL));
+    level.room_d = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, ROOMGRID_D,
+					      Vec3F(8.0f, 1.0f, 8.0f), BLOCK_ROOM);
+    level.special_d = activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_D, -1,
+						 Vec3F(2.0f, 1.0f, 2.0f), SPECIAL_BLOCK);
+}
+
+static uint
+countBadCells(const ActiveEntities& entities, const RoomGridLookup& roomgrid_lookup)
+{
+    // Entities on a RoomGrid that is gone, or not in their own cell
+    uint bad_cells = 0;
+    for(uint i = 0; i < entities.count; i++)
+    {
+	int rg_id = entities.roomgrid_owner_ids[i];
+	if(rg_id < 0) {continue;}
+	const RoomGrid* rg_p = roomgrid_lookup.roomgrid_pointers[rg_id];
+	if(!rg_p || roomGridGetEntity(*rg_p, vec3FColumnsGet(entities.grid_positions, i)) != entities.handles[i])
+	{
+	    bad_cells++;
+	}
+    }
+    return bad_cells;
+}
+
+static void
+testZoomInCompletion()
+{
+    // The frame a zoom into ROOMGRID_B completes, gameUpdateRoomGridTransition only
+    // marks the transition complete & gameUpdate runs the removal & defragment passes.
+    // Nothing is removed and ROOMGRID_B stays nested.
+    RoomGridLookup roomgrid_lookup;
+    ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+    ActiveEntities& entities = *entities_p;
+    TestLevel level;
+    createLevel(entities, roomgrid_lookup, level);
+    uint count = entities.count;
+
+    activeEntitiesRemoveInactives(entities, roomgrid_lookup);
+    while(activeEntitiesDefragment(entities, ENTITY_DEFRAG_SWAPS)) {}
+
+    TEST_CHECK(entities.count == count);
+    TEST_CHECK(activeEntitiesGetID(entities, level.player) > -1);
+    TEST_CHECK(activeEntitiesGetID(entities, level.room_d) > -1);
+    TEST_CHECK(activeEntitiesGetID(entities, level.special_d) > -1);
+    TEST_CHECK(activeEntitiesGetID(entities, level.room_c) > -1);
+    TEST_CHECK(roomgrid_lookup.roomgrid_pointers[ROOMGRID_B]->roomgrid_owner_id == ROOMGRID_A);
+    TEST_CHECK(roomGridGetEntity(*roomgrid_lookup.roomgrid_pointers[ROOMGRID_A], Vec3F(0.0f, 1.0f, 1.0f)) == level.player);
+    TEST_CHECK(countBadCells(entities, roomgrid_lookup) == 0);
+
+    // ROOMGRID_A, which a zoom out returns to, keeps its floor, the player & both rooms
+    TEST_CHECK(roomgrid_lookup.roomgrid_pointers[ROOMGRID_A]->contents.size() ==
+	       RG_DEFAULT_WIDTH * RG_DEFAULT_LENGTH + 3);
+
+    delete entities_p;
+}
+
+static void
+testExplicitRemoval()
+{
+    // roomGridRemoveOwner keeps the holder & its RoomGrid, everything else in the old
+    // owner goes, nested RoomGrids included
+    RoomGridLookup roomgrid_lookup;
+    ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+    ActiveEntities& entities = *entities_p;
+    TestLevel level;
+    createLevel(entities, roomgrid_lookup, level);
+    uint b_contents = (uint)roomgrid_lookup.roomgrid_pointers[ROOMGRID_B]->contents.size();
+    uint c_contents = (uint)roomgrid_lookup.roomgrid_pointers[ROOMGRID_C]->contents.size();
+
+    roomGridRemoveOwner(*roomgrid_lookup.roomgrid_pointers[ROOMGRID_B], entities, roomgrid_lookup);
+    activeEntitiesRemoveInactives(entities, roomgrid_lookup);
+    TEST_CHECK(roomgrid_lookup.roomgrid_pointers[ROOMGRID_A] == NULL);
+    TEST_CHECK(roomgrid_lookup.roomgrid_pointers[ROOMGRID_D] == NULL);
+    TEST_CHECK(activeEntitiesGetID(entities, level.player) == -1);
+    TEST_CHECK(activeEntitiesGetID(entities, level.special_d) == -1);
+    TEST_CHECK(activeEntitiesGetID(entities, level.room_b) > -1);
+    TEST_CHECK(roomgrid_lookup.roomgrid_pointers[ROOMGRID_B]->roomgrid_owner_id == -1);
+    TEST_CHECK(entities.count == 1 + b_contents + c_contents);
+    TEST_CHECK(countBadCells(entities, roomgrid_lookup) == 0);
+
+    // Removing a BLOCK_ROOM removes what it holds, at any depth
+    activeEntitiesMarkInactive(entities, activeEntitiesGetID(entities, level.room_b));
+    activeEntitiesRemoveInactives(entities, roomgrid_lookup);
+    TEST_CHECK(entities.count == 0);
+    TEST_CHECK(roomgrid_lookup.roomgrid_pointers[ROOMGRID_B] == NULL);
+    TEST_CHECK(roomgrid_lookup.roomgrid_pointers[ROOMGRID_C] == NULL);
+    for(uint q = 0; q < TOTAL_QUERIES; q++) {TEST_CHECK(entities.queries[q].count == 0);}
+
+    delete entities_p;
+}
+
+int
+main()
+{
+    testZoomInCompletion();
+    testExplicitRemoval();
+    return testFinish("test_room_removal");
+}
@@ -0,0 +1,135 @@
+// ====================================================================================
+// Title: test_room_sizes.cpp
+// Description: Per-room RoomGrid extents - mixed-size nesting & removal, then lookup
+//              speed of the compile-time size classes against runtime extents
+// ====================================================================================
+
+#include "test.hpp"
+
+#define BENCH_LOOKUPS (1 << 22)
+
+static void
+testMixedSizeNesting()
+{
+    // A (20x20x20) holds B (5x5x5), which holds C (7x3x9), which holds D (64x8x64)
+    RoomGridLookup roomgrid_lookup;
+    ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+    ActiveEntities& entities = *entities_p;
+
+    roomGridLookupSetExtents(roomgrid_lookup, ROOMGRID_B, 5, 5, 5);
+    roomGridLookupSetExtents(roomgrid_lookup, ROOMGRID_C, 7, 3, 9);
+    roomGridLookupSetExtents(roomgrid_lookup, ROOMGRID_D, 64, 8, 64);
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, -1, ROOMGRID_A, Vec3F(0.0f, 0.0f, 0.0f), BLOCK_ROOM);
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, ROOMGRID_B, Vec3F(1.0f, 1.0f, 1.0f), BLOCK_ROOM);
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_B, ROOMGRID_C, Vec3F(4.0f, 4.0f, 4.0f), BLOCK_ROOM);
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_C, ROOMGRID_D, Vec3F(6.0f, 2.0f, 8.0f), BLOCK_ROOM);
+
+    const uint expected[4][3] = {{20, 20, 20}, {5, 5, 5}, {7, 3, 9}, {64, 8, 64}};
+    const uint expected_class[4] = {RG_SIZE_DEFAULT, RG_SIZE_SMALL, RG_SIZE_ANY, RG_SIZE_ANY};
+    const float expected_span[4] = {20.0f, 5.0f, 9.0f, 64.0f};
+    for(uint r = 0; r < 4; r++)
+    {
+	RoomGrid& room_grid = *roomgrid_lookup.roomgrid_pointers[ROOMGRID_A + r];
+	TEST_CHECK(room_grid.width == expected[r][0] && room_grid.height == expected[r][1] &&
+		   room_grid.length == expected[r][2]);
+	TEST_CHECK(room_grid.size_class == expected_class[r]);
+	TEST_CHECK(roomGridGetSpan(room_grid) == expected_span[r]);
+	TEST_CHECK(roomGridGetEntity(room_grid, Vec3F((float)room_grid.width, 0.0f, 0.0f)) == INVALID_RANGE);
+	TEST_CHECK(roomGridGetEntity(room_grid, Vec3F(0.0f, (float)room_grid.height, 0.0f)) == INVALID_RANGE);
+	TEST_CHECK(roomGridGetEntity(room_grid, Vec3F(0.0f, 0.0f, (float)room_grid.length)) == INVALID_RANGE);
+	if(r > 0) {TEST_CHECK(room_grid.roomgrid_owner_id == (int)(ROOMGRID_A + r - 1));}
+
+	// A floor across each room's own extents
+	std::vector<Vec3F> floor;
+	for(uint x = 0; x < room_grid.width; x++)
+	{
+	    for(uint z = 0; z < room_grid.length; z++)
+	    {
+		Vec3F pos = Vec3F((float)x, 0.0f, (float)z);
+		if(roomGridGetEntity(room_grid, pos) == NO_ENTITY) {floor.push_back(pos);}
+	    }
+	}
+	TEST_CHECK(activeEntitiesCreateEntities(entities, roomgrid_lookup, ROOMGRID_A + r, &floor[0],
+						(uint)floor.size(), BLOCK, NULL));
+	uint bad_cells = 0;
+	for(uint x = 0; x < room_grid.width; x++)
+	{
+	    for(uint z = 0; z < room_grid.length; z++)
+	    {
+		if(roomGridGetEntity(room_grid, Vec3F((float)x, 0.0f, (float)z)) < 0) {bad_cells++;}
+	    }
+	}
+	TEST_CHECK(bad_cells == 0);
+    }
+    TEST_CHECK(roomGridGetFirstIDByType(roomgrid_lookup.roomgrid_pointers[ROOMGRID_C], entities_p, BLOCK_ROOM) > -1);
+
+    // Removing B takes C & D and everything in them
+    int b_id = roomGridGetFirstIDByType(roomgrid_lookup.roomgrid_pointers[ROOMGRID_A], entities_p, BLOCK_ROOM);
+    TEST_CHECK(b_id > -1 && entities.roomgrid_ids[b_id] == ROOMGRID_B);
+    activeEntitiesMarkInactive(entities, b_id);
+    for(uint pass = 0; pass < 4 && entities.removed_count > 0; pass++)
+    {
+	activeEntitiesRemoveInactives(entities, roomgrid_lookup);
+    }
+    TEST_CHECK(roomgrid_lookup.roomgrid_pointers[ROOMGRID_B] == NULL);
+    TEST_CHECK(roomgrid_lookup.roomgrid_pointers[ROOMGRID_C] == NULL);
+    TEST_CHECK(roomgrid_lookup.roomgrid_pointers[ROOMGRID_D] == NULL);
+    TEST_CHECK(entities.count == 1 + RG_DEFAULT_WIDTH * RG_DEFAULT_LENGTH);
+
+    delete entities_p;
+}
+
+static double
+benchLookups(const RoomGrid& room_grid, const std::vector<Vec3F>& positions, uint& sum)
+{
+    TestClock::time_point start = testTimerStart();
+    for(uint i = 0; i < BENCH_LOOKUPS; i++) {sum += (uint)roomGridGetEntity(room_grid, positions[i]);}
+    return testTimerMs(start) * 1.0e6 / BENCH_LOOKUPS;
+}
+
+static void
+benchSizeClasses()
+{
+    // The same room looked up through its size class & through runtime extents
+    const uint extents[2][3] = {{RG_DEFAULT_WIDTH, RG_DEFAULT_HEIGHT, RG_DEFAULT_LENGTH},
+				{RG_SMALL_WIDTH, RG_SMALL_HEIGHT, RG_SMALL_LENGTH}};
+    for(uint e = 0; e < 2; e++)
+    {
+	RoomGrid* sized_p = new RoomGrid(extents[e][0], extents[e][1], extents[e][2]);
+	RoomGrid* runtime_p = new RoomGrid(extents[e][0], extents[e][1], extents[e][2]);
+	runtime_p->size_class = RG_SIZE_ANY;
+
+	std::vector<Vec3F> positions(BENCH_LOOKUPS);
+	for(uint i = 0; i < BENCH_LOOKUPS; i++)
+	{
+	    // Includes out of range positions, like neighbour probes at a room's edge
+	    positions[i] = Vec3F((float)(testRandom() % (extents[e][0] + 1)),
+				 (float)(testRandom() % (extents[e][1] + 1)),
+				 (float)(testRandom() % (extents[e][2] + 1)));
+	    if(i % 3 == 0 && roomGridContains(*sized_p, positions[i]))
+	    {
+		roomGridSetEntity(*sized_p, positions[i], (int)(i & 0xFFFF), 0);
+		roomGridSetEntity(*runtime_p, positions[i], (int)(i & 0xFFFF), 0);
+	    }
+	}
+
+	uint sized_sum = 0;
+	uint runtime_sum = 0;
+	double sized_ns = benchLookups(*sized_p, positions, sized_sum);
+	double runtime_ns = benchLookups(*runtime_p, positions, runtime_sum);
+	TEST_CHECK(sized_sum == runtime_sum);
+	printf("%ux%ux%u lookup: %.2f ns with size class %u, %.2f ns with runtime extents\n",
+	       extents[e][0], extents[e][1], extents[e][2], sized_ns, sized_p->size_class, runtime_ns);
+
+	delete runtime_p;
+	delete sized_p;
+    }
+}
+
+int
+main()
+{
+    testMixedSizeNesting();
+    benchSizeClasses();
+    return testFinish("test_room_sizes");
+}
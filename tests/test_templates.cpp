@@ -0,0 +1,107 @@
+// ====================================================================================
+// Title: test_templates.cpp
+// Description: Checks entity_traits.hpp against data/templates/entity_templates.txt,
+//              then times creation & removal of a mixed population. build_tests.bat
+//              builds it with STATIC_ENTITY_TEMPLATES 0 & 1 to compare the runtime
+//              table with the compiled signatures & per-type removal kernel.
+// ====================================================================================
+
+#include "test.hpp"
+
+#ifndef ENTITY_TEMPLATES_PATH
+#define ENTITY_TEMPLATES_PATH "..\\data\\templates\\entity_templates.txt"
+#endif
+
+#define BENCH_WIDTH  100
+#define BENCH_LENGTH 100
+#define BENCH_ROUNDS 5
+
+static void
+testTraitsMatchFile()
+{
+    EntityTemplates entity_templates;
+    TEST_CHECK(entityTemplatesLoadFromTxt(entity_templates, ENTITY_TEMPLATES_PATH));
+    for(uint type = 0; type < TOTAL_ENTITY_TYPES; type++)
+    {
+	for(uint component = 0; component < TOTAL_COMPONENT_TYPES; component++)
+	{
+	    if(entity_templates.table[type][component] != (uint)entityTraitsHas(type, component))
+	    {
+		printf("Type %u component %u: file %u, entity_traits.hpp %u\n", type, component,
+		       entity_templates.table[type][component], (uint)entityTraitsHas(type, component));
+		TEST_CHECK(!"entity_traits.hpp matches the template file");
+	    }
+	}
+    }
+}
+
+static uint
+benchMixedType(uint x, uint z)
+{
+    // 4 in 10 PLAYER, 4 in 10 SPECIAL_BLOCK, 1 in 10 BLOCK_ROOM, 1 in 10 empty
+    uint pick = (x * BENCH_LENGTH + z) % 10;
+    if(pick < 4) {return PLAYER;}
+    if(pick < 8) {return SPECIAL_BLOCK;}
+    if(pick < 9) {return BLOCK_ROOM;}
+    return NONE;
+}
+
+static void
+benchMixedPopulation()
+{
+    // A floor of BLOCKs with PLAYERs, SPECIAL_BLOCKs & small BLOCK_ROOMs above it
+    RoomGridLookup roomgrid_lookup;
+    ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+    ActiveEntities& entities = *entities_p;
+    roomGridLookupSetExtents(roomgrid_lookup, ROOMGRID_A, BENCH_WIDTH, 2, BENCH_LENGTH);
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, -1, ROOMGRID_A, Vec3F(0.0f, 0.0f, 0.0f), BLOCK_ROOM);
+
+    double create_ms = 0.0;
+    double remove_ms = 0.0;
+    uint population = 0;
+    for(uint round = 0; round < BENCH_ROUNDS; round++)
+    {
+	TestClock::time_point start = testTimerStart();
+	for(uint x = 0; x < BENCH_WIDTH; x++)
+	{
+	    for(uint z = 0; z < BENCH_LENGTH; z++)
+	    {
+		activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1,
+					   Vec3F((float)x, 0.0f, (float)z), BLOCK);
+		uint type = benchMixedType(x, z);
+		if(type == NONE) {continue;}
+
+		int roomgrid_id = -1;
+		if(type == BLOCK_ROOM)
+		{
+		    roomgrid_id = roomGridLookupAddID(roomgrid_lookup);
+		    roomGridLookupSetExtents(roomgrid_lookup, roomgrid_id, 4, 4, 4);
+		}
+		activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, roomgrid_id,
+					   Vec3F((float)x, 1.0f, (float)z), type);
+	    }
+	}
+	create_ms += testTimerMs(start);
+	population = entities.count - 1;
+
+	for(uint i = 1; i < entities.count; i++) {activeEntitiesMarkInactive(entities, i);}
+	start = testTimerStart();
+	activeEntitiesRemoveInactives(entities, roomgrid_lookup);
+	remove_ms += testTimerMs(start);
+
+	TEST_CHECK(entities.count == 1);
+	TEST_CHECK(roomgrid_lookup.roomgrid_pointers[ROOMGRID_A]->contents.size() == 0);
+    }
+    printf("STATIC_ENTITY_TEMPLATES %d: %u mixed entities created in %.3f ms, removed in %.3f ms\n",
+	   STATIC_ENTITY_TEMPLATES, population, create_ms / BENCH_ROUNDS, remove_ms / BENCH_ROUNDS);
+
+    delete entities_p;
+}
+
+int
+main()
+{
+    testTraitsMatchFile();
+    benchMixedPopulation();
+    return testFinish("test_templates");
+}
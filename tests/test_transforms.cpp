@@ -0,0 +1,184 @@
+// ====================================================================================
+// Title: test_transforms.cpp
+// Description: Transform kernels - roomTransformTableUpdateRange checked against
+//              roomTransformTableUpdateEntity on the same population, then both timed
+//              with every RoomGrid moved & with a few moved entities
+// ====================================================================================
+
+#include "test.hpp"
+
+#define BENCH_ROOMS  256  // Floored 20x20 rooms, ~100k entities
+#define BENCH_ROUNDS 16
+
+typedef struct TransformState
+{
+    std::vector<float>  positions;  // x, y, z & scale per entity
+    std::vector<uint64> dirty;
+} TransformState;
+
+static void
+saveTransforms(const ActiveEntities& entities, TransformState& state)
+{
+    state.positions.resize(entities.count * 4);
+    for(uint i = 0; i < entities.count; i++)
+    {
+	state.positions[i * 4 + 0] = entities.transform_positions.x[i];
+	state.positions[i * 4 + 1] = entities.transform_positions.y[i];
+	state.positions[i * 4 + 2] = entities.transform_positions.z[i];
+	state.positions[i * 4 + 3] = entities.transform_scales.x[i];
+    }
+    state.dirty.assign(entities.bitsets[BITSET_GRID_DIRTY],
+		       entities.bitsets[BITSET_GRID_DIRTY] + bitsetWordCount(entities.count));
+}
+
+static void
+loadTransforms(ActiveEntities& entities, const TransformState& state)
+{
+    for(uint i = 0; i < entities.count; i++)
+    {
+	entities.transform_positions.x[i] = state.positions[i * 4 + 0];
+	entities.transform_positions.y[i] = state.positions[i * 4 + 1];
+	entities.transform_positions.z[i] = state.positions[i * 4 + 2];
+	entities.transform_scales.x[i] = state.positions[i * 4 + 3];
+	entities.transform_scales.y[i] = state.positions[i * 4 + 3];
+	entities.transform_scales.z[i] = state.positions[i * 4 + 3];
+    }
+    memcpy(entities.bitsets[BITSET_GRID_DIRTY], &state.dirty[0], state.dirty.size() * sizeof(uint64));
+}
+
+static void
+setRoomsDirty(RoomTransformTable& table, uint every)
+{
+    // Every every-th RoomGrid moved, ROOMGRID_B is a template
+    for(uint r = 1; r < table.dirty.size(); r++) {table.dirty[r] = (r % every == 0);}
+    table.dirty[ROOMGRID_B + 1] = -1;
+}
+
+static uint
+updateScalar(const RoomTransformTable& table, ActiveEntities& entities)
+{
+    // Visits the set bits like the scheduler does for the Transforms system
+    uint touched = 0;
+    for(uint w = 0; w < bitsetWordCount(entities.count); w++)
+    {
+	uint64 word = entities.bitsets[BITSET_LIVE][w] & entities.bitsets[BITSET_GRID_POSITION][w];
+	while(word)
+	{
+	    touched += roomTransformTableUpdateEntity(table, entities, (w << 6) + bitsetPopLowest(word));
+	}
+    }
+    return touched;
+}
+
+#if AVX2_KERNELS
+static double
+benchPaths(const RoomTransformTable& table, ActiveEntities& entities, const TransformState& start_state,
+	   bool use_range, uint& touched)
+{
+    // Best round, each from the same transforms & dirty bits
+    double best_ms = 1.0e30;
+    for(uint round = 0; round < BENCH_ROUNDS; round++)
+    {
+	loadTransforms(entities, start_state);
+	TestClock::time_point start = testTimerStart();
+	touched = use_range ? roomTransformTableUpdateRange(table, entities, 0, entities.count) :
+			      updateScalar(table, entities);
+	double ms = testTimerMs(start);
+	if(ms < best_ms) {best_ms = ms;}
+    }
+    return best_ms;
+}
+#endif
+
+int
+main()
+{
+    RoomGridLookup roomgrid_lookup;
+    ActiveEntities* entities_p = testCreateEntities(roomgrid_lookup);
+    ActiveEntities& entities = *entities_p;
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, -1, ROOMGRID_A, Vec3F(0.0f, 0.0f, 0.0f), BLOCK_ROOM);
+    Vec3F floor[RG_DEFAULT_WIDTH * RG_DEFAULT_LENGTH];
+    for(uint x = 0; x < RG_DEFAULT_WIDTH; x++)
+    {
+	for(uint z = 0; z < RG_DEFAULT_LENGTH; z++) {floor[x * RG_DEFAULT_LENGTH + z] = Vec3F((float)x, 0.0f, (float)z);}
+    }
+    for(uint r = 0; r < BENCH_ROOMS; r++)
+    {
+	int room_id = roomGridLookupAddID(roomgrid_lookup);
+	Vec3F room_pos = Vec3F((float)(r % RG_DEFAULT_WIDTH), 1.0f, (float)(r / RG_DEFAULT_WIDTH));
+	activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, room_id, room_pos, BLOCK_ROOM);
+	TEST_CHECK(activeEntitiesCreateEntities(entities, roomgrid_lookup, room_id, floor,
+						RG_DEFAULT_WIDTH * RG_DEFAULT_LENGTH, BLOCK, NULL));
+    }
+    // Cameras hold no grid position & are skipped by both paths
+    activeEntitiesCreateEntity(entities, roomgrid_lookup, ROOMGRID_A, -1, Vec3F(0.0f, 5.0f, 0.0f), CAMERA);
+
+    RoomTransformTable table;
+    uint room_total = (uint)roomgrid_lookup.roomgrid_pointers.size();
+    table.scales.resize(room_total + 1);
+    table.bases_x.resize(room_total + 1);
+    table.bases_y.resize(room_total + 1);
+    table.bases_z.resize(room_total + 1);
+    table.dirty.resize(room_total + 1);
+    for(uint r = 0; r <= room_total; r++)
+    {
+	table.scales[r]  = 1.0f / (float)(1 + r % 7);
+	table.bases_x[r] = (float)(testRandom() % 1000) * 0.25f;
+	table.bases_y[r] = (float)(testRandom() % 1000) * 0.25f;
+	table.bases_z[r] = (float)(testRandom() % 1000) * 0.25f;
+    }
+
+    // Every RoomGrid but one moved, then a few moved entities in still RoomGrids
+    TransformState moved_rooms;
+    setRoomsDirty(table, 1);
+    saveTransforms(entities, moved_rooms);
+    TransformState moved_entities;
+    bitsetAssignRange(entities.bitsets[BITSET_GRID_DIRTY], 0, entities.count, false);
+    for(uint i = 0; i < entities.count; i += 61) {bitsetSet(entities.bitsets[BITSET_GRID_DIRTY], i);}
+    saveTransforms(entities, moved_entities);
+
+#if AVX2_KERNELS
+    if(!cpuHasAVX2())
+    {
+	printf("No AVX2, roomTransformTableUpdateRange not run\n");
+	delete entities_p;
+	return testFinish("test_transforms");
+    }
+
+    // Both paths write the same transforms & clear the same dirty bits
+    TransformState scalar_result;
+    TransformState range_result;
+    const TransformState* starts[2] = {&moved_rooms, &moved_entities};
+    uint every[2] = {1, 0xFFFFFFFF};
+    for(uint s = 0; s < 2; s++)
+    {
+	setRoomsDirty(table, every[s]);
+	loadTransforms(entities, *starts[s]);
+	uint scalar_touched = updateScalar(table, entities);
+	saveTransforms(entities, scalar_result);
+	loadTransforms(entities, *starts[s]);
+	uint range_touched = roomTransformTableUpdateRange(table, entities, 0, entities.count);
+	saveTransforms(entities, range_result);
+	TEST_CHECK(scalar_touched == range_touched);
+	TEST_CHECK(scalar_result.positions == range_result.positions);
+	TEST_CHECK(scalar_result.dirty == range_result.dirty);
+    }
+
+    const char* names[2] = {"all RoomGrids moved", "1 in 61 entities moved"};
+    for(uint s = 0; s < 2; s++)
+    {
+	setRoomsDirty(table, every[s]);
+	uint scalar_touched = 0;
+	uint range_touched = 0;
+	double scalar_ms = benchPaths(table, entities, *starts[s], false, scalar_touched);
+	double range_ms  = benchPaths(table, entities, *starts[s], true, range_touched);
+	printf("%u entities, %s (%u updated): scalar %.3f ms, AVX2 range %.3f ms\n",
+	       entities.count, names[s], scalar_touched, scalar_ms, range_ms);
+    }
+#else
+    printf("Built without AVX2_KERNELS, roomTransformTableUpdateRange not run\n");
+#endif
+
+    delete entities_p;
+    return testFinish("test_transforms");
+}